@@ -77,9 +77,9 @@ public:
     }
 
     // return view matrix
-    glm::mat4 getViewMatrix() { return glm::lookAt(m_position, m_position + m_front, m_up); }
+    glm::mat4 getViewMatrix() const { return glm::lookAt(m_position, m_position + m_front, m_up); }
 
-    glm::mat4 getProjectionMatrix(int width, int height)
+    glm::mat4 getProjectionMatrix(int width, int height) const
     {
         return glm::perspective(
             glm::radians(m_fov), static_cast<float>(width) / static_cast<float>(height), m_near, m_far
@@ -1,7 +1,12 @@
 #ifndef CUBEMAP_HPP_NSIPCAFR
 #define CUBEMAP_HPP_NSIPCAFR
 
+#include <array>
+#include <cstddef>
 #include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
 #include <optional>
 #include <type_traits>
 #include <vector>
@@ -14,6 +19,13 @@ class Cubemap final : public Texture
 {
 private:
     static inline constexpr std::size_t s_numFaces{ 6 };
+    static inline constexpr std::size_t s_bytesPerTexel{ TextureResidency::bytesPerTexel(gl::GL_RGB) };
+
+    static inline constexpr SamplerParams s_samplerParams{
+        .m_wrap      = gl::GL_CLAMP_TO_EDGE,
+        .m_minFilter = gl::GL_LINEAR,
+        .m_magFilter = gl::GL_LINEAR,
+    };
 
 public:
     // Note that the coordinate system for cubemap is left-handed. Z is flipped (front
@@ -66,6 +78,7 @@ public:
 
 private:
     CubeImagePath m_imagePaths;
+    std::size_t   m_fullBytes{ 0 };
 
 public:
     static std::optional<Cubemap> from(
@@ -78,33 +91,27 @@ public:
             return {};
         }
 
-        using Int = std::underlying_type_t<Face>;
-
-        std::vector<ImageData> imageDatas;
-        imageDatas.reserve(s_numFaces);
-
-        for (Int face{ 0 }; face < static_cast<Int>(s_numFaces); ++face) {
-            // the image is flipped vertically by the opengl on the cubemap, so we don't need to flip it on
-            // load
-            auto maybeImageData{ ImageData::from(imagePaths.get(static_cast<Face>(face)), false) };
-            if (!maybeImageData) {
-                return {};
-            }
-            imageDatas.emplace_back(std::move(*maybeImageData));
+        auto maybeImageDatas{ loadImages(imagePaths) };
+        if (!maybeImageDatas) {
+            return {};
         }
-        return Cubemap{ std::move(imageDatas), std::move(imagePaths), uniformName, textureUnitNum };
+        return Cubemap{ std::move(*maybeImageDatas), std::move(imagePaths), uniformName, textureUnitNum };
     }
 
 public:
     Cubemap(const Cubemap&) = delete;
 
     Cubemap(Cubemap&& other) noexcept
-        : Texture{ gl::GL_TEXTURE_CUBE_MAP, other.m_id, other.m_unitNum, other.m_uniformName }
+        : Texture{ gl::GL_TEXTURE_CUBE_MAP, other.m_id, other.m_unitNum, other.m_uniformName, other.m_samplerParams }
         , m_imagePaths{ std::move(other.m_imagePaths) }
+        , m_fullBytes{ other.m_fullBytes }
     {
         other.m_id = 0;
+        moveResidency(other);
     }
 
+    ~Cubemap() override { releaseResidency(); }
+
     const CubeImagePath& getImagePaths() const { return m_imagePaths; }
 
     const std::filesystem::path& getImagePath(Face face) const { return m_imagePaths.get(face); }
@@ -116,18 +123,46 @@ private:
         const std::string&       uniformName,
         gl::GLint                textureUnitNum
     )
-        : Texture{ gl::GL_TEXTURE_CUBE_MAP, textureUnitNum, uniformName }
+        : Texture{ gl::GL_TEXTURE_CUBE_MAP, textureUnitNum, uniformName, s_samplerParams }
         , m_imagePaths{ std::move(imagePaths) }
     {
         gl::glGenTextures(1, &m_id);
         gl::glBindTexture(m_target, m_id);
 
-        gl::glTexParameteri(m_target, gl::GL_TEXTURE_WRAP_S, gl::GL_CLAMP_TO_EDGE);
-        gl::glTexParameteri(m_target, gl::GL_TEXTURE_WRAP_T, gl::GL_CLAMP_TO_EDGE);
-        gl::glTexParameteri(m_target, gl::GL_TEXTURE_WRAP_R, gl::GL_CLAMP_TO_EDGE);
-        gl::glTexParameteri(m_target, gl::GL_TEXTURE_MIN_FILTER, gl::GL_LINEAR);
-        gl::glTexParameteri(m_target, gl::GL_TEXTURE_MAG_FILTER, gl::GL_LINEAR);
+        upload(imageDatas);
+
+        gl::glBindTexture(m_target, 0);
+
+        for (const auto& imageData : imageDatas) {
+            m_fullBytes += TextureResidency::computeBytes(
+                std::size_t(imageData.m_width), std::size_t(imageData.m_height), 1, s_bytesPerTexel, false
+            );
+        }
+        trackResidency(TextureResidency::Kind::CUBEMAP, m_fullBytes, true);
+    }
+
+    static std::optional<std::vector<ImageData>> loadImages(const CubeImagePath& imagePaths)
+    {
+        using Int = std::underlying_type_t<Face>;
+
+        std::vector<ImageData> imageDatas;
+        imageDatas.reserve(s_numFaces);
+
+        for (Int face{ 0 }; face < static_cast<Int>(s_numFaces); ++face) {
+            // the image is flipped vertically by the opengl on the cubemap, so we don't need to flip it on
+            // load
+            auto maybeImageData{ ImageData::from(imagePaths.get(static_cast<Face>(face)), false) };
+            if (!maybeImageData) {
+                return {};
+            }
+            imageDatas.emplace_back(std::move(*maybeImageData));
+        }
+        return imageDatas;
+    }
 
+    // the texture must be bound
+    void upload(const std::vector<ImageData>& imageDatas) const
+    {
         for (std::size_t face{ 0 }; face < s_numFaces; ++face) {
             const auto& imageData{ imageDatas[face] };
 
@@ -174,8 +209,58 @@ private:
                 );
             }
         }
+    }
 
-        gl::glBindTexture(m_target, 0);
+    // replace every face with a 1x1 placeholder
+    std::size_t evictStorage() override
+    {
+        using namespace gl;
+
+        constexpr std::array<unsigned char, 4> placeholder{ 0x00, 0x00, 0x00, 0xff };
+
+        GLint previous{};
+        glGetIntegerv(GL_TEXTURE_BINDING_CUBE_MAP, &previous);
+        glBindTexture(m_target, m_id);
+
+        for (std::size_t face{ 0 }; face < s_numFaces; ++face) {
+            using Int = std::underlying_type_t<GLenum>;
+            GLenum texFace{ GL_TEXTURE_CUBE_MAP_POSITIVE_X + static_cast<Int>(face) };
+            glTexImage2D(texFace, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder.data());
+        }
+
+        glBindTexture(m_target, static_cast<GLuint>(previous));
+
+        std::cout << std::format("INFO: [Cubemap] Evicted '{}'\n", m_imagePaths.right.parent_path().string());
+
+        return s_numFaces * s_bytesPerTexel;
+    }
+
+    TextureResidency::Callback restoreStorage() override
+    {
+        auto maybeImageDatas{ loadImages(m_imagePaths) };
+        if (!maybeImageDatas) {
+            // keep the placeholder
+            std::cerr << std::format(
+                "ERROR: [Cubemap] Failed to restream '{}'\n", m_imagePaths.right.parent_path().string()
+            );
+            return {};
+        }
+
+        auto imageDatas{ std::make_shared<const std::vector<ImageData>>(std::move(*maybeImageDatas)) };
+
+        return [this, imageDatas] {
+            using namespace gl;
+
+            GLint previous{};
+            glGetIntegerv(GL_TEXTURE_BINDING_CUBE_MAP, &previous);
+            glBindTexture(m_target, m_id);
+
+            upload(*imageDatas);
+
+            glBindTexture(m_target, static_cast<GLuint>(previous));
+
+            return m_fullBytes;
+        };
     }
 };
 
@@ -0,0 +1,29 @@
+#ifndef DEFAULT_FRAMEBUFFER_HPP_K7TQ2XWB
+#define DEFAULT_FRAMEBUFFER_HPP_K7TQ2XWB
+
+#include <glbinding/gl/gl.h>
+
+namespace window
+{
+    class Window;
+}
+
+/*
+ * The framebuffer a frame ends up in for the context current on this thread. It is 0, the default framebuffer,
+ * except for a headless window on EGL: without a surface, binding 0 draws nowhere, so the window draws in one of its
+ * own instead (see Window::createOffscreenFramebuffer). Bind this where 0 would be bound to get back to the window.
+ */
+class DefaultFramebuffer
+{
+private:
+    friend class window::Window;    // sets it when its context is made current
+
+    static inline thread_local gl::GLuint s_current{ 0 };
+
+public:
+    static gl::GLuint get() { return s_current; }
+
+    static void bind(gl::GLenum target = gl::GL_FRAMEBUFFER) { gl::glBindFramebuffer(target, s_current); }
+};
+
+#endif /* end of include guard: DEFAULT_FRAMEBUFFER_HPP_K7TQ2XWB */
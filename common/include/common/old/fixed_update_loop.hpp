@@ -0,0 +1,132 @@
+#ifndef FIXED_UPDATE_LOOP_HPP_N5WG4TRJ
+#define FIXED_UPDATE_LOOP_HPP_N5WG4TRJ
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+#include "triple_buffer.hpp"
+
+/*
+ * Runs a simulation on a thread of its own at a fixed tick rate, independently of how fast frames are drawn. After
+ * each tick the states before and after it are published together, so the render thread always has the two latest
+ * states at hand and draws what lies between them at the time of its frame: the motion stays smooth whatever the
+ * frame rate, and updating costs the render thread nothing.
+ *
+ * A tick is computed one period ahead of when it is due, so interpolating adds no latency over the period itself.
+ */
+template <std::copyable State>
+class FixedUpdateLoop
+{
+public:
+    using Clock  = std::chrono::steady_clock;
+    using Update = std::function<void(State& state, double deltaTime)>;
+
+    // valid until the next call to read()
+    struct View
+    {
+        const State& m_previous;
+        const State& m_current;
+        float        m_alpha;    // 0: m_previous, 1: m_current
+    };
+
+private:
+    // when this far behind, ticks are skipped instead of computed back to back to catch up
+    static inline constexpr int s_maxLagTicks{ 5 };
+
+    struct Snapshot
+    {
+        State             m_previous;
+        State             m_current;
+        Clock::time_point m_due;    // when m_current is the state to draw
+    };
+
+    Clock::duration            m_period;
+    Update                     m_update;
+    TripleBuffer<Snapshot>     m_snapshots;
+    std::atomic<std::uint64_t> m_ticks{ 0 };
+    std::atomic<std::uint64_t> m_skippedTicks{ 0 };
+    std::jthread               m_thread;    // last, it uses everything above
+
+public:
+    FixedUpdateLoop(const State& initial, double tickRate, Update&& update)
+        : m_period{ std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>{ 1.0 / tickRate }) }
+        , m_update{ std::move(update) }
+        , m_snapshots{ { initial, initial, Clock::now() } }
+    {
+        m_thread = std::jthread{ [this, initial](std::stop_token stopToken) { loop(stopToken, initial); } };
+    }
+
+    FixedUpdateLoop(const FixedUpdateLoop&)            = delete;
+    FixedUpdateLoop& operator=(const FixedUpdateLoop&) = delete;
+    FixedUpdateLoop(FixedUpdateLoop&&)                 = delete;
+    FixedUpdateLoop& operator=(FixedUpdateLoop&&)      = delete;
+
+    // the update thread stops after the tick in progress
+    ~FixedUpdateLoop() = default;
+
+    // @thread_safety: call this function from a single thread (the render thread)
+    View read()
+    {
+        m_snapshots.update();
+        const auto& snapshot{ m_snapshots.front() };
+
+        const auto ahead{ std::chrono::duration<float>{ snapshot.m_due - Clock::now() } };
+        const auto period{ std::chrono::duration<float>{ m_period } };
+        const auto alpha{ std::clamp(1.0f - ahead / period, 0.0f, 1.0f) };
+
+        return { snapshot.m_previous, snapshot.m_current, alpha };
+    }
+
+    // stops the update thread and returns the state of the last tick, to carry on from it
+    // @thread_safety: call this function from the thread that reads
+    State stop()
+    {
+        m_thread.request_stop();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        m_snapshots.update();
+        return m_snapshots.front().m_current;
+    }
+
+    double getDeltaTime() const { return std::chrono::duration<double>{ m_period }.count(); }
+
+    // @thread_safety: these functions can be called from any thread
+    std::uint64_t getTickCount() const { return m_ticks.load(std::memory_order_relaxed); }
+    std::uint64_t getSkippedTicks() const { return m_skippedTicks.load(std::memory_order_relaxed); }
+
+private:
+    void loop(std::stop_token stopToken, State state)
+    {
+        const auto deltaTime{ getDeltaTime() };
+        auto       due{ Clock::now() + m_period };
+
+        while (!stopToken.stop_requested()) {
+            auto& snapshot{ m_snapshots.back() };
+            snapshot.m_previous = state;
+            m_update(state, deltaTime);
+            snapshot.m_current = state;
+            snapshot.m_due     = due;
+            m_snapshots.publish();
+            m_ticks.fetch_add(1, std::memory_order_relaxed);
+
+            std::this_thread::sleep_until(due);
+            due += m_period;
+
+            if (const auto now{ Clock::now() }; now > due + s_maxLagTicks * m_period) {
+                const auto behind{ static_cast<std::uint64_t>((now - due) / m_period) };
+                m_skippedTicks.fetch_add(behind, std::memory_order_relaxed);
+                due += behind * m_period;
+            }
+        }
+    }
+};
+
+#endif /* end of include guard: FIXED_UPDATE_LOOP_HPP_N5WG4TRJ */
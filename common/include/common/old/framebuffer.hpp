@@ -1,13 +1,19 @@
 #ifndef FRAMEBUFFER_HPP_UKRHGFNS
 #define FRAMEBUFFER_HPP_UKRHGFNS
 
+#include <cstddef>
 #include <functional>
 #include <iostream>
 #include <optional>
+#include <type_traits>
 #include <utility>
 
 #include <glbinding/gl/gl.h>
 
+#include "default_framebuffer.hpp"
+#include "sampler_cache.hpp"
+#include "texture_residency.hpp"
+
 class Framebuffer
 {
 public:
@@ -30,15 +36,23 @@ public:
         if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
             std::cerr << "ERROR: Framebuffer is not complete!" << '\n';
 
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            DefaultFramebuffer::bind();
             return {};
         }
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        return Framebuffer{ framebuffer, textureColorbuffer, rbo };
+        DefaultFramebuffer::bind();
+        return Framebuffer{ framebuffer, textureColorbuffer, rbo, attachmentBytes(width, height) };
     }
 
 private:
+    // color texture + depth/stencil renderbuffer
+    static std::size_t attachmentBytes(gl::GLint width, gl::GLint height)
+    {
+        constexpr auto bytesPerTexel{ TextureResidency::bytesPerTexel(gl::GL_RGB)
+                                      + TextureResidency::bytesPerTexel(gl::GL_DEPTH24_STENCIL8) };
+        return TextureResidency::computeBytes(std::size_t(width), std::size_t(height), 1, bytesPerTexel, false);
+    }
+
     // return textureColorbuffer and rbo
     [[nodiscard]]
     static std::pair<gl::GLuint, gl::GLuint> createAttachmentBuffers(gl::GLint width, gl::GLint height)
@@ -77,10 +91,13 @@ public:
         other.m_fbo = 0;
         other.m_tex = 0;
         other.m_rbo = 0;
+
+        TextureResidency::instance().retrack(&other, this);
     }
 
     ~Framebuffer()
     {
+        TextureResidency::instance().untrack(this);
         if (m_fbo != 0) {
             gl::glDeleteFramebuffers(1, &m_fbo);
         }
@@ -96,11 +113,12 @@ private:
     Framebuffer()                   = delete;
     Framebuffer(const Framebuffer&) = delete;
 
-    Framebuffer(gl::GLuint framebuffer, gl::GLuint textureColorbuffer, gl::GLuint rbo)
+    Framebuffer(gl::GLuint framebuffer, gl::GLuint textureColorbuffer, gl::GLuint rbo, std::size_t bytes)
         : m_fbo{ framebuffer }
         , m_tex{ textureColorbuffer }
         , m_rbo{ rbo }
     {
+        TextureResidency::instance().track(this, TextureResidency::Kind::ATTACHMENT, bytes);
     }
 
 public:
@@ -124,12 +142,14 @@ public:
         m_tex = newTexture;
         m_rbo = newRbo;
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        TextureResidency::instance().resize(this, attachmentBytes(width, height));
+
+        DefaultFramebuffer::bind();
     }
 
     void bind() const { gl::glBindFramebuffer(gl::GL_FRAMEBUFFER, m_fbo); }
 
-    void unbind() const { gl::glBindFramebuffer(gl::GL_FRAMEBUFFER, 0); }
+    void unbind() const { DefaultFramebuffer::bind(); }
 
     void use(std::function<void()>&& func) const
     {
@@ -138,7 +158,13 @@ public:
         unbind();
     }
 
-    void bindTexture() const { gl::glBindTexture(gl::GL_TEXTURE_2D, m_tex); }
+    // the attachment has no mipmaps, so it is sampled with its own parameters instead of a sampler object
+    void bindTexture(gl::GLint unitNum = 0) const
+    {
+        gl::glActiveTexture(gl::GL_TEXTURE0 + std::underlying_type_t<gl::GLenum>(unitNum));
+        gl::glBindTexture(gl::GL_TEXTURE_2D, m_tex);
+        SamplerCache::current().unbind(unitNum);
+    }
 };
 
 #endif /* end of include guard: FRAMEBUFFER_HPP_UKRHGFNS */
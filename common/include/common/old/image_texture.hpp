@@ -1,8 +1,13 @@
 #ifndef IMAGE_TEXTURE_HPP_MZAGCFYB
 #define IMAGE_TEXTURE_HPP_MZAGCFYB
 
+#include <algorithm>
 #include <array>
+#include <cstddef>
 #include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
 #include <optional>
 #include <utility>
 #include <vector>
@@ -14,32 +19,47 @@
 class ImageTexture final : public Texture
 {
 private:
+    // an evicted texture keeps a mip level no larger than this (in both dimensions)
+    static inline constexpr gl::GLsizei s_evictedSize{ 32 };
+
+    static inline constexpr std::size_t s_bytesPerTexel{ TextureResidency::bytesPerTexel(gl::GL_RGBA) };
+
     std::filesystem::path m_imagePath;
+    gl::GLsizei           m_width;
+    gl::GLsizei           m_height;
+    std::size_t           m_evictedBytes{ 0 };
 
 public:
     static std::optional<ImageTexture> from(
         std::filesystem::path imagePath,
         const std::string&    uniformName,
-        gl::GLint             textureUnitNum
+        gl::GLint             textureUnitNum,
+        const SamplerParams&  params = {}
     )
     {
         auto maybeImageData{ ImageData::from(imagePath) };
         if (!maybeImageData) {
             return {};
         }
-        return ImageTexture{ std::move(*maybeImageData), imagePath, uniformName, textureUnitNum };
+        return ImageTexture{ std::move(*maybeImageData), imagePath, uniformName, textureUnitNum, params };
     }
 
 public:
     ImageTexture(const ImageTexture&) = delete;
 
     ImageTexture(ImageTexture&& other) noexcept
-        : Texture{ gl::GL_TEXTURE_2D, other.m_id, other.m_unitNum, other.m_uniformName }
+        : Texture{ gl::GL_TEXTURE_2D, other.m_id, other.m_unitNum, other.m_uniformName, other.m_samplerParams }
         , m_imagePath{ std::move(other.m_imagePath) }
+        , m_width{ other.m_width }
+        , m_height{ other.m_height }
+        , m_evictedBytes{ other.m_evictedBytes }
     {
         other.m_id = 0;
+        moveResidency(other);
     }
 
+    ~ImageTexture() override { releaseResidency(); }
+
     const std::filesystem::path& getImagePath() const { return m_imagePath; }
 
 private:
@@ -47,19 +67,29 @@ private:
         ImageData&&           imageData,
         std::filesystem::path imagePath,
         const std::string&    uniformName,
-        gl::GLint             textureUnitNum
+        gl::GLint             textureUnitNum,
+        const SamplerParams&  params
     )
-        : Texture{ gl::GL_TEXTURE_2D, textureUnitNum, uniformName }
+        : Texture{ gl::GL_TEXTURE_2D, textureUnitNum, uniformName, params }
         , m_imagePath{ std::move(imagePath) }
+        , m_width{ imageData.m_width }
+        , m_height{ imageData.m_height }
     {
         gl::glGenTextures(1, &m_id);
         gl::glBindTexture(m_target, m_id);
 
-        gl::glTexParameteri(m_target, gl::GL_TEXTURE_WRAP_S, gl::GL_MIRRORED_REPEAT);
-        gl::glTexParameteri(m_target, gl::GL_TEXTURE_WRAP_T, gl::GL_MIRRORED_REPEAT);
-        gl::glTexParameteri(m_target, gl::GL_TEXTURE_MIN_FILTER, gl::GL_LINEAR_MIPMAP_NEAREST);
-        gl::glTexParameteri(m_target, gl::GL_TEXTURE_MAG_FILTER, gl::GL_LINEAR);
+        // wrap and filter state lives in the sampler object bound along with the texture (see SamplerCache)
+        upload(imageData);
+
+        gl::glBindTexture(m_target, 0);
 
+        const bool evictable{ m_width > s_evictedSize || m_height > s_evictedSize };
+        trackResidency(TextureResidency::Kind::IMAGE, fullBytes(), evictable);
+    }
+
+    // the texture must be bound
+    void upload(const ImageData& imageData) const
+    {
         if (imageData.m_nrChannels == 4) {
             gl::glTexImage2D(
                 m_target,
@@ -100,8 +130,72 @@ private:
             );
         }
         gl::glGenerateMipmap(m_target);
+    }
 
-        gl::glBindTexture(m_target, 0);
+    std::size_t fullBytes() const
+    {
+        return TextureResidency::computeBytes(std::size_t(m_width), std::size_t(m_height), 1, s_bytesPerTexel, true);
+    }
+
+    // replace the whole mip chain with the first mip level that fits in s_evictedSize
+    std::size_t evictStorage() override
+    {
+        using namespace gl;
+
+        GLint   level{ 0 };
+        GLsizei width{ m_width };
+        GLsizei height{ m_height };
+        while (width > s_evictedSize || height > s_evictedSize) {
+            width  = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+            ++level;
+        }
+
+        std::vector<unsigned char> pixels(std::size_t(width * height) * 4);
+
+        GLint previous{};
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+        glBindTexture(m_target, m_id);
+
+        glGetTexImage(m_target, level, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glTexImage2D(m_target, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glGenerateMipmap(m_target);
+
+        glBindTexture(m_target, static_cast<GLuint>(previous));
+
+        std::cout << std::format(
+            "INFO: [ImageTexture] Evicted '{}' down to {}x{}\n", m_imagePath.filename().string(), width, height
+        );
+
+        m_evictedBytes = TextureResidency::computeBytes(std::size_t(width), std::size_t(height), 1, s_bytesPerTexel, true);
+        return m_evictedBytes;
+    }
+
+    TextureResidency::Callback restoreStorage() override
+    {
+        auto maybeImageData{ ImageData::from(m_imagePath) };
+        if (!maybeImageData) {
+            // keep the low resolution version
+            std::cerr << std::format("ERROR: [ImageTexture] Failed to restream '{}'\n", m_imagePath.string());
+            return {};
+        }
+
+        // std::function needs a copyable callable
+        auto imageData{ std::make_shared<const ImageData>(std::move(*maybeImageData)) };
+
+        return [this, imageData] {
+            using namespace gl;
+
+            GLint previous{};
+            glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+            glBindTexture(m_target, m_id);
+
+            upload(*imageData);
+
+            glBindTexture(m_target, static_cast<GLuint>(previous));
+
+            return fullBytes();
+        };
     }
 };
 
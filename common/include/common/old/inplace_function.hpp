@@ -0,0 +1,134 @@
+#ifndef INPLACE_FUNCTION_HPP_K2WQ7RNE
+#define INPLACE_FUNCTION_HPP_K2WQ7RNE
+
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature, std::size_t Capacity = 48>
+class InplaceFunction;
+
+/*
+ * A move-only std::function that keeps callables of up to Capacity bytes in itself instead of on the heap, so
+ * queueing a lambda that captures a pointer and a few numbers allocates nothing. Larger callables (or ones whose
+ * move may throw) still work, they are put on the heap like std::function would.
+ */
+template <typename Ret, typename... Args, std::size_t Capacity>
+class InplaceFunction<Ret(Args...), Capacity>
+{
+private:
+    struct VTable
+    {
+        Ret (*m_invoke)(void* storage, Args&&... args);
+        void (*m_move)(void* from, void* to) noexcept;    // leaves `from` destroyed
+        void (*m_destroy)(void* storage) noexcept;
+    };
+
+    template <typename Fn>
+    static constexpr bool s_fitsInline{
+        sizeof(Fn) <= Capacity && alignof(Fn) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<Fn>
+    };
+
+    template <typename Fn>
+    struct Inline
+    {
+        static Fn* get(void* storage) { return std::launder(static_cast<Fn*>(storage)); }
+
+        static Ret invoke(void* storage, Args&&... args)
+        {
+            return std::invoke(*get(storage), std::forward<Args>(args)...);
+        }
+
+        static void move(void* from, void* to) noexcept
+        {
+            ::new (to) Fn{ std::move(*get(from)) };
+            get(from)->~Fn();
+        }
+
+        static void destroy(void* storage) noexcept { get(storage)->~Fn(); }
+
+        static constexpr VTable s_vtable{ &invoke, &move, &destroy };
+    };
+
+    // the storage holds a pointer to the callable
+    template <typename Fn>
+    struct Heap
+    {
+        static Fn*& get(void* storage) { return *std::launder(static_cast<Fn**>(storage)); }
+
+        static Ret invoke(void* storage, Args&&... args)
+        {
+            return std::invoke(*get(storage), std::forward<Args>(args)...);
+        }
+
+        static void move(void* from, void* to) noexcept { ::new (to) Fn* { get(from) }; }
+
+        static void destroy(void* storage) noexcept { delete get(storage); }
+
+        static constexpr VTable s_vtable{ &invoke, &move, &destroy };
+    };
+
+    alignas(std::max_align_t) std::byte m_storage[Capacity];
+    const VTable* m_vtable{ nullptr };
+
+public:
+    InplaceFunction() = default;
+    InplaceFunction(std::nullptr_t) { }
+
+    template <typename F>
+        requires(!std::same_as<std::remove_cvref_t<F>, InplaceFunction>)
+             && std::is_invocable_r_v<Ret, std::decay_t<F>&, Args...>
+    InplaceFunction(F&& func)
+    {
+        using Fn = std::decay_t<F>;
+
+        if constexpr (s_fitsInline<Fn>) {
+            ::new (m_storage) Fn{ std::forward<F>(func) };
+            m_vtable = &Inline<Fn>::s_vtable;
+        } else {
+            ::new (m_storage) Fn* { new Fn{ std::forward<F>(func) } };
+            m_vtable = &Heap<Fn>::s_vtable;
+        }
+    }
+
+    InplaceFunction(const InplaceFunction&)            = delete;
+    InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+    InplaceFunction(InplaceFunction&& other) noexcept
+        : m_vtable{ std::exchange(other.m_vtable, nullptr) }
+    {
+        if (m_vtable) {
+            m_vtable->m_move(other.m_storage, m_storage);
+        }
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            m_vtable = std::exchange(other.m_vtable, nullptr);
+            if (m_vtable) {
+                m_vtable->m_move(other.m_storage, m_storage);
+            }
+        }
+        return *this;
+    }
+
+    ~InplaceFunction() { reset(); }
+
+    Ret operator()(Args... args) { return m_vtable->m_invoke(m_storage, std::forward<Args>(args)...); }
+
+    explicit operator bool() const { return m_vtable != nullptr; }
+
+    void reset()
+    {
+        if (m_vtable) {
+            std::exchange(m_vtable, nullptr)->m_destroy(m_storage);
+        }
+    }
+};
+
+#endif /* end of include guard: INPLACE_FUNCTION_HPP_K2WQ7RNE */
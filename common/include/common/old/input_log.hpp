@@ -0,0 +1,264 @@
+#ifndef INPUT_LOG_HPP_U5NB8WQZ
+#define INPUT_LOG_HPP_U5NB8WQZ
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace window
+{
+    // the input a window receives in one frame (see Window::run)
+    struct InputEvents
+    {
+        struct KeyTransition
+        {
+            int m_key;       // GLFW_KEY_*
+            int m_action;    // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+            int m_mods;      // GLFW_MOD_*
+        };
+
+        std::optional<glm::dvec2>  m_cursorPos;          // latest
+        std::optional<glm::dvec2>  m_scroll;             // summed
+        std::optional<glm::ivec2>  m_framebufferSize;    // latest
+        std::vector<KeyTransition> m_keys;               // in order
+
+        bool empty() const { return !m_cursorPos && !m_scroll && !m_framebufferSize && m_keys.empty(); }
+
+        // keeps the capacity of m_keys
+        void clear()
+        {
+            m_cursorPos.reset();
+            m_scroll.reset();
+            m_framebufferSize.reset();
+            m_keys.clear();
+        }
+    };
+
+    /*
+     * Binary log of the input of a window, one record per frame that had any. A record is a fixed header
+     *
+     *   u32 frame | f64 time (s) | u8 flags | u8 (unused) | u16 number of keys
+     *
+     * followed by what the flags say is there: the cursor position (2 x f64), the scroll offset (2 x f64), the
+     * framebuffer size (2 x i32), then the key transitions (i16 key, u8 action, u8 mods each). Little endian.
+     */
+    class InputLog
+    {
+    public:
+        static inline constexpr std::uint32_t s_magic{ 0x4c504e49 };    // "INPL"
+        static inline constexpr std::uint32_t s_version{ 1 };
+
+        enum Flags : std::uint8_t
+        {
+            HAS_CURSOR_POS       = 1 << 0,
+            HAS_SCROLL           = 1 << 1,
+            HAS_FRAMEBUFFER_SIZE = 1 << 2,
+        };
+
+        static_assert(std::endian::native == std::endian::little, "the input log is read and written as is");
+
+        InputLog() = delete;
+    };
+
+    class InputLogWriter
+    {
+    private:
+        std::ofstream     m_file;
+        std::vector<char> m_buffer;
+
+    public:
+        static std::optional<InputLogWriter> open(const std::filesystem::path& path)
+        {
+            std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+            if (!file) {
+                std::cerr << std::format("ERROR: [InputLog] Could not open {} for writing\n", path.string());
+                return {};
+            }
+
+            InputLogWriter writer{ std::move(file) };
+            writer.put(InputLog::s_magic);
+            writer.put(InputLog::s_version);
+            writer.flush();
+            return writer;
+        }
+
+        // frames without input are skipped
+        void write(std::uint32_t frame, double time, const InputEvents& events)
+        {
+            if (events.empty()) {
+                return;
+            }
+
+            std::uint8_t flags{ 0 };
+            flags |= events.m_cursorPos ? InputLog::HAS_CURSOR_POS : 0;
+            flags |= events.m_scroll ? InputLog::HAS_SCROLL : 0;
+            flags |= events.m_framebufferSize ? InputLog::HAS_FRAMEBUFFER_SIZE : 0;
+
+            put(frame);
+            put(time);
+            put(flags);
+            put(std::uint8_t{ 0 });
+            put(static_cast<std::uint16_t>(events.m_keys.size()));
+
+            if (events.m_cursorPos) {
+                put(events.m_cursorPos->x);
+                put(events.m_cursorPos->y);
+            }
+            if (events.m_scroll) {
+                put(events.m_scroll->x);
+                put(events.m_scroll->y);
+            }
+            if (events.m_framebufferSize) {
+                put(std::int32_t{ events.m_framebufferSize->x });
+                put(std::int32_t{ events.m_framebufferSize->y });
+            }
+            for (const auto& [key, action, mods] : events.m_keys) {
+                put(static_cast<std::int16_t>(key));
+                put(static_cast<std::uint8_t>(action));
+                put(static_cast<std::uint8_t>(mods));
+            }
+
+            flush();
+        }
+
+    private:
+        InputLogWriter(std::ofstream&& file)
+            : m_file{ std::move(file) }
+        {
+        }
+
+        template <typename T>
+        void put(T value)
+        {
+            const auto bytes{ std::bit_cast<std::array<char, sizeof(T)>>(value) };
+            m_buffer.insert(m_buffer.end(), bytes.begin(), bytes.end());
+        }
+
+        void flush()
+        {
+            m_file.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+            m_buffer.clear();
+        }
+    };
+
+    class InputLogReader
+    {
+    private:
+        std::vector<char> m_data;
+        std::size_t       m_offset{ 0 };
+
+    public:
+        static std::optional<InputLogReader> open(const std::filesystem::path& path)
+        {
+            std::ifstream file{ path, std::ios::binary };
+            if (!file) {
+                std::cerr << std::format("ERROR: [InputLog] Could not open {}\n", path.string());
+                return {};
+            }
+
+            InputLogReader reader{ { std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} } };
+
+            const auto magic{ reader.get<std::uint32_t>() };
+            const auto version{ reader.get<std::uint32_t>() };
+            if (magic != InputLog::s_magic || version != InputLog::s_version) {
+                std::cerr << std::format(
+                    "ERROR: [InputLog] {} is not an input log (version {})\n", path.string(), InputLog::s_version
+                );
+                return {};
+            }
+            return reader;
+        }
+
+        // no record left (a truncated record counts as the end)
+        bool isDone() const { return remaining() < s_recordHeaderSize; }
+
+        // fills `events` with the record of `frame` if the next record is for that frame; false if it is for a later
+        // frame (the frame had no input) or there is none left
+        bool read(std::uint32_t frame, InputEvents& events)
+        {
+            if (isDone() || peek<std::uint32_t>() != frame) {
+                return false;
+            }
+
+            const auto start{ m_offset };
+            get<std::uint32_t>();    // frame
+            get<double>();           // time
+            const auto flags{ get<std::uint8_t>() };
+            get<std::uint8_t>();
+            const auto numKeys{ get<std::uint16_t>() };
+
+            const std::size_t payloadSize{
+                ((flags & InputLog::HAS_CURSOR_POS) ? 16u : 0u) + ((flags & InputLog::HAS_SCROLL) ? 16u : 0u)
+                + ((flags & InputLog::HAS_FRAMEBUFFER_SIZE) ? 8u : 0u) + std::size_t{ numKeys } * 4
+            };
+            if (remaining() < payloadSize) {
+                m_offset = start;
+                m_data.resize(start);    // truncated, ends the log
+                return false;
+            }
+
+            if (flags & InputLog::HAS_CURSOR_POS) {
+                const auto x{ get<double>() };
+                events.m_cursorPos = glm::dvec2{ x, get<double>() };
+            }
+            if (flags & InputLog::HAS_SCROLL) {
+                const auto x{ get<double>() };
+                events.m_scroll = glm::dvec2{ x, get<double>() };
+            }
+            if (flags & InputLog::HAS_FRAMEBUFFER_SIZE) {
+                const auto width{ get<std::int32_t>() };
+                events.m_framebufferSize = glm::ivec2{ width, get<std::int32_t>() };
+            }
+            for (std::uint16_t i{ 0 }; i < numKeys; ++i) {
+                const int key{ get<std::int16_t>() };
+                const int action{ get<std::uint8_t>() };
+                const int mods{ get<std::uint8_t>() };
+                events.m_keys.push_back({ .m_key = key, .m_action = action, .m_mods = mods });
+            }
+            return true;
+        }
+
+    private:
+        static inline constexpr std::size_t s_recordHeaderSize{ 16 };
+
+        InputLogReader(std::vector<char>&& data)
+            : m_data{ std::move(data) }
+        {
+        }
+
+        std::size_t remaining() const { return m_data.size() - m_offset; }
+
+        template <typename T>
+        T peek() const
+        {
+            T value{};
+            if (remaining() >= sizeof(T)) {
+                std::memcpy(&value, m_data.data() + m_offset, sizeof(T));
+            }
+            return value;
+        }
+
+        template <typename T>
+        T get()
+        {
+            const auto value{ peek<T>() };
+            m_offset += std::min(sizeof(T), remaining());
+            return value;
+        }
+    };
+}
+
+#endif /* end of include guard: INPUT_LOG_HPP_U5NB8WQZ */
@@ -0,0 +1,302 @@
+#ifndef JOB_SYSTEM_HPP_R3FX9MKD
+#define JOB_SYSTEM_HPP_R3FX9MKD
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "inplace_function.hpp"
+
+// counts the jobs submitted with it that are not done yet; destroy it only once wait() on it has returned
+class JobCounter
+{
+private:
+    friend class JobSystem;
+
+    struct Parked
+    {
+        InplaceFunction<void()> m_job;
+        JobCounter*             m_counter;
+    };
+
+    std::atomic<std::size_t> m_pending{ 0 };
+    mutable std::mutex       m_mutex;    // held while m_pending drops to 0, and while a job parks on it
+    std::vector<Parked>      m_parked;   // jobs submitted to start after this one, queued when it reaches 0
+
+public:
+    JobCounter()                             = default;
+    JobCounter(const JobCounter&)            = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool isDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+};
+
+/*
+ * Process-wide work-stealing job system, one worker per core but one. Each worker has a deque of its own: it pushes
+ * and pops its jobs at the back (the most recent, still in cache) while idle workers steal from the front of the
+ * others. Jobs submitted from other threads (main thread, window threads) are dealt to the workers in turn.
+ *
+ * Waiting on a JobCounter runs the jobs of that counter meanwhile, so a window thread waiting on the culling of its
+ * frame lends its core to it; only once none of them is left in the deques does it block. Only the jobs of that
+ * counter: a window thread must not pick up a chunk of a model import and miss its frame over it. A job that has to
+ * run after others is parked on their counter instead of waiting in a worker, and queued when that counter is done.
+ */
+class JobSystem
+{
+public:
+    using Job = InplaceFunction<void()>;
+
+private:
+    static inline constexpr std::size_t s_notAWorker{ std::numeric_limits<std::size_t>::max() };
+
+    struct Entry
+    {
+        Job         m_job;
+        JobCounter* m_counter;
+    };
+
+    struct alignas(64) Worker
+    {
+        std::mutex        m_mutex;
+        std::deque<Entry> m_jobs;
+    };
+
+    static inline thread_local std::size_t s_workerIndex{ s_notAWorker };
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<std::size_t>             m_queued{ 0 };        // in the deques, workers sleep while it is 0
+    std::atomic<std::size_t>             m_nextWorker{ 0 };    // next one to get a job from outside
+    std::atomic<bool>                    m_stopping{ false };
+    std::vector<std::jthread>            m_threads;            // last, they use everything above
+
+public:
+    static JobSystem& instance()
+    {
+        static JobSystem system{ std::max(1u, std::thread::hardware_concurrency()) - 1 };
+        return system;
+    }
+
+    JobSystem(const JobSystem&)            = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    JobSystem(JobSystem&&)                 = delete;
+    JobSystem& operator=(JobSystem&&)      = delete;
+
+    // jobs still queued are dropped: wait on their counters before exiting
+    ~JobSystem()
+    {
+        m_stopping.store(true, std::memory_order_relaxed);
+        m_queued.fetch_add(1, std::memory_order_release);
+        m_queued.notify_all();
+        m_threads.clear();    // joins
+    }
+
+    std::size_t getNumWorkers() const { return m_workers.size(); }
+
+    // `counter` (optional) counts the job until it is done; with `after`, the job is queued once `after` is done
+    // (`after` must outlive it)
+    // @thread_safety: this function can be called from any thread
+    void submit(Job&& job, JobCounter* counter = nullptr, JobCounter* after = nullptr)
+    {
+        if (counter != nullptr) {
+            counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (after != nullptr) {
+            std::scoped_lock lock{ after->m_mutex };
+            if (!after->isDone()) {
+                after->m_parked.push_back({ std::move(job), counter });
+                return;
+            }
+        }
+
+        push({ std::move(job), counter });
+    }
+
+    // runs the jobs of `counter` until it is done, sleeps while the last ones run elsewhere
+    // @thread_safety: this function can be called from any thread
+    void wait(const JobCounter& counter)
+    {
+        while (true) {
+            if (runOne(&counter)) {
+                continue;
+            }
+            const auto pending{ counter.m_pending.load(std::memory_order_acquire) };
+            if (pending == 0) {
+                break;
+            }
+            counter.m_pending.wait(pending, std::memory_order_acquire);
+        }
+
+        // the job that brought it to 0 may still be queuing the jobs parked on it
+        std::scoped_lock lock{ counter.m_mutex };
+    }
+
+    // func(begin, end) over [0, count) in chunks of `grain` indices, the calling thread taking its share
+    template <typename Func>
+    void parallelFor(std::size_t count, std::size_t grain, Func&& func)
+    {
+        grain = std::max<std::size_t>(grain, 1);
+        const auto numChunks{ (count + grain - 1) / grain };
+        if (numChunks == 0) {
+            return;
+        }
+
+        JobCounter counter;
+        for (std::size_t chunk{ 1 }; chunk < numChunks; ++chunk) {
+            submit(
+                [&func, chunk, grain, count] {
+                    const auto begin{ chunk * grain };
+                    func(begin, std::min(count, begin + grain));
+                },
+                &counter
+            );
+        }
+        func(std::size_t{ 0 }, std::min(count, grain));
+        wait(counter);
+    }
+
+private:
+    explicit JobSystem(std::size_t numWorkers)
+    {
+        numWorkers = std::max<std::size_t>(numWorkers, 1);
+        for (std::size_t i{ 0 }; i < numWorkers; ++i) {
+            m_workers.push_back(std::make_unique<Worker>());
+        }
+        for (std::size_t i{ 0 }; i < numWorkers; ++i) {
+            m_threads.emplace_back([this, i] { work(i); });
+        }
+    }
+
+    void work(std::size_t index)
+    {
+        s_workerIndex = index;
+
+        while (!m_stopping.load(std::memory_order_relaxed)) {
+            if (runOne()) {
+                continue;
+            }
+            if (m_queued.load(std::memory_order_acquire) == 0) {
+                m_queued.wait(0, std::memory_order_acquire);
+            } else {
+                std::this_thread::yield();    // being taken by another thread
+            }
+        }
+    }
+
+    // any job, or only the jobs of `only`
+    bool runOne(const JobCounter* only = nullptr)
+    {
+        auto entry{ take(only) };
+        if (!entry) {
+            return false;
+        }
+
+        entry->m_job();
+        if (entry->m_counter != nullptr) {
+            finish(*entry->m_counter);
+        }
+        return true;
+    }
+
+    void push(Entry&& entry)
+    {
+        const auto index{ s_workerIndex != s_notAWorker
+                              ? s_workerIndex
+                              : m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size() };
+        {
+            auto& worker{ *m_workers[index] };
+            std::scoped_lock lock{ worker.m_mutex };
+            worker.m_jobs.push_back(std::move(entry));
+        }
+
+        m_queued.fetch_add(1, std::memory_order_release);
+        m_queued.notify_one();
+    }
+
+    // one job of `counter` is done; the last one takes the lock, so no job parks on a counter that is already done
+    void finish(JobCounter& counter)
+    {
+        auto pending{ counter.m_pending.load(std::memory_order_relaxed) };
+        while (pending > 1) {
+            if (counter.m_pending.compare_exchange_weak(pending, pending - 1, std::memory_order_release)) {
+                return;
+            }
+        }
+
+        std::vector<JobCounter::Parked> parked;
+        {
+            std::scoped_lock lock{ counter.m_mutex };
+            if (counter.m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                return;
+            }
+            parked = std::exchange(counter.m_parked, {});
+            counter.m_pending.notify_all();
+        }
+
+        // the counter may be gone by now
+        for (auto& [job, dependentCounter] : parked) {
+            push({ std::move(job), dependentCounter });
+        }
+    }
+
+    // from the back of the own deque first, then from the front of the others
+    std::optional<Entry> take(const JobCounter* only)
+    {
+        const auto numWorkers{ m_workers.size() };
+        const auto self{ s_workerIndex };
+
+        if (self != s_notAWorker) {
+            if (auto entry{ pop(*m_workers[self], false, only) }) {
+                return entry;
+            }
+        }
+
+        const auto start{ self != s_notAWorker ? self + 1 : m_nextWorker.load(std::memory_order_relaxed) };
+        for (std::size_t i{ 0 }; i < numWorkers; ++i) {
+            const auto victim{ (start + i) % numWorkers };
+            if (victim == self) {
+                continue;
+            }
+            if (auto entry{ pop(*m_workers[victim], true, only) }) {
+                return entry;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // the first job (of `only`, when set) from the front or the back
+    std::optional<Entry> pop(Worker& worker, bool front, const JobCounter* only)
+    {
+        std::scoped_lock lock{ worker.m_mutex };
+
+        auto& jobs{ worker.m_jobs };
+        auto  matches = [only](const Entry& entry) { return only == nullptr || entry.m_counter == only; };
+
+        std::deque<Entry>::iterator found;
+        if (front) {
+            found = std::ranges::find_if(jobs, matches);
+        } else {
+            const auto last{ std::ranges::find_if(jobs.rbegin(), jobs.rend(), matches) };
+            found = last == jobs.rend() ? jobs.end() : std::prev(last.base());
+        }
+        if (found == jobs.end()) {
+            return std::nullopt;
+        }
+
+        std::optional<Entry> entry{ std::move(*found) };
+        jobs.erase(found);
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+        return entry;
+    }
+};
+
+#endif /* end of include guard: JOB_SYSTEM_HPP_R3FX9MKD */
@@ -0,0 +1,129 @@
+#ifndef MAPPED_FILE_HPP_K2TRX6BN
+#define MAPPED_FILE_HPP_K2TRX6BN
+
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <utility>
+
+#if defined(_WIN32)
+#    include <fstream>
+
+#    include "staging_pool.hpp"
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+// Read-only view of a whole file. The file is memory-mapped where mmap is available, otherwise it is read into a
+// buffer from the StagingPool.
+class MappedFile
+{
+public:
+    enum class Advice
+    {
+        NORMAL,
+        SEQUENTIAL,    // read once from start to end (e.g. decoding)
+        RANDOM,
+    };
+
+private:
+    const unsigned char* m_data;
+    std::size_t          m_size;
+
+public:
+    static std::optional<MappedFile> open(const std::filesystem::path& filePath, Advice advice = Advice::NORMAL)
+    {
+#if defined(_WIN32)
+        (void)advice;
+
+        std::ifstream file{ filePath, std::ios::binary | std::ios::ate };
+        if (!file) {
+            std::cerr << std::format("ERROR: [MappedFile] Failed to open '{}'\n", filePath.string());
+            return {};
+        }
+
+        const auto size{ static_cast<std::size_t>(file.tellg()) };
+        auto*      data{ static_cast<char*>(StagingPool::instance().allocate(size)) };
+        file.seekg(0);
+        if (data == nullptr || !file.read(data, static_cast<std::streamsize>(size))) {
+            std::cerr << std::format("ERROR: [MappedFile] Failed to read '{}'\n", filePath.string());
+            StagingPool::instance().deallocate(data);
+            return {};
+        }
+        return MappedFile{ reinterpret_cast<const unsigned char*>(data), size };
+#else
+        int fd{ ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC) };
+        if (fd < 0) {
+            std::cerr << std::format("ERROR: [MappedFile] Failed to open '{}'\n", filePath.string());
+            return {};
+        }
+
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+            std::cerr << std::format("ERROR: [MappedFile] '{}' is empty or can't be stat'ed\n", filePath.string());
+            ::close(fd);
+            return {};
+        }
+
+        const auto size{ static_cast<std::size_t>(st.st_size) };
+        void*      data{ ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) };
+        ::close(fd);    // the mapping stays valid after the descriptor is closed
+
+        if (data == MAP_FAILED) {
+            std::cerr << std::format("ERROR: [MappedFile] Failed to map '{}'\n", filePath.string());
+            return {};
+        }
+
+        switch (advice) {
+        case Advice::SEQUENTIAL:
+            ::madvise(data, size, MADV_SEQUENTIAL);
+            ::madvise(data, size, MADV_WILLNEED);    // start reading ahead right away
+            break;
+        case Advice::RANDOM: ::madvise(data, size, MADV_RANDOM); break;
+        case Advice::NORMAL: break;
+        }
+
+        return MappedFile{ static_cast<const unsigned char*>(data), size };
+#endif
+    }
+
+public:
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+        : m_data{ std::exchange(other.m_data, nullptr) }
+        , m_size{ std::exchange(other.m_size, 0) }
+    {
+    }
+
+    ~MappedFile()
+    {
+        if (m_data == nullptr) {
+            return;
+        }
+#if defined(_WIN32)
+        StagingPool::instance().deallocate(const_cast<unsigned char*>(m_data));
+#else
+        ::munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+    }
+
+    const unsigned char* data() const { return m_data; }
+
+    std::size_t size() const { return m_size; }
+
+private:
+    MappedFile(const unsigned char* data, std::size_t size)
+        : m_data{ data }
+        , m_size{ size }
+    {
+    }
+};
+
+#endif /* end of include guard: MAPPED_FILE_HPP_K2TRX6BN */
@@ -0,0 +1,238 @@
+#ifndef MPSC_QUEUE_HPP_J6DT3XAP
+#define MPSC_QUEUE_HPP_J6DT3XAP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+struct MpscQueueStats
+{
+    std::size_t              m_depth;       // pushed but not popped yet
+    std::size_t              m_maxDepth;
+    std::size_t              m_pushed;
+    std::size_t              m_popped;
+    std::chrono::nanoseconds m_meanLatency;    // from push to pop
+    std::chrono::nanoseconds m_maxLatency;
+};
+
+/*
+ * Unbounded lock-free queue any number of threads push to and one thread pops from (Vyukov's intrusive MPSC queue):
+ * a push is a single exchange on the head, producers never wait on each other nor on the consumer.
+ *
+ * Nodes are recycled through a pool shared by every queue of the same T, so once the queues have been through their
+ * busiest moment no push allocates.
+ */
+template <typename T>
+class MpscQueue
+{
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Node
+    {
+        std::atomic<Node*> m_next{ nullptr };
+        std::optional<T>   m_value;
+        Clock::time_point  m_pushTime;
+    };
+
+    /*
+     * Freed nodes go to a shared list; a thread needing one takes the whole list at once into a cache of its own.
+     * Taking everything with one exchange (rather than popping the head with a compare exchange) is what keeps the
+     * list free of the ABA problem.
+     */
+    class NodePool
+    {
+    private:
+        struct Cache
+        {
+            Node* m_head{ nullptr };
+
+            ~Cache()
+            {
+                while (m_head != nullptr) {
+                    auto* next{ m_head->m_next.load(std::memory_order_relaxed) };
+                    release(m_head);
+                    m_head = next;
+                }
+            }
+        };
+
+        // never destroyed: queues and thread caches may give nodes back during static destruction
+        static std::atomic<Node*>& shared()
+        {
+            static auto* head{ new std::atomic<Node*>{ nullptr } };
+            return *head;
+        }
+
+        static Cache& cache()
+        {
+            thread_local Cache cache;
+            return cache;
+        }
+
+    public:
+        static Node* acquire()
+        {
+            auto& cache{ NodePool::cache() };
+            if (cache.m_head == nullptr) {
+                cache.m_head = shared().exchange(nullptr, std::memory_order_acquire);
+                if (cache.m_head == nullptr) {
+                    return new Node{};
+                }
+            }
+
+            auto* node{ cache.m_head };
+            cache.m_head = node->m_next.load(std::memory_order_relaxed);
+            node->m_next.store(nullptr, std::memory_order_relaxed);
+            return node;
+        }
+
+        static void release(Node* node)
+        {
+            auto& head{ shared() };
+            auto* expected{ head.load(std::memory_order_relaxed) };
+            do {
+                node->m_next.store(expected, std::memory_order_relaxed);
+            } while (!head.compare_exchange_weak(expected, node, std::memory_order_release, std::memory_order_relaxed));
+        }
+    };
+
+    // producers
+    alignas(64) std::atomic<Node*> m_head;
+    std::atomic<std::size_t> m_depth{ 0 };
+    std::atomic<std::size_t> m_maxDepth{ 0 };
+    std::atomic<std::size_t> m_pushed{ 0 };
+
+    // consumer
+    alignas(64) Node* m_tail;
+    Node                       m_stub;
+    std::atomic<std::size_t>   m_popped{ 0 };
+    std::atomic<std::uint64_t> m_latencyTotal{ 0 };    // nanoseconds
+    std::atomic<std::uint64_t> m_latencyMax{ 0 };
+
+public:
+    MpscQueue()
+        : m_head{ &m_stub }
+        , m_tail{ &m_stub }
+    {
+    }
+
+    MpscQueue(const MpscQueue&)            = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+    MpscQueue(MpscQueue&&)                 = delete;
+    MpscQueue& operator=(MpscQueue&&)      = delete;
+
+    // no thread may push anymore
+    ~MpscQueue()
+    {
+        while (auto* node{ popNode() }) {
+            delete node;
+        }
+    }
+
+    // @thread_safety: this function can be called from any thread
+    void push(T value)
+    {
+        auto* node{ NodePool::acquire() };
+        node->m_value.emplace(std::move(value));
+        node->m_pushTime = Clock::now();
+
+        // counted before the node is reachable, so the consumer never takes the depth below zero
+        const auto depth{ m_depth.fetch_add(1, std::memory_order_relaxed) + 1 };
+        auto       maxDepth{ m_maxDepth.load(std::memory_order_relaxed) };
+        while (depth > maxDepth && !m_maxDepth.compare_exchange_weak(maxDepth, depth, std::memory_order_relaxed)) { }
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
+
+        pushNode(node);
+    }
+
+    // empty when the queue is empty, or when the producer of the next value is still in the middle of its push (the
+    // value shows up at the next call)
+    // @thread_safety: call this function from the consumer thread only
+    std::optional<T> tryPop()
+    {
+        auto* node{ popNode() };
+        if (node == nullptr) {
+            return std::nullopt;
+        }
+
+        const auto latency{ std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - node->m_pushTime) };
+        const auto latencyNs{ static_cast<std::uint64_t>(latency.count()) };
+        m_latencyTotal.fetch_add(latencyNs, std::memory_order_relaxed);
+        m_latencyMax.store(std::max(m_latencyMax.load(std::memory_order_relaxed), latencyNs), std::memory_order_relaxed);
+        m_popped.fetch_add(1, std::memory_order_relaxed);
+        m_depth.fetch_sub(1, std::memory_order_relaxed);
+
+        std::optional<T> value{ std::move(node->m_value) };
+        node->m_value.reset();
+        NodePool::release(node);
+        return value;
+    }
+
+    // approximate while other threads push or pop
+    std::size_t size() const { return m_depth.load(std::memory_order_relaxed); }
+
+    // @thread_safety: this function can be called from any thread
+    MpscQueueStats getStats() const
+    {
+        const auto popped{ m_popped.load(std::memory_order_relaxed) };
+        const auto total{ m_latencyTotal.load(std::memory_order_relaxed) };
+
+        return {
+            .m_depth       = m_depth.load(std::memory_order_relaxed),
+            .m_maxDepth    = m_maxDepth.load(std::memory_order_relaxed),
+            .m_pushed      = m_pushed.load(std::memory_order_relaxed),
+            .m_popped      = popped,
+            .m_meanLatency = std::chrono::nanoseconds{ popped > 0 ? total / popped : 0 },
+            .m_maxLatency  = std::chrono::nanoseconds{ m_latencyMax.load(std::memory_order_relaxed) },
+        };
+    }
+
+private:
+    void pushNode(Node* node)
+    {
+        node->m_next.store(nullptr, std::memory_order_relaxed);
+        auto* previous{ m_head.exchange(node, std::memory_order_acq_rel) };
+        previous->m_next.store(node, std::memory_order_release);    // until then the consumer can't reach node
+    }
+
+    // the node returned is off the queue and carries a value
+    Node* popNode()
+    {
+        auto* tail{ m_tail };
+        auto* next{ tail->m_next.load(std::memory_order_acquire) };
+
+        if (tail == &m_stub) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            m_tail = next;
+            tail   = next;
+            next   = next->m_next.load(std::memory_order_acquire);
+        }
+
+        if (next != nullptr) {
+            m_tail = next;
+            return tail;
+        }
+
+        if (tail != m_head.load(std::memory_order_acquire)) {
+            return nullptr;    // a push is in progress
+        }
+
+        // tail is the last node: put the stub behind it so it can be taken off
+        pushNode(&m_stub);
+        next = tail->m_next.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            m_tail = next;
+            return tail;
+        }
+        return nullptr;
+    }
+};
+
+#endif /* end of include guard: MPSC_QUEUE_HPP_J6DT3XAP */
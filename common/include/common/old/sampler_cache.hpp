@@ -0,0 +1,208 @@
+#ifndef SAMPLER_CACHE_HPP_H9VTQ3LS
+#define SAMPLER_CACHE_HPP_H9VTQ3LS
+
+#include <algorithm>
+#include <atomic>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+
+// wrap and filter state a texture is sampled with
+struct SamplerParams
+{
+    gl::GLenum m_wrap{ gl::GL_MIRRORED_REPEAT };    // applied to every axis (s, t, r)
+    gl::GLenum m_minFilter{ gl::GL_LINEAR_MIPMAP_NEAREST };
+    gl::GLenum m_magFilter{ gl::GL_LINEAR };
+
+    auto operator<=>(const SamplerParams&) const = default;
+};
+
+// quality settings applied on top of every sampler, can be changed at runtime
+struct SamplerQuality
+{
+    float m_anisotropy{ 1.0f };    // 1: disabled, clamped to the implementation maximum
+    float m_lodBias{ 0.0f };
+
+    bool operator==(const SamplerQuality&) const = default;
+};
+
+/*
+ * Sampler objects keyed by their SamplerParams, so textures that are sampled the same way share one sampler, and
+ * texture units are only rebound when the sampler on them actually changes.
+ *
+ * Each window thread owns one context and the contexts don't share objects, so there is one cache per thread
+ * (see current()). The sampler objects are not deleted by the cache: they live as long as the context does.
+ *
+ * The quality settings are global; every cache picks up a change the next time it binds a sampler.
+ */
+class SamplerCache
+{
+private:
+    static inline std::mutex            s_qualityMutex;
+    static inline SamplerQuality        s_quality;
+    static inline std::atomic<uint64_t> s_qualityGeneration{ 0 };
+
+    std::map<SamplerParams, gl::GLuint> m_samplers;
+    std::vector<gl::GLuint>             m_boundSamplers;    // indexed by texture unit
+    SamplerQuality                      m_quality;
+    uint64_t                            m_qualityGeneration{ 0 };
+    float                               m_maxAnisotropy{ 0.0f };    // 0: not queried yet
+
+    std::size_t m_bindCount{ 0 };
+    std::size_t m_skippedBindCount{ 0 };
+
+public:
+    // the cache of the context current on the calling thread
+    static SamplerCache& current()
+    {
+        thread_local SamplerCache cache;
+        return cache;
+    }
+
+    static void setQuality(const SamplerQuality& quality)
+    {
+        std::lock_guard lock{ s_qualityMutex };
+        if (s_quality != quality) {
+            s_quality = quality;
+            s_qualityGeneration.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    static SamplerQuality getQuality()
+    {
+        std::lock_guard lock{ s_qualityMutex };
+        return s_quality;
+    }
+
+    SamplerCache(const SamplerCache&)            = delete;
+    SamplerCache(SamplerCache&&)                 = delete;
+    SamplerCache& operator=(const SamplerCache&) = delete;
+    SamplerCache& operator=(SamplerCache&&)      = delete;
+
+    gl::GLuint get(const SamplerParams& params)
+    {
+        syncQuality();
+
+        if (auto found{ m_samplers.find(params) }; found != m_samplers.end()) {
+            return found->second;
+        }
+
+        using namespace gl;
+
+        GLuint sampler;
+        glGenSamplers(1, &sampler);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, params.m_wrap);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, params.m_wrap);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, params.m_wrap);
+        glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, params.m_minFilter);
+        glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, params.m_magFilter);
+        applyQuality(sampler, params);
+
+        m_samplers.emplace(params, sampler);
+        return sampler;
+    }
+
+    void bind(gl::GLint unitNum, const SamplerParams& params) { bind(unitNum, get(params)); }
+
+    // sampler 0 unbinds, so the texture's own parameters are used (e.g. framebuffer attachments)
+    void bind(gl::GLint unitNum, gl::GLuint sampler)
+    {
+        const auto unit{ static_cast<std::size_t>(unitNum) };
+        if (unit >= m_boundSamplers.size()) {
+            m_boundSamplers.resize(unit + 1, 0);
+        }
+
+        ++m_bindCount;
+        if (m_boundSamplers[unit] == sampler) {
+            ++m_skippedBindCount;
+            return;
+        }
+
+        gl::glBindSampler(static_cast<gl::GLuint>(unitNum), sampler);
+        m_boundSamplers[unit] = sampler;
+    }
+
+    void unbind(gl::GLint unitNum) { bind(unitNum, gl::GLuint{ 0 }); }
+
+    std::size_t getNumSamplers() const { return m_samplers.size(); }
+
+    std::size_t getBindCount() const { return m_bindCount; }
+
+    std::size_t getSkippedBindCount() const { return m_skippedBindCount; }
+
+private:
+    SamplerCache() = default;
+
+    void syncQuality()
+    {
+        const auto generation{ s_qualityGeneration.load(std::memory_order_acquire) };
+        if (generation == m_qualityGeneration) {
+            return;
+        }
+        m_qualityGeneration = generation;
+        m_quality           = getQuality();
+
+        for (const auto& [params, sampler] : m_samplers) {
+            applyQuality(sampler, params);
+        }
+    }
+
+    void applyQuality(gl::GLuint sampler, const SamplerParams& params)
+    {
+        using namespace gl;
+
+        // lod bias and anisotropy are meaningless without mipmaps
+        if (params.m_minFilter == GL_LINEAR || params.m_minFilter == GL_NEAREST) {
+            return;
+        }
+
+        glSamplerParameterf(sampler, GL_TEXTURE_LOD_BIAS, m_quality.m_lodBias);
+
+        if (m_maxAnisotropy == 0.0f) {
+            m_maxAnisotropy = 1.0f;    // the query is an invalid enum without support
+            if (supportsAnisotropy()) {
+                glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &m_maxAnisotropy);
+            }
+        }
+        if (m_maxAnisotropy > 1.0f) {
+            const auto anisotropy{ std::clamp(m_quality.m_anisotropy, 1.0f, m_maxAnisotropy) };
+            glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY, anisotropy);
+        }
+    }
+
+    // core in 4.6, widely available as EXT_texture_filter_anisotropic before that (same enums)
+    static bool supportsAnisotropy()
+    {
+        using namespace gl;
+
+        GLint major{};
+        GLint minor{};
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 6)) {
+            return true;
+        }
+
+        GLint numExtensions{};
+        glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+        for (GLint i{ 0 }; i < numExtensions; ++i) {
+            const auto* name{ reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i))) };
+            if (name == nullptr) {
+                continue;
+            }
+            const std::string_view extension{ name };
+            if (extension == "GL_EXT_texture_filter_anisotropic" || extension == "GL_ARB_texture_filter_anisotropic") {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif /* end of include guard: SAMPLER_CACHE_HPP_H9VTQ3LS */
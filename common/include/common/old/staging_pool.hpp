@@ -0,0 +1,172 @@
+#ifndef STAGING_POOL_HPP_F3MQZ8VD
+#define STAGING_POOL_HPP_F3MQZ8VD
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/*
+ * Process-wide pool of byte buffers used as staging memory when loading assets (see ImageData). Freed buffers
+ * are kept in power-of-two size classes and handed out again on the next allocation of the same class, so
+ * loading many images in a row does not hit the system allocator for every decode.
+ *
+ * The interface mimics malloc/realloc/free so it can be plugged into C libraries (stb_image uses it).
+ */
+class StagingPool
+{
+public:
+    struct Stats
+    {
+        std::size_t m_hits;
+        std::size_t m_misses;
+        std::size_t m_cachedBytes;
+    };
+
+private:
+    static inline constexpr std::size_t s_minClass{ 6 };     // 64 B
+    static inline constexpr std::size_t s_maxClass{ 28 };    // 256 MiB, larger buffers are not pooled
+    static inline constexpr std::size_t s_numClasses{ s_maxClass - s_minClass + 1 };
+    static inline constexpr std::size_t s_unpooled{ s_numClasses };
+
+    static inline constexpr std::size_t s_maxCachedBytes{ std::size_t(128) << 20 };
+
+    // stored in front of every allocation
+    struct alignas(std::max_align_t) Header
+    {
+        std::size_t m_class;
+        std::size_t m_size;    // requested size
+    };
+
+    std::array<std::vector<Header*>, s_numClasses> m_free;
+    std::mutex                                     m_mutex;
+
+    std::size_t m_cachedBytes{ 0 };
+    std::size_t m_hits{ 0 };
+    std::size_t m_misses{ 0 };
+
+public:
+    static StagingPool& instance()
+    {
+        static StagingPool pool;
+        return pool;
+    }
+
+    StagingPool(const StagingPool&)            = delete;
+    StagingPool(StagingPool&&)                 = delete;
+    StagingPool& operator=(const StagingPool&) = delete;
+    StagingPool& operator=(StagingPool&&)      = delete;
+
+    ~StagingPool() { trim(); }
+
+    void* allocate(std::size_t size)
+    {
+        const auto sizeClass{ classOf(size) };
+
+        Header* header{ nullptr };
+        if (sizeClass != s_unpooled) {
+            std::lock_guard lock{ m_mutex };
+
+            if (auto& list{ m_free[sizeClass] }; !list.empty()) {
+                header = list.back();
+                list.pop_back();
+                m_cachedBytes -= capacityOf(sizeClass);
+                ++m_hits;
+            } else {
+                ++m_misses;
+            }
+        }
+
+        if (header == nullptr) {
+            const auto capacity{ sizeClass != s_unpooled ? capacityOf(sizeClass) : size };
+            header = static_cast<Header*>(std::malloc(sizeof(Header) + capacity));
+            if (header == nullptr) {
+                return nullptr;
+            }
+        }
+
+        header->m_class = sizeClass;
+        header->m_size  = size;
+        return header + 1;
+    }
+
+    void deallocate(void* ptr)
+    {
+        if (ptr == nullptr) {
+            return;
+        }
+
+        auto* header{ static_cast<Header*>(ptr) - 1 };
+        if (header->m_class != s_unpooled) {
+            std::lock_guard lock{ m_mutex };
+
+            const auto capacity{ capacityOf(header->m_class) };
+            if (m_cachedBytes + capacity <= s_maxCachedBytes) {
+                m_free[header->m_class].push_back(header);
+                m_cachedBytes += capacity;
+                return;
+            }
+        }
+        std::free(header);
+    }
+
+    void* reallocate(void* ptr, std::size_t size)
+    {
+        if (ptr == nullptr) {
+            return allocate(size);
+        }
+
+        auto* header{ static_cast<Header*>(ptr) - 1 };
+        if (header->m_class != s_unpooled && size <= capacityOf(header->m_class)) {
+            header->m_size = size;
+            return ptr;
+        }
+
+        void* newPtr{ allocate(size) };
+        if (newPtr == nullptr) {
+            return nullptr;
+        }
+        std::memcpy(newPtr, ptr, std::min(size, header->m_size));
+        deallocate(ptr);
+        return newPtr;
+    }
+
+    // release all the cached buffers back to the system
+    void trim()
+    {
+        std::lock_guard lock{ m_mutex };
+
+        for (auto& list : m_free) {
+            for (auto* header : list) {
+                std::free(header);
+            }
+            list.clear();
+        }
+        m_cachedBytes = 0;
+    }
+
+    Stats getStats()
+    {
+        std::lock_guard lock{ m_mutex };
+        return { .m_hits = m_hits, .m_misses = m_misses, .m_cachedBytes = m_cachedBytes };
+    }
+
+private:
+    StagingPool() = default;
+
+    static std::size_t classOf(std::size_t size)
+    {
+        const auto width{ static_cast<std::size_t>(std::bit_width(std::max<std::size_t>(size, 1) - 1)) };
+        const auto sizeClass{ std::max(width, s_minClass) - s_minClass };
+        return sizeClass < s_numClasses ? sizeClass : s_unpooled;
+    }
+
+    static std::size_t capacityOf(std::size_t sizeClass) { return std::size_t(1) << (sizeClass + s_minClass); }
+};
+
+#endif /* end of include guard: STAGING_POOL_HPP_F3MQZ8VD */
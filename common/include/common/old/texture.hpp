@@ -1,17 +1,28 @@
 #ifndef TEXTURE_HPP_QDZVR1QU
 #define TEXTURE_HPP_QDZVR1QU
 
+#include <cstddef>
 #include <filesystem>
 #include <format>
 #include <iostream>
+#include <limits>
 #include <optional>
 #include <type_traits>
 
 #include <glbinding/gl/gl.h>
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
 
+#include "mapped_file.hpp"
+#include "sampler_cache.hpp"
 #include "shader.hpp"
+#include "staging_pool.hpp"
+#include "texture_residency.hpp"
+
+// decoded images (and stb_image's scratch memory) are allocated from the staging pool
+#define STBI_MALLOC(size)       StagingPool::instance().allocate(size)
+#define STBI_REALLOC(ptr, size) StagingPool::instance().reallocate(ptr, size)
+#define STBI_FREE(ptr)          StagingPool::instance().deallocate(ptr)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
 
 class ImageData
 {
@@ -52,12 +63,32 @@ private:
 public:
     static std::optional<ImageData> from(std::filesystem::path imagePath, bool flipVertically = true)
     {
-        stbi_set_flip_vertically_on_load(flipVertically);
+        auto maybeFile{ MappedFile::open(imagePath, MappedFile::Advice::SEQUENTIAL) };
+        if (!maybeFile) {
+            std::cerr << std::format("Failed to load image at {}\n", imagePath.string());
+            return {};
+        }
+
+        auto maybeImageData{ fromMemory(maybeFile->data(), maybeFile->size(), flipVertically) };
+        if (!maybeImageData) {
+            std::cerr << std::format("Failed to load image at {}\n", imagePath.string());
+        }
+        return maybeImageData;
+    }
+
+    // decode an encoded image (png, jpg, ...) that is already in memory
+    static std::optional<ImageData> fromMemory(const unsigned char* encoded, std::size_t size, bool flipVertically = true)
+    {
+        if (size > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+            return {};
+        }
+
+        // images are decoded on several threads at once (loader, job workers): the flag must be per thread
+        stbi_set_flip_vertically_on_load_thread(flipVertically);
 
         int            width, height, nrChannels;
-        unsigned char* data{ stbi_load(imagePath.c_str(), &width, &height, &nrChannels, 0) };
+        unsigned char* data{ stbi_load_from_memory(encoded, static_cast<int>(size), &width, &height, &nrChannels, 0) };
         if (!data) {
-            std::cerr << std::format("Failed to load image at {}\n", imagePath.string());
             return {};
         }
         return ImageData{ width, height, nrChannels, data };
@@ -88,23 +119,34 @@ protected:
     gl::GLuint       m_id;
     gl::GLint        m_unitNum;
     std::string      m_uniformName;
+    SamplerParams    m_samplerParams;
+
+    TextureResidency::Handle m_residency{ nullptr };
 
 protected:
     Texture() = delete;
 
-    Texture(gl::GLenum target, gl::GLint unitNum, const std::string& uniformName)
+    Texture(gl::GLenum target, gl::GLint unitNum, const std::string& uniformName, const SamplerParams& params)
         : m_target{ target }
         , m_id{ 0 }
         , m_unitNum{ unitNum }
         , m_uniformName{ uniformName }
+        , m_samplerParams{ params }
     {
     }
 
-    Texture(gl::GLenum target, gl::GLuint id, gl::GLint unitNum, const std::string& uniformName)
+    Texture(
+        gl::GLenum           target,
+        gl::GLuint           id,
+        gl::GLint            unitNum,
+        const std::string&   uniformName,
+        const SamplerParams& params
+    )
         : m_target{ target }
         , m_id{ id }
         , m_unitNum{ unitNum }
         , m_uniformName{ uniformName }
+        , m_samplerParams{ params }
     {
     }
 
@@ -119,17 +161,83 @@ public:
 
     void setUniformName(const std::string& name) { m_uniformName = name; }
 
-    void activate(Shader& shader) const
+    const SamplerParams& getSamplerParams() const { return m_samplerParams; }
+
+    // takes effect on the next bind, the texture itself is not touched
+    void setSamplerParams(const SamplerParams& params) { m_samplerParams = params; }
+
+    void activate(Shader& shader) const { activate(shader, m_uniformName, m_unitNum); }
+
+    // activate using a uniform name and texture unit other than the texture's own; for texture objects that
+    // are shared between users that bind them differently (see TextureCache)
+    void activate(Shader& shader, const std::string& uniformName, gl::GLint unitNum) const
     {
-        shader.setUniform(m_uniformName, m_unitNum);
-        gl::glActiveTexture(gl::GL_TEXTURE0 + std::underlying_type_t<gl::GLenum>(m_unitNum));
+        activate(shader, uniformName, unitNum, m_samplerParams);
+    }
+
+    // same, also sampling it with params other than the texture's own
+    void activate(Shader& shader, const std::string& uniformName, gl::GLint unitNum, const SamplerParams& params) const
+    {
+        shader.setUniform(uniformName, unitNum);
+        bind(unitNum, params);
+    }
+
+    // bind to the texture unit, along with the sampler object for its sampler params, without touching any
+    // shader (the sampler uniform is assumed already set)
+    void bind() const { bind(m_unitNum); }
+
+    void bind(gl::GLint unitNum) const { bind(unitNum, m_samplerParams); }
+
+    void bind(gl::GLint unitNum, const SamplerParams& params) const
+    {
+        TextureResidency::instance().touch(m_residency);
+        gl::glActiveTexture(gl::GL_TEXTURE0 + std::underlying_type_t<gl::GLenum>(unitNum));
         gl::glBindTexture(m_target, m_id);
+        SamplerCache::current().bind(unitNum, params);
     }
+
+protected:
+    // account the texture storage; an evictable texture must implement evictStorage() and restoreStorage()
+    void trackResidency(TextureResidency::Kind kind, std::size_t bytes, bool evictable)
+    {
+        if (evictable) {
+            m_residency = TextureResidency::instance().track(
+                this, kind, bytes, [this] { return evictStorage(); }, [this] { return restoreStorage(); }
+            );
+        } else {
+            m_residency = TextureResidency::instance().track(this, kind, bytes);
+        }
+    }
+
+    // to be called by the move constructor of the derived class
+    void moveResidency(const Texture& other)
+    {
+        TextureResidency::instance().retrack(
+            &other, this, [this] { return evictStorage(); }, [this] { return restoreStorage(); }
+        );
+        m_residency = other.m_residency;
+    }
+
+    // stop accounting it; a derived class with evictStorage() or restoreStorage() calls it first in its destructor,
+    // as they may still be running on other threads until then
+    void releaseResidency()
+    {
+        TextureResidency::instance().untrack(this);
+        m_residency = nullptr;
+    }
+
+    // shrink the storage; returns the bytes still resident
+    virtual std::size_t evictStorage() { return 0; }
+
+    // read the full storage back, on a worker thread (no gl calls); returns the upload, done later by the thread
+    // binding the texture, or nothing if it failed
+    virtual TextureResidency::Callback restoreStorage() { return {}; }
 };
 
 // handle the deletion of the texture object, the derived class doesn't need to worry about it
 inline Texture::~Texture()
 {
+    releaseResidency();
     if (m_id != 0) {
         gl::glDeleteTextures(1, &m_id);
     }
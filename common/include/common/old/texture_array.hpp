@@ -0,0 +1,330 @@
+#ifndef TEXTURE_ARRAY_HPP_WQ3NHZKE
+#define TEXTURE_ARRAY_HPP_WQ3NHZKE
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "shader.hpp"
+#include "texture.hpp"
+
+// the place a packed texture occupies inside a TextureArray.
+// a texture that has the same size as the array gets a whole layer for itself (uv rect of [0, 0, 1, 1]),
+// smaller textures are packed together into an atlas layer and get a sub-rectangle of it.
+struct TextureSlot
+{
+    gl::GLint m_layer;
+    glm::vec4 m_uvRect;    // xy: offset, zw: scale (normalized to the layer size)
+
+    // the glsl side is expected to have this struct:
+    //
+    //     struct TextureSlot
+    //     {
+    //         float m_layer;
+    //         vec4  m_uvRect;
+    //     };
+    void applyUniforms(Shader& shader, const std::string& name) const
+    {
+        shader.setUniform(name + ".m_layer", static_cast<float>(m_layer));
+        shader.setUniform(name + ".m_uvRect", m_uvRect);
+    }
+};
+
+class TextureArray final : public Texture
+{
+public:
+    friend class TextureArrayPacker;
+
+private:
+    // clamped so the atlas neighbours don't bleed in at the slot edges
+    static inline constexpr SamplerParams s_samplerParams{
+        .m_wrap      = gl::GL_CLAMP_TO_EDGE,
+        .m_minFilter = gl::GL_LINEAR_MIPMAP_NEAREST,
+        .m_magFilter = gl::GL_LINEAR,
+    };
+
+    gl::GLsizei                                  m_width;
+    gl::GLsizei                                  m_height;
+    gl::GLsizei                                  m_numLayers;
+    std::map<std::filesystem::path, TextureSlot> m_slots;
+
+public:
+    TextureArray(const TextureArray&) = delete;
+
+    TextureArray(TextureArray&& other) noexcept
+        : Texture{ gl::GL_TEXTURE_2D_ARRAY, other.m_id, other.m_unitNum, other.m_uniformName, other.m_samplerParams }
+        , m_width{ other.m_width }
+        , m_height{ other.m_height }
+        , m_numLayers{ other.m_numLayers }
+        , m_slots{ std::move(other.m_slots) }
+    {
+        other.m_id = 0;
+        moveResidency(other);
+    }
+
+    bool contains(const std::filesystem::path& imagePath) const { return m_slots.contains(imagePath); }
+
+    std::optional<TextureSlot> getSlot(const std::filesystem::path& imagePath) const
+    {
+        if (auto found{ m_slots.find(imagePath) }; found != m_slots.end()) {
+            return found->second;
+        }
+        std::cerr << std::format("ERROR: [TextureArray] '{}' is not packed in this array\n", imagePath.string());
+        return {};
+    }
+
+    gl::GLsizei getWidth() const { return m_width; }
+
+    gl::GLsizei getHeight() const { return m_height; }
+
+    gl::GLsizei getNumLayers() const { return m_numLayers; }
+
+private:
+    TextureArray(gl::GLint textureUnitNum, const std::string& uniformName)
+        : Texture{ gl::GL_TEXTURE_2D_ARRAY, textureUnitNum, uniformName, s_samplerParams }
+        , m_width{ 0 }
+        , m_height{ 0 }
+        , m_numLayers{ 0 }
+    {
+    }
+};
+
+// Combines images into one GL_TEXTURE_2D_ARRAY so that a group of objects can be drawn with a single
+// texture bound. The layer size is the size of the largest image; images of that exact size get their
+// own layer while the odd-sized ones are shelf-packed into atlas layers.
+class TextureArrayPacker
+{
+private:
+    struct Entry
+    {
+        std::filesystem::path m_path;
+        ImageData             m_image;
+    };
+
+    struct Placement
+    {
+        std::size_t m_entry;
+        gl::GLint   m_layer;
+        gl::GLint   m_x;
+        gl::GLint   m_y;
+    };
+
+    std::vector<Entry> m_entries;
+    gl::GLint          m_padding;
+
+public:
+    // padding is the gap (in pixels) between images inside an atlas layer, to reduce bleeding from the
+    // neighbours when sampling with linear filtering and mipmaps.
+    TextureArrayPacker(gl::GLint padding = 8)
+        : m_padding{ padding }
+    {
+    }
+
+    // adding the same path twice is allowed, the image will only be loaded and packed once
+    bool add(const std::filesystem::path& imagePath)
+    {
+        auto found{ std::ranges::find(m_entries, imagePath, &Entry::m_path) };
+        if (found != m_entries.end()) {
+            return true;
+        }
+
+        auto maybeImageData{ ImageData::from(imagePath) };
+        if (!maybeImageData) {
+            return false;
+        }
+        m_entries.push_back({ imagePath, std::move(*maybeImageData) });
+        return true;
+    }
+
+    [[nodiscard]]
+    std::optional<TextureArray> pack(const std::string& uniformName, gl::GLint textureUnitNum)
+    {
+        if (m_entries.empty()) {
+            std::cerr << "ERROR: [TextureArrayPacker] Nothing to pack\n";
+            return {};
+        }
+
+        TextureArray array{ textureUnitNum, uniformName };
+
+        for (const auto& entry : m_entries) {
+            array.m_width  = std::max(array.m_width, entry.m_image.m_width);
+            array.m_height = std::max(array.m_height, entry.m_image.m_height);
+        }
+
+        auto [placements, numLayers]{ place(array.m_width, array.m_height) };
+        array.m_numLayers = numLayers;
+
+        const auto width{ static_cast<float>(array.m_width) };
+        const auto height{ static_cast<float>(array.m_height) };
+
+        for (const auto& [index, layer, x, y] : placements) {
+            const auto& [path, image]{ m_entries[index] };
+            array.m_slots.emplace(
+                path,
+                TextureSlot{
+                    .m_layer  = layer,
+                    .m_uvRect = {
+                        static_cast<float>(x) / width,
+                        static_cast<float>(y) / height,
+                        static_cast<float>(image.m_width) / width,
+                        static_cast<float>(image.m_height) / height,
+                    },
+                }
+            );
+        }
+
+        upload(array, placements);
+
+        // the source images are gone after packing, so the array can't be restreamed
+        const auto bytes{ TextureResidency::computeBytes(
+            std::size_t(array.m_width),
+            std::size_t(array.m_height),
+            std::size_t(array.m_numLayers),
+            TextureResidency::bytesPerTexel(gl::GL_RGBA8),
+            true
+        ) };
+        array.trackResidency(TextureResidency::Kind::ARRAY, bytes, false);
+
+        std::cout << std::format(
+            "INFO: [TextureArrayPacker] Packed {} textures into {} layers of {}x{}\n",
+            m_entries.size(),
+            array.m_numLayers,
+            array.m_width,
+            array.m_height
+        );
+
+        m_entries.clear();
+        return array;
+    }
+
+private:
+    // returns the placements and the number of layers needed
+    std::pair<std::vector<Placement>, gl::GLsizei> place(gl::GLsizei width, gl::GLsizei height) const
+    {
+        std::vector<Placement> placements;
+        placements.reserve(m_entries.size());
+
+        gl::GLint layer{ 0 };
+
+        // full size images: one layer each
+        std::vector<std::size_t> odds;
+        for (std::size_t i{ 0 }; i < m_entries.size(); ++i) {
+            const auto& image{ m_entries[i].m_image };
+            if (image.m_width == width && image.m_height == height) {
+                placements.push_back({ .m_entry = i, .m_layer = layer++, .m_x = 0, .m_y = 0 });
+            } else {
+                odds.push_back(i);
+            }
+        }
+
+        if (odds.empty()) {
+            return { std::move(placements), layer };
+        }
+
+        // odd size images: shelf packing, tallest first
+        std::ranges::sort(odds, std::greater{}, [this](std::size_t i) { return m_entries[i].m_image.m_height; });
+
+        gl::GLint cursorX{ 0 };
+        gl::GLint cursorY{ 0 };
+        gl::GLint shelfHeight{ 0 };
+
+        for (auto i : odds) {
+            const auto& image{ m_entries[i].m_image };
+
+            if (cursorX + image.m_width > width) {    // next shelf
+                cursorX     = 0;
+                cursorY    += shelfHeight + m_padding;
+                shelfHeight = 0;
+            }
+            if (cursorY + image.m_height > height) {    // next atlas layer
+                cursorX     = 0;
+                cursorY     = 0;
+                shelfHeight = 0;
+                ++layer;
+            }
+
+            placements.push_back({ .m_entry = i, .m_layer = layer, .m_x = cursorX, .m_y = cursorY });
+
+            cursorX     += image.m_width + m_padding;
+            shelfHeight  = std::max(shelfHeight, image.m_height);
+        }
+
+        return { std::move(placements), layer + 1 };
+    }
+
+    void upload(TextureArray& array, const std::vector<Placement>& placements) const
+    {
+        using namespace gl;
+
+        glGenTextures(1, &array.m_id);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.m_id);
+
+        // the content of a new texture is undefined; zero it so the atlas padding is transparent black
+        const std::vector<unsigned char> zeros(std::size_t(array.m_width * array.m_height * array.m_numLayers) * 4);
+        glTexImage3D(
+            GL_TEXTURE_2D_ARRAY,
+            0,
+            GL_RGBA8,
+            array.m_width,
+            array.m_height,
+            array.m_numLayers,
+            0,
+            GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            zeros.data()
+        );
+
+        // rgb rows are not necessarily 4-byte aligned
+        GLint alignment{};
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        for (const auto& [index, layer, x, y] : placements) {
+            const auto& image{ m_entries[index].m_image };
+
+            const auto subImage = [&](GLenum format, const void* data) {
+                glTexSubImage3D(
+                    GL_TEXTURE_2D_ARRAY,
+                    0,
+                    x,
+                    y,
+                    layer,
+                    image.m_width,
+                    image.m_height,
+                    1,
+                    format,
+                    GL_UNSIGNED_BYTE,
+                    data
+                );
+            };
+
+            if (image.m_nrChannels == 4) {
+                subImage(GL_RGBA, image.m_data);
+            } else if (image.m_nrChannels == 3) {
+                subImage(GL_RGB, image.m_data);
+            } else {
+                // pad data if not rgb or rgba
+                auto newData{ ImageData::addPadding(image) };
+                subImage(GL_RGBA, &newData.front());
+            }
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+};
+
+#endif /* end of include guard: TEXTURE_ARRAY_HPP_WQ3NHZKE */
@@ -0,0 +1,143 @@
+#ifndef TEXTURE_CACHE_HPP_J7XRMB2D
+#define TEXTURE_CACHE_HPP_J7XRMB2D
+
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include "image_texture.hpp"
+
+/*
+ * Process-wide cache of image textures, so the same file is decoded and uploaded only once no matter how many
+ * models, materials or windows use it. Textures are keyed by their canonical path only and handed out as shared
+ * (ref-counted) handles: how a texture is sampled is a property of the sampler object bound next to it, not of the
+ * texture, so users sampling the same image differently still share it.
+ *
+ * A texture is read, decoded and uploaded without holding the cache lock, so different textures load at the same time
+ * on different threads; a thread asking for a texture that another one is loading waits for that one only.
+ *
+ * The cache only holds weak references: a texture is deleted as soon as its last user releases it, so it must
+ * be released on a thread that has a context of the same share group current. For the same reason the cached
+ * textures are only usable by windows whose contexts share objects with the one that loaded them.
+ *
+ * The uniform name, texture unit and sampler params of a cached texture are meaningless, since every user binds it
+ * differently. Use `Texture::activate(shader, uniformName, unitNum, params)` instead.
+ */
+class TextureCache
+{
+public:
+    using Handle = std::shared_ptr<const ImageTexture>;
+
+private:
+    struct Entry
+    {
+        std::weak_ptr<const ImageTexture>         m_texture;
+        std::shared_future<std::optional<Handle>> m_loading;    // valid while a thread loads it
+    };
+
+    std::map<std::filesystem::path, Entry> m_textures;
+    std::mutex                             m_mutex;
+
+    std::size_t m_hits{ 0 };
+    std::size_t m_misses{ 0 };
+
+public:
+    static TextureCache& instance()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    TextureCache(const TextureCache&)            = delete;
+    TextureCache(TextureCache&&)                 = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+    TextureCache& operator=(TextureCache&&)      = delete;
+
+    // @thread_safety: can be called from any thread that has a context current
+    [[nodiscard]]
+    std::optional<Handle> load(const std::filesystem::path& imagePath)
+    {
+        std::error_code ec;
+        auto            canonical{ std::filesystem::weakly_canonical(imagePath, ec) };
+        if (ec) {
+            canonical = imagePath;
+        }
+
+        std::promise<std::optional<Handle>>       promise;
+        std::shared_future<std::optional<Handle>> loading;
+        {
+            std::lock_guard lock{ m_mutex };
+
+            auto& entry{ m_textures[canonical] };
+            if (auto texture{ entry.m_texture.lock() }; texture) {
+                ++m_hits;
+                return texture;
+            }
+            if (entry.m_loading.valid()) {
+                ++m_hits;
+                loading = entry.m_loading;
+            } else {
+                ++m_misses;
+                entry.m_loading = promise.get_future().share();
+            }
+        }
+        if (loading.valid()) {
+            return loading.get();
+        }
+
+        std::optional<Handle> texture;
+        if (auto maybeTexture{ ImageTexture::from(canonical, "", 0) }; maybeTexture) {
+            texture = std::make_shared<const ImageTexture>(std::move(*maybeTexture));
+            std::cout << std::format("INFO: [TextureCache] Texture '{}' loaded\n", canonical.string());
+        }
+
+        {
+            std::lock_guard lock{ m_mutex };
+
+            auto& entry{ m_textures.at(canonical) };    // not pruned while loading
+            entry.m_texture = texture.value_or(nullptr);
+            entry.m_loading = {};
+        }
+        promise.set_value(texture);
+        return texture;
+    }
+
+    // remove entries whose texture has been released
+    void prune()
+    {
+        std::lock_guard lock{ m_mutex };
+        std::erase_if(m_textures, [](const auto& entry) {
+            return entry.second.m_texture.expired() && !entry.second.m_loading.valid();
+        });
+    }
+
+    struct Stats
+    {
+        std::size_t m_alive;
+        std::size_t m_hits;
+        std::size_t m_misses;
+    };
+
+    Stats getStats()
+    {
+        std::lock_guard lock{ m_mutex };
+
+        std::size_t alive{ 0 };
+        for (const auto& [_, entry] : m_textures) {
+            alive += !entry.m_texture.expired();
+        }
+        return { .m_alive = alive, .m_hits = m_hits, .m_misses = m_misses };
+    }
+
+private:
+    TextureCache() = default;
+};
+
+#endif /* end of include guard: TEXTURE_CACHE_HPP_J7XRMB2D */
@@ -0,0 +1,453 @@
+#ifndef TEXTURE_RESIDENCY_HPP_P4CWN8QE
+#define TEXTURE_RESIDENCY_HPP_P4CWN8QE
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include <glbinding/gl/gl.h>
+
+#include "job_system.hpp"
+
+/*
+ * Accounts the GPU memory of every texture, cubemap and framebuffer attachment (mip chains included) against a
+ * process-wide budget. When the budget is exceeded, the least recently bound evictable textures are shrunk (to a
+ * low resolution mip or a placeholder) and are restreamed in full once they are bound again: the images are read
+ * and decoded by the job system, and the upload lands at a later bind, the low resolution version being drawn until
+ * then.
+ *
+ * A texture is evicted and restored by the thread that owns it, the one with a context current to do it: first the
+ * thread that created it, then the last thread that bound it (so a texture uploaded on a loader context belongs to
+ * the thread that draws with it). The accounting is still global: a thread that goes over budget evicts its own
+ * textures first, the other threads catch up the next time they bind or create a texture.
+ *
+ * Binding is on the hot path, so touch() takes no lock unless there is something to do: it stamps the entry the
+ * texture holds a handle to, and only locks when the texture is evicted, changes owner, or the budget is exceeded
+ * while the thread still has something to evict.
+ *
+ * While an entry is being evicted or restored its callbacks run without the lock held; untrack() and retrack() wait
+ * for them to finish, so the object they call into stays alive and in place.
+ */
+class TextureResidency
+{
+public:
+    enum class Kind : std::size_t
+    {
+        IMAGE,
+        ARRAY,
+        CUBEMAP,
+        ATTACHMENT,
+
+        COUNT,
+    };
+
+    using Key      = const void*;
+    using Callback = std::function<std::size_t()>;    // returns the bytes resident after the call
+
+    // reads and decodes the full storage on a worker thread, without a context; returns the upload, run by the owner
+    // thread at its next bind (empty: failed, the low resolution version stays for good)
+    using Restore = std::function<Callback()>;
+
+    static inline constexpr std::size_t s_unlimited{ std::numeric_limits<std::size_t>::max() };
+
+    struct Stats
+    {
+        std::size_t m_budget;
+        std::size_t m_resident;
+        std::size_t m_peak;
+        std::size_t m_numTracked;
+        std::size_t m_numEvicted;
+        std::size_t m_evictions;
+        std::size_t m_restores;
+
+        std::array<std::size_t, static_cast<std::size_t>(Kind::COUNT)> m_residentPerKind;
+    };
+
+private:
+    enum class State : std::uint8_t
+    {
+        RESIDENT,
+        EVICTING,     // evict() running on the owner thread
+        EVICTED,
+        DECODING,     // restore() running on a worker
+        DECODED,      // the upload waits for the owner to bind it
+        UPLOADING,    // the upload running on the owner thread
+        DEGRADED,     // restoring failed, it stays evicted
+    };
+
+    // the map nodes are never reallocated (retrack moves the node itself), so handles stay valid until untrack
+    struct Entry
+    {
+        Kind                         m_kind{};
+        std::size_t                  m_bytes{ 0 };
+        std::atomic<std::uint64_t>   m_lastUse{ 0 };
+        std::atomic<std::thread::id> m_owner;
+        std::atomic<State>           m_state{ State::RESIDENT };    // written with m_mutex held
+        Callback                     m_evict;                       // empty if not evictable
+        Restore                      m_restore;
+        Callback                     m_upload;                      // DECODED only
+    };
+
+public:
+    using Handle = Entry*;    // to the entry of a tracked resource, for touch()
+
+private:
+    static inline constexpr std::uint64_t s_never{ std::numeric_limits<std::uint64_t>::max() };
+
+    // the m_evictables value at which enforce() last found nothing this thread can evict
+    static inline thread_local std::uint64_t s_exhaustedAt{ s_never };
+
+    std::unordered_map<Key, Entry> m_entries;
+    std::mutex                     m_mutex;
+    std::condition_variable        m_idle;    // an entry left EVICTING, DECODING or UPLOADING
+
+    std::size_t                m_budget{ s_unlimited };
+    std::size_t                m_resident{ 0 };
+    std::size_t                m_peak{ 0 };
+    std::size_t                m_evictions{ 0 };
+    std::size_t                m_restores{ 0 };
+    std::atomic<std::uint64_t> m_clock{ 0 };
+    std::atomic<std::uint64_t> m_evictables{ 0 };       // bumped whenever what a thread can evict may have changed
+    std::atomic<bool>          m_overBudget{ false };    // m_resident > m_budget, for touch() to read without locking
+    bool                       m_warned{ false };
+
+public:
+    static TextureResidency& instance()
+    {
+        static TextureResidency residency;
+        return residency;
+    }
+
+    TextureResidency(const TextureResidency&)            = delete;
+    TextureResidency(TextureResidency&&)                 = delete;
+    TextureResidency& operator=(const TextureResidency&) = delete;
+    TextureResidency& operator=(TextureResidency&&)      = delete;
+
+    // bytes used by a texture of the given size; depth is the number of layers (or faces)
+    static std::size_t computeBytes(
+        std::size_t width,
+        std::size_t height,
+        std::size_t depth,
+        std::size_t bytesPerTexel,
+        bool        mipmapped
+    )
+    {
+        std::size_t bytes{ width * height * depth * bytesPerTexel };
+        while (mipmapped && (width > 1 || height > 1)) {
+            width   = std::max<std::size_t>(1, width / 2);
+            height  = std::max<std::size_t>(1, height / 2);
+            bytes  += width * height * depth * bytesPerTexel;
+        }
+        return bytes;
+    }
+
+    // what the driver allocates per texel of an internal format; 3-byte formats are padded to 4 bytes by most
+    // drivers, so they are accounted as such
+    static constexpr std::size_t bytesPerTexel(gl::GLenum internalFormat)
+    {
+        switch (internalFormat) {
+        case gl::GL_RED:
+        case gl::GL_R8: return 1;
+        case gl::GL_RG:
+        case gl::GL_RG8: return 2;
+        case gl::GL_RGBA16F: return 8;
+        case gl::GL_RGBA32F: return 16;
+        default: return 4;    // RGB8, RGBA8, their srgb variants, DEPTH24_STENCIL8, ...
+        }
+    }
+
+    void setBudget(std::size_t bytes)
+    {
+        {
+            std::lock_guard lock{ m_mutex };
+            m_budget = bytes;
+            m_warned = false;
+            m_overBudget.store(m_resident > m_budget, std::memory_order_relaxed);
+        }
+        enforce();
+    }
+
+    // a resource with no evict callback is only accounted, never evicted; the handle is for touch()
+    Handle track(Key key, Kind kind, std::size_t bytes, Callback evict = {}, Restore restore = {})
+    {
+        Entry* entry{ nullptr };
+        {
+            std::unique_lock lock{ m_mutex };
+
+            auto [it, inserted]{ m_entries.try_emplace(key) };
+            entry = &it->second;
+            m_idle.wait(lock, [entry] { return !isBusy(entry->m_state.load(std::memory_order_relaxed)); });
+            account(inserted ? 0 : entry->m_bytes, bytes);
+
+            entry->m_kind    = kind;
+            entry->m_bytes   = bytes;
+            entry->m_evict   = std::move(evict);
+            entry->m_restore = std::move(restore);
+            entry->m_upload  = {};
+            entry->m_lastUse.store(m_clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            entry->m_owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+            entry->m_state.store(State::RESIDENT, std::memory_order_release);
+            m_evictables.fetch_add(1, std::memory_order_relaxed);
+        }
+        enforce(entry);
+        return entry;
+    }
+
+    // the tracked object is moved to a new address; its handle stays the same
+    void retrack(Key from, Key to, Callback evict = {}, Restore restore = {})
+    {
+        std::unique_lock lock{ m_mutex };
+
+        m_idle.wait(lock, [&] {
+            auto found{ m_entries.find(from) };
+            return found == m_entries.end() || !isBusy(found->second.m_state.load(std::memory_order_relaxed));
+        });
+
+        auto node{ m_entries.extract(from) };
+        if (node.empty()) {
+            return;
+        }
+        node.key() = to;
+
+        auto& entry{ node.mapped() };
+        if (entry.m_evict) {
+            entry.m_evict   = std::move(evict);
+            entry.m_restore = std::move(restore);
+        }
+        if (entry.m_state.load(std::memory_order_relaxed) == State::DECODED) {
+            entry.m_upload = {};    // it uploads into the object at the old address, decoded again when bound
+            entry.m_state.store(State::EVICTED, std::memory_order_release);
+        }
+        m_entries.insert(std::move(node));
+    }
+
+    // the tracked storage is reallocated with a different size (e.g. framebuffer resize)
+    void resize(Key key, std::size_t bytes)
+    {
+        Entry* entry{ nullptr };
+        {
+            std::lock_guard lock{ m_mutex };
+
+            auto found{ m_entries.find(key) };
+            if (found == m_entries.end()) {
+                return;
+            }
+            entry = &found->second;
+            account(entry->m_bytes, bytes);
+            entry->m_bytes = bytes;
+        }
+        enforce(entry);
+    }
+
+    void untrack(Key key)
+    {
+        std::unique_lock lock{ m_mutex };
+
+        m_idle.wait(lock, [&] {
+            auto found{ m_entries.find(key) };
+            return found == m_entries.end() || !isBusy(found->second.m_state.load(std::memory_order_relaxed));
+        });
+
+        if (auto found{ m_entries.find(key) }; found != m_entries.end()) {
+            account(found->second.m_bytes, 0);
+            m_entries.erase(found);
+            m_evictables.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // mark as used and take the resource over for the calling thread; an evicted resource is restreamed in the
+    // background and its upload done at a later call. call before binding, with the handle track() returned (null:
+    // not tracked)
+    void touch(Handle entry)
+    {
+        if (entry == nullptr) {
+            return;
+        }
+
+        entry->m_lastUse.store(m_clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        const auto self{ std::this_thread::get_id() };
+        const auto state{ entry->m_state.load(std::memory_order_acquire) };
+        const bool owned{ entry->m_owner.load(std::memory_order_relaxed) == self };
+        const bool settled{ state == State::RESIDENT || state == State::DEGRADED || state == State::DECODING };
+        if (owned && settled && !shouldEnforce()) {
+            return;
+        }
+
+        bool     decode{ false };
+        Callback upload;
+        {
+            std::lock_guard lock{ m_mutex };
+
+            const auto current{ entry->m_state.load(std::memory_order_relaxed) };
+            if (isBusy(current) && current != State::DECODING) {
+                return;    // another thread is evicting or uploading it: bound as it is
+            }
+            if (entry->m_owner.load(std::memory_order_relaxed) != self) {
+                entry->m_owner.store(self, std::memory_order_relaxed);
+                m_evictables.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (current == State::EVICTED) {
+                entry->m_state.store(State::DECODING, std::memory_order_relaxed);
+                decode = true;
+            } else if (current == State::DECODED) {
+                entry->m_state.store(State::UPLOADING, std::memory_order_relaxed);
+                upload = std::exchange(entry->m_upload, {});
+            }
+        }
+
+        if (decode) {
+            // retrack and untrack wait while it decodes, so the entry and m_restore stay as they are
+            JobSystem::instance().submit([this, entry] { finishDecoding(entry, entry->m_restore()); });
+        }
+
+        if (upload) {
+            const auto bytes{ upload() };
+
+            std::lock_guard lock{ m_mutex };
+            account(entry->m_bytes, bytes);
+            entry->m_bytes = bytes;
+            entry->m_state.store(State::RESIDENT, std::memory_order_release);
+            ++m_restores;
+            m_evictables.fetch_add(1, std::memory_order_relaxed);
+            m_idle.notify_all();
+        }
+
+        if (shouldEnforce()) {
+            enforce(entry);
+        }
+    }
+
+    // evict the least recently used resources of the calling thread until within budget
+    void enforce() { enforce(nullptr); }
+
+    Stats getStats()
+    {
+        std::lock_guard lock{ m_mutex };
+
+        Stats stats{
+            .m_budget          = m_budget,
+            .m_resident        = m_resident,
+            .m_peak            = m_peak,
+            .m_numTracked      = m_entries.size(),
+            .m_numEvicted      = 0,
+            .m_evictions       = m_evictions,
+            .m_restores        = m_restores,
+            .m_residentPerKind = {},
+        };
+        for (const auto& [_, entry] : m_entries) {
+            const auto kind{ static_cast<std::size_t>(entry.m_kind) };
+            stats.m_numEvicted            += entry.m_state.load(std::memory_order_relaxed) != State::RESIDENT;
+            stats.m_residentPerKind[kind] += entry.m_bytes;
+        }
+        return stats;
+    }
+
+private:
+    TextureResidency() = default;
+
+    static bool isBusy(State state)
+    {
+        return state == State::EVICTING || state == State::DECODING || state == State::UPLOADING;
+    }
+
+    // over budget, and this thread may have something to evict since it last found nothing
+    bool shouldEnforce() const
+    {
+        return m_overBudget.load(std::memory_order_relaxed)
+            && s_exhaustedAt != m_evictables.load(std::memory_order_relaxed);
+    }
+
+    void finishDecoding(Entry* entry, Callback&& upload)
+    {
+        std::lock_guard lock{ m_mutex };
+
+        if (upload) {
+            entry->m_upload = std::move(upload);
+            entry->m_state.store(State::DECODED, std::memory_order_release);
+        } else {
+            entry->m_state.store(State::DEGRADED, std::memory_order_release);
+        }
+        m_idle.notify_all();
+    }
+
+    void enforce(const Entry* keep)
+    {
+        const auto threadId{ std::this_thread::get_id() };
+
+        while (true) {
+            Entry*      victim{ nullptr };
+            Callback    evict;
+            std::size_t oldBytes{ 0 };
+            {
+                std::lock_guard lock{ m_mutex };
+
+                if (m_resident <= m_budget) {
+                    m_warned = false;
+                    return;
+                }
+
+                std::uint64_t oldest{ std::numeric_limits<std::uint64_t>::max() };
+                for (auto& [_, entry] : m_entries) {
+                    if (&entry == keep || entry.m_state.load(std::memory_order_relaxed) != State::RESIDENT
+                        || !entry.m_evict || entry.m_owner.load(std::memory_order_relaxed) != threadId) {
+                        continue;
+                    }
+                    if (const auto lastUse{ entry.m_lastUse.load(std::memory_order_relaxed) }; lastUse < oldest) {
+                        oldest = lastUse;
+                        victim = &entry;
+                    }
+                }
+
+                if (victim == nullptr) {
+                    s_exhaustedAt = m_evictables.load(std::memory_order_relaxed);
+                    if (!m_warned) {
+                        std::cerr << std::format(
+                            "WARNING: [TextureResidency] Over budget ({} / {} bytes) with nothing left to evict\n",
+                            m_resident,
+                            m_budget
+                        );
+                        m_warned = true;
+                    }
+                    return;
+                }
+
+                // only marked evicted once evict() returns: a touch() on another thread meanwhile leaves it alone
+                victim->m_state.store(State::EVICTING, std::memory_order_relaxed);
+                evict    = victim->m_evict;
+                oldBytes = victim->m_bytes;
+            }
+
+            const auto bytes{ evict() };
+
+            // untrack and retrack waited for it, so victim is still the same entry
+            std::lock_guard lock{ m_mutex };
+            account(oldBytes, bytes);
+            victim->m_bytes = bytes;
+            victim->m_state.store(State::EVICTED, std::memory_order_release);
+            ++m_evictions;
+            m_idle.notify_all();
+        }
+    }
+
+    // m_mutex must be held
+    void account(std::size_t oldBytes, std::size_t newBytes)
+    {
+        m_resident = m_resident - oldBytes + newBytes;
+        m_peak     = std::max(m_peak, m_resident);
+        m_overBudget.store(m_resident > m_budget, std::memory_order_relaxed);
+    }
+};
+
+#endif /* end of include guard: TEXTURE_RESIDENCY_HPP_P4CWN8QE */
@@ -0,0 +1,55 @@
+#ifndef TRIPLE_BUFFER_HPP_Q8LZ2VHC
+#define TRIPLE_BUFFER_HPP_Q8LZ2VHC
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Hands the latest value from one writer thread to one reader thread without either ever waiting: the writer fills
+ * the back slot and swaps it with the middle one, the reader swaps the middle one with its front slot when it holds
+ * something newer. Values published while the reader is not looking are overwritten, only the latest one matters.
+ */
+template <typename T>
+class TripleBuffer
+{
+private:
+    static inline constexpr std::uint8_t s_fresh{ 0b100 };    // on the middle index: published, not read yet
+    static inline constexpr std::uint8_t s_indexMask{ 0b011 };
+
+    std::array<T, 3> m_slots;
+
+    alignas(64) std::atomic<std::uint8_t> m_middle{ 1 };
+    alignas(64) std::uint8_t m_back{ 0 };     // writer
+    alignas(64) std::uint8_t m_front{ 2 };    // reader
+
+public:
+    explicit TripleBuffer(const T& initial)
+        : m_slots{ initial, initial, initial }
+    {
+    }
+
+    TripleBuffer(const TripleBuffer&)            = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+    TripleBuffer(TripleBuffer&&)                 = delete;
+    TripleBuffer& operator=(TripleBuffer&&)      = delete;
+
+    // the slot to fill, it holds whatever was published two times before
+    // @thread_safety: call these two functions from the writer thread only
+    T&   back() { return m_slots[m_back]; }
+    void publish() { m_back = m_middle.exchange(m_back | s_fresh, std::memory_order_acq_rel) & s_indexMask; }
+
+    // takes the latest published value if there is a new one; false if front() is still the latest
+    // @thread_safety: call these two functions from the reader thread only
+    bool update()
+    {
+        if ((m_middle.load(std::memory_order_relaxed) & s_fresh) == 0) {
+            return false;
+        }
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & s_indexMask;
+        return true;
+    }
+    const T& front() const { return m_slots[m_front]; }
+};
+
+#endif /* end of include guard: TRIPLE_BUFFER_HPP_Q8LZ2VHC */
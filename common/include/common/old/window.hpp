@@ -1,15 +1,22 @@
 #ifndef WINDOW_HPP_IROQWEOX
 #define WINDOW_HPP_IROQWEOX
 
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <thread>
 #include <utility>
+#include <vector>
+#include <array>
 #include <atomic>
-#include <queue>
+#include <cstdint>
 
 #include <glm/glm.hpp>
 
+#include "input_log.hpp"
+#include "mpsc_queue.hpp"
 #include "window_manager.hpp"
 
 namespace window
@@ -24,6 +31,20 @@ namespace window
         glm::vec<2, double> m_cursorPos;
     };
 
+    // frame times of Window::run, measured from one present to the next
+    struct FrameStats
+    {
+        std::size_t                               m_frames;
+        std::chrono::duration<double, std::milli> m_meanFrameTime;
+        std::chrono::duration<double, std::milli> m_jitter;    // standard deviation of the frame time
+        std::chrono::duration<double, std::milli> m_maxFrameTime;
+
+        // how far the cpu runs ahead of the gpu: from the end of a frame's submission to its fence seen signaled
+        std::chrono::duration<double, std::milli> m_meanCpuAhead;
+        std::chrono::duration<double, std::milli> m_maxCpuAhead;
+        std::chrono::duration<double, std::milli> m_meanFenceWait;    // blocked on the frames in flight, per frame
+    };
+
     class Window
     {
     public:
@@ -57,14 +78,33 @@ namespace window
         // use the context on current thread;
         void useHere();
         void unUse();
+        // headless, this also resizes the offscreen framebuffer (see DefaultFramebuffer), so call it from the window
+        // thread
         void setWindowSize(int width, int height);
         void updateTitle(const std::string& title);
         // main rendering loop
         void    run(std::function<void()>&& func);
-        void    enqueueTask(std::function<void()>&& func);
+        void    enqueueTask(Task&& func);
         void    requestClose();
         double  getDeltaTime();
         Window& setVsync(bool value);
+
+        // caps the frame rate of run() on top of vsync; std::nullopt (or a limit <= 0) removes the cap
+        Window& setFrameBudget(std::optional<std::chrono::nanoseconds> budget);
+        Window& setFrameLimit(double fps);
+
+        // a cap used instead while the window is unfocused or minimized (GLFW doesn't report occlusion otherwise)
+        Window& setBackgroundFrameBudget(std::optional<std::chrono::nanoseconds> budget);
+        Window& setBackgroundFrameLimit(double fps);
+
+        // run() waits for the gpu to finish the frame `frames` frames back before starting the next one, which keeps
+        // the input-to-display latency bounded; std::nullopt (or 0) lets the driver queue as many frames as it wants
+        Window& setMaxFramesInFlight(std::optional<std::size_t> frames);
+
+        // since the last reset or the last budget change
+        FrameStats getFrameStats() const;
+        void       resetFrameStats();
+
         Window& setCaptureMouse(bool value);
         Window& setCursorPosCallback(CursorPosCallbackFun&& func);
         Window& setScrollCallback(ScrollCallbackFun&& func);
@@ -84,24 +124,95 @@ namespace window
             std::function<void(Window&)>&&  func
         );
 
+        // @thread_safety: this function can be called from any thread
+        bool isKeyDown(KeyEvent key) const;
+
+        // writes the input of every frame of run() to `path` (see InputLog) until stopped
+        // @thread_safety: call these functions from the window thread (or before run())
+        bool startRecording(const std::filesystem::path& path);
+        void stopRecording();
+        bool isRecording() const { return m_recorder.has_value(); }
+
+        // plays back a recording in place of the live input, frame by frame, with getDeltaTime() fixed at
+        // `deltaTime` so a run steered by a recording always computes the same frames; when the recording ends the
+        // live input comes back, or the window closes if `closeWhenDone`
+        // @thread_safety: call these functions from the window thread (or before run())
+        bool startReplay(const std::filesystem::path& path, double deltaTime = 1.0 / 60.0, bool closeWhenDone = false);
+        void stopReplay();
+        bool isReplaying() const { return m_replay.has_value(); }
+
+        // RGBA8, bottom row first, of what the frame drew so far in the bound framebuffer; to get the images of a
+        // headless run
+        // @thread_safety: call this function from the window thread
+        std::vector<std::uint8_t> readPixels() const;
+
+        bool              isHeadless() const { return m_headless; }
         bool              isVsyncEnabled() { return m_vsync; }
         bool              isMouseCaptured() { return m_captureMouse; }
         WindowProperties& getProperties() { return m_properties; }
         GLFWwindow*       getHandle() const { return m_windowHandle; }
 
+        // depth of the tasks waiting for the window thread and how long they wait
+        MpscQueueStats getTaskQueueStats() const { return m_taskQueue->getStats(); }
+
         const std::optional<std::thread::id>& getAttachedThreadId() const { return m_attachedThreadId; };
 
     private:
-        Window(std::size_t id, GLFWwindow* handle, WindowProperties&& prop);
+        // a context that is not drawable (shared, to upload from another thread) gets no offscreen framebuffer
+        Window(std::size_t id, GLFWwindow* handle, WindowProperties&& prop, bool drawable = true);
 
         static void framebufferSizeCallback(GLFWwindow* window, int width, int height);
         static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
         static void cursorPosCallback(GLFWwindow* window, double xPos, double yPos);
         static void scrollCallback(GLFWwindow* window, double xOffset, double yOffset);
+        static void focusCallback(GLFWwindow* window, int focused);
+        static void iconifyCallback(GLFWwindow* window, int iconified);
 
+        // input the callbacks gathered on the main thread since the last frame, taken by the window thread in one go
+        // at the start of a frame: a fast mouse costs one cursor callback per frame however many events it sent
+        using InputState = InputEvents;
+
+        // keys held down, one bit per GLFW_KEY_*: the key callback updates them on the main thread as the events come,
+        // the window thread reads a snapshot every frame (no glfwGetKey off the main thread)
+        class KeyState
+        {
+        public:
+            static inline constexpr std::size_t s_numWords{ (GLFW_KEY_LAST + 64) / 64 };
+
+            using Bits = std::array<std::uint64_t, s_numWords>;
+
+            void set(KeyEvent key, bool down);
+            void clear();
+            void store(const Bits& bits);    // the whole state at once, e.g. when the window is moved
+            Bits load() const;
+
+            static bool        isDown(const Bits& keys, KeyEvent key);
+            static KeyModifier getMods(const Bits& keys);    // from the modifier keys held
+
+        private:
+            std::array<std::atomic<std::uint64_t>, s_numWords> m_words{};
+        };
+
+        // KeyMap flattened into arrays sorted by key then modifier, rebuilt when a handler is added
+        struct CompiledKeyHandler
+        {
+            KeyEvent                      m_key;
+            KeyModifier                   m_mods;
+            std::function<void(Window&)>* m_handler;    // into m_keyMap
+        };
+
+        void createOffscreenFramebuffer();
+        void allocateOffscreenStorage();
+        void compileKeyHandlers();
+        void processInputEvents();
+        void replayInputEvents(InputState& input);
+        void dispatchKey(const InputState::KeyTransition& transition);
         void processInput();
         void processQueuedTasks();
         void updateDeltaTime();
+        void limitFrameRate();
+        void recordFrame(std::chrono::steady_clock::time_point now);
+        void recordRetiredFrame(std::chrono::steady_clock::duration cpuAhead, std::chrono::steady_clock::duration wait);
 
         // window stuff
         std::size_t      m_id;
@@ -109,6 +220,10 @@ namespace window
         GLFWwindow*      m_windowHandle;
         WindowProperties m_properties;
         bool             m_vsync{ true };
+        bool             m_headless{ false };
+        std::uint32_t    m_offscreenFramebuffer{ 0 };    // headless without a default framebuffer (EGL)
+        std::uint32_t    m_offscreenColor{ 0 };
+        std::uint32_t    m_offscreenDepthStencil{ 0 };
 
         // input
         KeyMap                     m_keyMap;
@@ -116,16 +231,56 @@ namespace window
         ScrollCallbackFun          m_scrollCallback;
         FramebufferSizeCallbackFun m_framebufferSize;
 
-        std::queue<std::function<void()>> m_taskQueue;
+        KeyState                        m_keyState;
+        std::vector<CompiledKeyHandler> m_callbackHandlers;
+        std::vector<CompiledKeyHandler> m_continuousHandlers;
+        bool                            m_keyHandlersDirty{ true };
+
+        // input recording and replay, frames counted from their start
+        std::optional<InputLogWriter> m_recorder;
+        std::uint32_t                 m_recordFrame{ 0 };
+        double                        m_recordStart{ 0.0 };
+        std::optional<InputLogReader> m_replay;
+        std::uint32_t                 m_replayFrame{ 0 };
+        double                        m_replayDeltaTime{ 0.0 };
+        bool                          m_replayCloseWhenDone{ false };
+        std::atomic<bool>             m_replaying{ false };    // the key callback leaves m_keyState alone
+
+        InputState m_pendingInput;    // written by the main thread, under m_inputMutex
+        InputState m_frameInput;      // swapped with m_pendingInput every frame
+
+        // behind a pointer as the queue can't move; filled by the main thread and other threads
+        std::unique_ptr<MpscQueue<Task>> m_taskQueue{ std::make_unique<MpscQueue<Task>>() };
 
         double m_lastFrameTime{ 0.0 };
         double m_deltaTime{ 0.0 };
 
+        // frame pacing
+        std::optional<std::chrono::nanoseconds> m_frameBudget;
+        std::optional<std::chrono::nanoseconds> m_backgroundFrameBudget;
+        std::atomic<bool>                       m_focused{ true };       // set by the main thread
+        std::atomic<bool>                       m_iconified{ false };    // set by the main thread
+        std::chrono::steady_clock::time_point   m_nextFrame;
+        std::chrono::steady_clock::time_point   m_lastPresent;
+        std::optional<std::size_t>              m_maxFramesInFlight{ 2 };
+
+        // running mean and sum of squared differences of the frame times, in milliseconds (Welford)
+        std::size_t m_frameCount{ 0 };
+        double      m_frameTimeMean{ 0.0 };
+        double      m_frameTimeM2{ 0.0 };
+        double      m_frameTimeMax{ 0.0 };
+
+        // frames whose fence was waited on, and the sums of their times in milliseconds
+        std::size_t m_retiredFrames{ 0 };
+        double      m_cpuAheadSum{ 0.0 };
+        double      m_cpuAheadMax{ 0.0 };
+        double      m_fenceWaitSum{ 0.0 };
+
         bool                           m_captureMouse{ false };
         std::optional<std::thread::id> m_attachedThreadId;
 
         mutable std::mutex m_windowMutex;
-        mutable std::mutex m_queueMutex;
+        mutable std::mutex m_inputMutex;
     };
 }
 
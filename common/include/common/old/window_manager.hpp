@@ -1,21 +1,29 @@
 #ifndef WINDOW_MANAGER_HPP_OR5VIUQW
 #define WINDOW_MANAGER_HPP_OR5VIUQW
 
+#include <atomic>
 #include <chrono>
 #include <cstddef>
 #include <functional>
-#include <mutex>
+#include <memory>
 #include <optional>
-#include <queue>
+#include <string>
 #include <thread>
+#include <unordered_map>
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
+#include "inplace_function.hpp"
+#include "mpsc_queue.hpp"
+
 namespace window
 {
     using unique_GLFWwindow = std::unique_ptr<GLFWwindow, void(*)(GLFWwindow*)>;
 
+    // what the task queues hold; lambdas capturing up to 48 bytes are stored without allocating
+    using Task = InplaceFunction<void()>;
+
     // turns fps to milliseconds
     inline std::chrono::milliseconds operator""_fps(unsigned long long fps)
     {
@@ -26,6 +34,12 @@ namespace window
 
     class Window;
 
+    enum class Backend
+    {
+        DISPLAY,     // windows on the display server
+        HEADLESS,    // no display server: GLFW's null platform, with OSMesa or EGL (surfaceless) contexts
+    };
+
     class WindowManager
     {
     public:
@@ -36,6 +50,13 @@ namespace window
         WindowManager& operator=(const WindowManager&) = delete;
         WindowManager& operator=(WindowManager&&)      = delete;
 
+        // call it in place of glfwInit(). without `backend`, the LEARNOPENGL_BACKEND environment variable picks it
+        // ("display" or "headless", display when unset), so any app can be run on a machine without a display.
+        // headless needs GLFW 3.4.
+        static bool initGlfw(std::optional<Backend> backend = {});
+
+        static Backend getBackend() { return s_backend; }
+
         // the thread that call this function first will be regarded as the main thread.
         static bool createInstance();
 
@@ -45,6 +66,12 @@ namespace window
         // @thread_safety: call this function from the main thread only
         std::optional<Window> createWindow(const std::string& title, int width, int height);
 
+        // creates an invisible window whose context shares objects (buffers, textures, syncs; not vertex arrays) with
+        // the context of `shareWith`, to upload resources from another thread. the context current on the calling
+        // thread stays current. `shareWith` must not be current on another thread yet.
+        // @thread_safety: call this function from the main thread only
+        std::optional<Window> createSharedContext(const Window& shareWith);
+
         // this function poll events for all windows and then sleep for specified time.
         // won't sleep after polling events if `msPollRate` is `std::nullopt`.
         // @thread_safety: call this function from the main thread only
@@ -54,17 +81,27 @@ namespace window
         // @thread_safety: call this function from the main thread only
         void waitEvents();
 
+        // blocks until an event is received or until the deadline, one `period` after the previous one, has passed.
+        // tasks queued from other threads wake it up right away; meant to be called in a loop in place of
+        // `pollEvents(period)`: events are handled as they come while the loop still runs at least once per period.
+        // @thread_safety: call this function from the main thread only
+        void waitEventsTimeout(std::chrono::milliseconds period);
+
         // @thread_safety: this function can be called from any thread
         void requestDeleteWindow(std::size_t id);
 
         // this function is supposed to be called from a window thread.
         // @thread_safety: this function can be called from any thread
-        void enqueueWindowTask(std::size_t windowId, std::function<void()>&& func);
+        void enqueueWindowTask(std::size_t windowId, Task&& func);
 
         // this function can be called for any task that needs to be executed in the main thread.
         // for window task, use `enqueueWindowTask` instead.
         // @thread_safety: this function can be called from any thread
-        void enqueueTask(std::function<void()>&& func);
+        void enqueueTask(Task&& func);
+
+        // @thread_safety: these functions can be called from any thread
+        MpscQueueStats getTaskQueueStats() const { return m_taskQueue.getStats(); }
+        MpscQueueStats getWindowTaskQueueStats() const { return m_windowTaskQueue.getStats(); }
 
         bool hasWindowOpened();
 
@@ -73,19 +110,34 @@ namespace window
     private:
         WindowManager(std::thread::id threadId);
 
+        std::optional<Window> createWindowImpl(const std::string& title, int width, int height, GLFWwindow* share);
+
         void checkTasks();
 
+        // @thread_safety: this function can be called from any thread
+        void wake();
+
         inline static std::unique_ptr<WindowManager> s_instance{ nullptr };
+        inline static Backend                        s_backend{ Backend::DISPLAY };
+
+        struct WindowTask
+        {
+            std::size_t m_windowId;
+            Task        m_task;
+        };
+
+        // only touched from the main thread, the other threads go through the queues below
+        std::unordered_map<std::size_t, unique_GLFWwindow> m_windows;
 
-        std::unordered_map<std::size_t, unique_GLFWwindow>        m_windows;
-        std::queue<std::size_t>                                   m_windowDeleteQueue;
-        std::queue<std::function<void()>>                         m_taskQueue;
-        std::queue<std::pair<std::size_t, std::function<void()>>> m_windowTaskQueue;
+        MpscQueue<std::size_t> m_windowDeleteQueue;
+        MpscQueue<Task>        m_taskQueue;
+        MpscQueue<WindowTask>  m_windowTaskQueue;
 
         std::size_t     m_windowCount{ 0 };
         std::thread::id m_attachedThreadId;
 
-        std::mutex m_queueMutex;
+        std::atomic<bool>                     m_wakeRequested{ false };    // an empty event is on its way
+        std::chrono::steady_clock::time_point m_deadline;
     };
 }
 
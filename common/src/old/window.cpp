@@ -1,8 +1,14 @@
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <deque>
 #include <format>
 #include <functional>
 #include <initializer_list>
 #include <iostream>
 #include <mutex>
+#include <optional>
 #include <sstream>
 #include <thread>
 
@@ -11,6 +17,7 @@
 #include <glbinding/gl/gl.h>
 #include <glbinding/glbinding.h>
 
+#include "common/old/default_framebuffer.hpp"
 #include "common/old/window.hpp"
 #include "common/old/window_manager.hpp"
 #include "common/old/scope_time_logger.hpp"
@@ -30,17 +37,35 @@ namespace
         return threadId_num;
     }
 
-    // helper function that decides whether to execute the task immediately or enqueue it.
-    static inline void runTask(window::Window* windowPtr, std::function<void()>&& func)
+    struct InFlightFrame
     {
-        // If the Window is attached to the same thread as the windowManager,
-        // execute the task immediately, else enqueue the task.
-        const auto& windowManager{ window::WindowManager::getInstance()->get() };
-        if (windowPtr->getAttachedThreadId() == windowManager.getAttachedThreadId()) {
-            func();
-        } else {
-            windowPtr->enqueueTask(std::move(func));
-        }
+        gl::GLsync                                           m_fence;
+        std::chrono::steady_clock::time_point                m_submitted;
+        std::optional<std::chrono::steady_clock::time_point> m_signaled;    // first seen signaled
+    };
+
+    bool isSignaled(gl::GLsync fence)
+    {
+        using namespace gl;
+
+        const auto status{ glClientWaitSync(fence, GL_NONE_BIT, 0) };
+        return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+    }
+
+    // blocks until the fence has signaled (or waiting on it failed), flushing the commands before it
+    void clientWait(gl::GLsync fence)
+    {
+        using namespace gl;
+
+        constexpr GLuint64 timeout{ 100'000'000 };    // ns, per try
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout) == GL_TIMEOUT_EXPIRED) { }
+    }
+
+    // the handlers of `key` in an array compiled by Window::compileKeyHandlers
+    template <typename Handlers>
+    auto handlersOf(Handlers& handlers, int key)
+    {
+        return std::ranges::equal_range(handlers, key, {}, [](const auto& handler) { return handler.m_key; });
     }
 }
 
@@ -53,12 +78,8 @@ namespace window
             return;
         }
 
-        runTask(windowWindow, [windowWindow, width, height] {
-            if (windowWindow->m_framebufferSize) {
-                windowWindow->m_framebufferSize(*windowWindow, width, height);
-            }
-            windowWindow->setWindowSize(width, height);
-        });
+        std::scoped_lock lock{ windowWindow->m_inputMutex };
+        windowWindow->m_pendingInput.m_framebufferSize = { width, height };
     }
 
     void Window::keyCallback(GLFWwindow* window, int key, int /* scancode */, int action, int mods)
@@ -68,23 +89,12 @@ namespace window
             return;
         }
 
-        runTask(windowWindow, [windowWindow, key, action, mods] {
-            auto& keyMap{ windowWindow->m_keyMap };
-            auto  range{ keyMap.equal_range(key) };
-            for (auto& [_, handler] : std::ranges::subrange(range.first, range.second)) {
-                auto& [hmod, haction, hfun]{ handler };
-                if (haction != KeyActionType::CALLBACK) {
-                    continue;
-                }
-                if (action == GLFW_RELEASE || action == GLFW_REPEAT) {
-                    continue;
-                }    // ignore release and repeat event for now
+        if (!windowWindow->m_replaying.load(std::memory_order_relaxed)) {    // replayed keys only while replaying
+            windowWindow->m_keyState.set(key, action != GLFW_RELEASE);
+        }
 
-                if (mods & hmod || hmod == 0) {    // modifier match or don't have any modifier
-                    hfun(*windowWindow);
-                }
-            }
-        });
+        std::scoped_lock lock{ windowWindow->m_inputMutex };
+        windowWindow->m_pendingInput.m_keys.push_back({ .m_key = key, .m_action = action, .m_mods = mods });
     }
 
     void Window::cursorPosCallback(GLFWwindow* window, double xPos, double yPos)
@@ -94,12 +104,8 @@ namespace window
             return;
         }
 
-        runTask(windowWindow, [windowWindow, xPos, yPos] {
-            if (windowWindow->m_cursorPosCallback) {
-                windowWindow->m_cursorPosCallback(*windowWindow, xPos, yPos);
-            }
-            windowWindow->m_properties.m_cursorPos = { xPos, yPos };
-        });
+        std::scoped_lock lock{ windowWindow->m_inputMutex };
+        windowWindow->m_pendingInput.m_cursorPos = { xPos, yPos };
     }
 
     void Window::scrollCallback(GLFWwindow* window, double xOffset, double yOffset)
@@ -109,18 +115,35 @@ namespace window
             return;
         }
 
-        runTask(windowWindow, [windowWindow, xOffset, yOffset] {
-            if (windowWindow->m_scrollCallback) {
-                windowWindow->m_scrollCallback(*windowWindow, xOffset, yOffset);
-            }
-        });
+        std::scoped_lock lock{ windowWindow->m_inputMutex };
+        auto& scroll{ windowWindow->m_pendingInput.m_scroll };
+        scroll = scroll.value_or(glm::dvec2{ 0.0 }) + glm::dvec2{ xOffset, yOffset };
+    }
+
+    void Window::focusCallback(GLFWwindow* window, int focused)
+    {
+        auto* windowWindow{ static_cast<Window*>(glfwGetWindowUserPointer(window)) };
+        if (windowWindow == nullptr) {
+            return;
+        }
+        windowWindow->m_focused.store(focused == GLFW_TRUE, std::memory_order_relaxed);
+    }
+
+    void Window::iconifyCallback(GLFWwindow* window, int iconified)
+    {
+        auto* windowWindow{ static_cast<Window*>(glfwGetWindowUserPointer(window)) };
+        if (windowWindow == nullptr) {
+            return;
+        }
+        windowWindow->m_iconified.store(iconified == GLFW_TRUE, std::memory_order_relaxed);
     }
 
     // this constructor must be called only from main thread (WindowManager run in main thread)
-    Window::Window(std::size_t id, GLFWwindow* handle, WindowProperties&& prop)
+    Window::Window(std::size_t id, GLFWwindow* handle, WindowProperties&& prop, bool drawable)
         : m_id{ id }
         , m_windowHandle{ handle }
         , m_properties{ prop }
+        , m_headless{ WindowManager::getBackend() == Backend::HEADLESS }
         , m_attachedThreadId{ std::nullopt }
     {
         useHere();
@@ -134,6 +157,11 @@ namespace window
             glfwSetKeyCallback(m_windowHandle, Window::keyCallback);
             glfwSetCursorPosCallback(m_windowHandle, Window::cursorPosCallback);
             glfwSetScrollCallback(m_windowHandle, Window::scrollCallback);
+            glfwSetWindowFocusCallback(m_windowHandle, Window::focusCallback);
+            glfwSetWindowIconifyCallback(m_windowHandle, Window::iconifyCallback);
+        }
+        if (m_headless && drawable) {
+            createOffscreenFramebuffer();
         }
         setVsync(m_vsync);
         glfwSetWindowUserPointer(m_windowHandle, this);
@@ -146,14 +174,46 @@ namespace window
         , m_windowHandle{ other.m_windowHandle }
         , m_properties{ std::move(other.m_properties) }
         , m_vsync{ other.m_vsync }
+        , m_headless{ other.m_headless }
+        , m_offscreenFramebuffer{ other.m_offscreenFramebuffer }
+        , m_offscreenColor{ other.m_offscreenColor }
+        , m_offscreenDepthStencil{ other.m_offscreenDepthStencil }
         , m_keyMap{ std::move(other.m_keyMap) }
         , m_cursorPosCallback{ std::move(other.m_cursorPosCallback) }
         , m_scrollCallback{ std::move(other.m_scrollCallback) }
+        , m_framebufferSize{ std::move(other.m_framebufferSize) }
+        , m_recorder{ std::move(other.m_recorder) }
+        , m_recordFrame{ other.m_recordFrame }
+        , m_recordStart{ other.m_recordStart }
+        , m_replay{ std::move(other.m_replay) }
+        , m_replayFrame{ other.m_replayFrame }
+        , m_replayDeltaTime{ other.m_replayDeltaTime }
+        , m_replayCloseWhenDone{ other.m_replayCloseWhenDone }
+        , m_replaying{ other.m_replaying.load() }
+        , m_pendingInput{ std::move(other.m_pendingInput) }
+        , m_frameInput{ std::move(other.m_frameInput) }
         , m_taskQueue{ std::move(other.m_taskQueue) }
         , m_lastFrameTime{ other.m_lastFrameTime }
         , m_deltaTime{ other.m_deltaTime }
+        , m_frameBudget{ other.m_frameBudget }
+        , m_backgroundFrameBudget{ other.m_backgroundFrameBudget }
+        , m_focused{ other.m_focused.load() }
+        , m_iconified{ other.m_iconified.load() }
+        , m_nextFrame{ other.m_nextFrame }
+        , m_lastPresent{ other.m_lastPresent }
+        , m_maxFramesInFlight{ other.m_maxFramesInFlight }
+        , m_frameCount{ other.m_frameCount }
+        , m_frameTimeMean{ other.m_frameTimeMean }
+        , m_frameTimeM2{ other.m_frameTimeM2 }
+        , m_frameTimeMax{ other.m_frameTimeMax }
+        , m_retiredFrames{ other.m_retiredFrames }
+        , m_cpuAheadSum{ other.m_cpuAheadSum }
+        , m_cpuAheadMax{ other.m_cpuAheadMax }
+        , m_fenceWaitSum{ other.m_fenceWaitSum }
+        , m_captureMouse{ other.m_captureMouse }
         , m_attachedThreadId{ other.m_attachedThreadId }
     {
+        m_keyState.store(other.m_keyState.load());
         glfwSetWindowUserPointer(m_windowHandle, this);
         other.m_id                = 0;
         other.m_windowHandle      = nullptr;
@@ -165,18 +225,51 @@ namespace window
     Window& Window::operator=(Window&& other)
     {
         if (this != &other) {
-            m_id                 = other.m_id;
-            m_contextInitialized = other.m_contextInitialized;
-            m_windowHandle       = other.m_windowHandle;
-            m_properties         = std::move(other.m_properties);
-            m_vsync              = other.m_vsync;
-            m_keyMap             = std::move(other.m_keyMap);
-            m_cursorPosCallback  = std::move(other.m_cursorPosCallback);
-            m_scrollCallback     = std::move(other.m_scrollCallback);
-            m_taskQueue          = std::move(other.m_taskQueue);
-            m_lastFrameTime      = other.m_lastFrameTime;
-            m_deltaTime          = other.m_deltaTime;
-            m_attachedThreadId   = other.m_attachedThreadId;
+            m_id                    = other.m_id;
+            m_contextInitialized    = other.m_contextInitialized;
+            m_windowHandle          = other.m_windowHandle;
+            m_properties            = std::move(other.m_properties);
+            m_vsync                 = other.m_vsync;
+            m_headless              = other.m_headless;
+            m_offscreenFramebuffer  = other.m_offscreenFramebuffer;
+            m_offscreenColor        = other.m_offscreenColor;
+            m_offscreenDepthStencil = other.m_offscreenDepthStencil;
+            m_keyMap                = std::move(other.m_keyMap);
+            m_cursorPosCallback     = std::move(other.m_cursorPosCallback);
+            m_scrollCallback        = std::move(other.m_scrollCallback);
+            m_framebufferSize       = std::move(other.m_framebufferSize);
+            m_keyState.store(other.m_keyState.load());
+            m_pendingInput          = std::move(other.m_pendingInput);
+            m_frameInput            = std::move(other.m_frameInput);
+            m_keyHandlersDirty      = true;
+            m_recorder              = std::move(other.m_recorder);
+            m_recordFrame           = other.m_recordFrame;
+            m_recordStart           = other.m_recordStart;
+            m_replay                = std::move(other.m_replay);
+            m_replayFrame           = other.m_replayFrame;
+            m_replayDeltaTime       = other.m_replayDeltaTime;
+            m_replayCloseWhenDone   = other.m_replayCloseWhenDone;
+            m_replaying             = other.m_replaying.load();
+            m_taskQueue             = std::move(other.m_taskQueue);
+            m_lastFrameTime         = other.m_lastFrameTime;
+            m_deltaTime             = other.m_deltaTime;
+            m_frameBudget           = other.m_frameBudget;
+            m_backgroundFrameBudget = other.m_backgroundFrameBudget;
+            m_focused               = other.m_focused.load();
+            m_iconified             = other.m_iconified.load();
+            m_nextFrame             = other.m_nextFrame;
+            m_lastPresent           = other.m_lastPresent;
+            m_maxFramesInFlight     = other.m_maxFramesInFlight;
+            m_frameCount            = other.m_frameCount;
+            m_frameTimeMean         = other.m_frameTimeMean;
+            m_frameTimeM2           = other.m_frameTimeM2;
+            m_frameTimeMax          = other.m_frameTimeMax;
+            m_retiredFrames         = other.m_retiredFrames;
+            m_cpuAheadSum           = other.m_cpuAheadSum;
+            m_cpuAheadMax           = other.m_cpuAheadMax;
+            m_fenceWaitSum          = other.m_fenceWaitSum;
+            m_captureMouse          = other.m_captureMouse;
+            m_attachedThreadId      = other.m_attachedThreadId;
 
             glfwSetWindowUserPointer(m_windowHandle, this);
             other.m_id                = 0;
@@ -215,6 +308,7 @@ namespace window
             );
 
             glfwMakeContextCurrent(m_windowHandle);
+            DefaultFramebuffer::s_current = m_offscreenFramebuffer;
 
         } else if (m_attachedThreadId == std::this_thread::get_id()) {
 
@@ -239,6 +333,7 @@ namespace window
     void Window::unUse()
     {
         glfwMakeContextCurrent(nullptr);
+        DefaultFramebuffer::s_current = 0;
         if (m_attachedThreadId.has_value()) {
             std::cout << std::format(
                 "INFO: [Window] Context ({} | {:#x}) detached (-) [thread: {:#x}]\n",
@@ -254,8 +349,10 @@ namespace window
     Window& Window::setVsync(bool value)
     {
         m_vsync = value;
-        glfwSwapInterval(value
-        );    // 0 for immediate updates, 1 for updates synchronized with the vertical retrace
+        if (!m_headless) {    // nothing to synchronize with
+            glfwSwapInterval(value
+            );    // 0 for immediate updates, 1 for updates synchronized with the vertical retrace
+        }
         return *this;
     }
 
@@ -263,6 +360,10 @@ namespace window
     {
         m_properties.m_width  = width;
         m_properties.m_height = height;
+
+        if (m_offscreenFramebuffer != 0) {
+            allocateOffscreenStorage();
+        }
     }
 
     void Window::updateTitle(const std::string& title)
@@ -276,22 +377,75 @@ namespace window
 
     void Window::run(std::function<void()>&& func)
     {
+        using Clock = std::chrono::steady_clock;
+
+        std::deque<InFlightFrame> inFlight;    // oldest first
+
         for (std::lock_guard lock{ m_windowMutex }; !glfwWindowShouldClose(m_windowHandle);) {
             PRETTY_FUNCTION_TIME_LOG_WITH_ARG("loop");
 
+            // before the input is read, so the frame starts from the freshest input
+            const auto maxInFlight{ m_maxFramesInFlight.value_or(0) };
+            if (maxInFlight == 0) {
+                for (const auto& frame : inFlight) {
+                    gl::glDeleteSync(frame.m_fence);    // turned off, no waiting on them
+                }
+                inFlight.clear();
+            }
+
+            // polled every frame without waiting, so a frame the gpu finished early isn't counted as running until
+            // the cpu got around to waiting on it; fences signal in order, the first pending one ends the poll
+            for (auto& frame : inFlight) {
+                if (frame.m_signaled) {
+                    continue;
+                }
+                if (!isSignaled(frame.m_fence)) {
+                    break;
+                }
+                frame.m_signaled = Clock::now();
+            }
+
+            while (!inFlight.empty() && inFlight.size() >= maxInFlight) {
+                const auto [fence, submitted, seenSignaled]{ inFlight.front() };
+                inFlight.pop_front();
+
+                const auto waitStart{ Clock::now() };
+                if (!seenSignaled) {
+                    clientWait(fence);
+                }
+                const auto waitEnd{ Clock::now() };
+                gl::glDeleteSync(fence);
+
+                recordRetiredFrame(seenSignaled.value_or(waitEnd) - submitted, waitEnd - waitStart);
+            }
+
             updateDeltaTime();
+            processInputEvents();
             processInput();
             processQueuedTasks();
 
             func();
-            glfwSwapBuffers(m_windowHandle);
+            if (!m_headless) {    // nothing to present, the frame stays in the framebuffer until the next one
+                glfwSwapBuffers(m_windowHandle);
+            }
+            if (maxInFlight > 0) {
+                inFlight.push_back({
+                    .m_fence     = gl::glFenceSync(gl::GL_SYNC_GPU_COMMANDS_COMPLETE, gl::GL_NONE_BIT),
+                    .m_submitted = Clock::now(),
+                    .m_signaled  = std::nullopt,
+                });
+            }
+            limitFrameRate();
+        }
+
+        for (const auto& frame : inFlight) {
+            gl::glDeleteSync(frame.m_fence);
         }
     }
 
-    void Window::enqueueTask(std::function<void()>&& func)
+    void Window::enqueueTask(Task&& func)
     {
-        std::lock_guard lock{ m_queueMutex };
-        m_taskQueue.push(std::move(func));
+        m_taskQueue->push(std::move(func));
     }
 
     void Window::requestClose()
@@ -307,6 +461,72 @@ namespace window
         return m_deltaTime;
     }
 
+    Window& Window::setFrameBudget(std::optional<std::chrono::nanoseconds> budget)
+    {
+        m_frameBudget = budget && budget->count() > 0 ? budget : std::nullopt;
+        resetFrameStats();
+        return *this;
+    }
+
+    Window& Window::setFrameLimit(double fps)
+    {
+        using namespace std::chrono;
+        return setFrameBudget(fps > 0.0 ? std::optional{ duration_cast<nanoseconds>(duration<double>{ 1.0 / fps }) }
+                                        : std::nullopt);
+    }
+
+    Window& Window::setBackgroundFrameBudget(std::optional<std::chrono::nanoseconds> budget)
+    {
+        m_backgroundFrameBudget = budget && budget->count() > 0 ? budget : std::nullopt;
+        resetFrameStats();
+        return *this;
+    }
+
+    Window& Window::setBackgroundFrameLimit(double fps)
+    {
+        using namespace std::chrono;
+        return setBackgroundFrameBudget(
+            fps > 0.0 ? std::optional{ duration_cast<nanoseconds>(duration<double>{ 1.0 / fps }) } : std::nullopt
+        );
+    }
+
+    Window& Window::setMaxFramesInFlight(std::optional<std::size_t> frames)
+    {
+        m_maxFramesInFlight = frames;
+        resetFrameStats();
+        return *this;
+    }
+
+    FrameStats Window::getFrameStats() const
+    {
+        using Milliseconds = std::chrono::duration<double, std::milli>;
+
+        const auto count{ static_cast<double>(m_frameCount) };
+        const auto retired{ static_cast<double>(m_retiredFrames) };
+        return {
+            .m_frames        = m_frameCount,
+            .m_meanFrameTime = Milliseconds{ m_frameTimeMean },
+            .m_jitter        = Milliseconds{ m_frameCount > 0 ? std::sqrt(m_frameTimeM2 / count) : 0.0 },
+            .m_maxFrameTime  = Milliseconds{ m_frameTimeMax },
+            .m_meanCpuAhead  = Milliseconds{ m_retiredFrames > 0 ? m_cpuAheadSum / retired : 0.0 },
+            .m_maxCpuAhead   = Milliseconds{ m_cpuAheadMax },
+            .m_meanFenceWait = Milliseconds{ m_retiredFrames > 0 ? m_fenceWaitSum / retired : 0.0 },
+        };
+    }
+
+    void Window::resetFrameStats()
+    {
+        m_frameCount    = 0;
+        m_frameTimeMean = 0.0;
+        m_frameTimeM2   = 0.0;
+        m_frameTimeMax  = 0.0;
+
+        m_retiredFrames = 0;
+        m_cpuAheadSum   = 0.0;
+        m_cpuAheadMax   = 0.0;
+        m_fenceWaitSum  = 0.0;
+    }
+
     Window& Window::setCaptureMouse(bool value)
     {
         m_captureMouse = value;
@@ -350,6 +570,7 @@ namespace window
     )
     {
         m_keyMap.emplace(key, KeyEventHandler{ .mods = mods, .action = action, .handler = func });
+        m_keyHandlersDirty = true;
         return *this;
     }
 
@@ -363,42 +584,298 @@ namespace window
         for (auto key : keys) {
             m_keyMap.emplace(key, KeyEventHandler{ .mods = mods, .action = action, .handler = func });
         }
+        m_keyHandlersDirty = true;
         return *this;
     }
 
-    void Window::processInput()
+    void Window::createOffscreenFramebuffer()
     {
-        PRETTY_FUNCTION_TIME_LOG();
+        using namespace gl;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_UNDEFINED) {
+            return;    // OSMesa draws in a buffer of its own
+        }
+
+        // an EGL context without a surface has no default framebuffer: one the size of the window takes its place
+        // and is bound wherever 0 would be (see DefaultFramebuffer); freed with the context
+        glGenRenderbuffers(1, &m_offscreenColor);
+        glGenRenderbuffers(1, &m_offscreenDepthStencil);
+        allocateOffscreenStorage();
+
+        glGenFramebuffers(1, &m_offscreenFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_offscreenFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_offscreenColor);
+        glFramebufferRenderbuffer(
+            GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_offscreenDepthStencil
+        );
+        DefaultFramebuffer::s_current = m_offscreenFramebuffer;
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << std::format("ERROR: [Window] Window ({}) offscreen framebuffer is incomplete\n", m_id);
+        } else {
+            std::cout << std::format(
+                "INFO: [Window] Window ({}) draws in an offscreen framebuffer ({}x{})\n",
+                m_id,
+                m_properties.m_width,
+                m_properties.m_height
+            );
+        }
+    }
+
+    // (re)allocates the attachments of the offscreen framebuffer at the window size, they stay attached
+    void Window::allocateOffscreenStorage()
+    {
+        using namespace gl;
+
+        const auto width{ m_properties.m_width };
+        const auto height{ m_properties.m_height };
+
+        glBindRenderbuffer(GL_RENDERBUFFER, m_offscreenColor);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_offscreenDepthStencil);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    }
+
+    std::vector<std::uint8_t> Window::readPixels() const
+    {
+        using namespace gl;
+
+        const auto width{ m_properties.m_width };
+        const auto height{ m_properties.m_height };
+
+        std::vector<std::uint8_t> pixels(std::size_t(width) * std::size_t(height) * 4);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        return pixels;
+    }
+
+    bool Window::isKeyDown(KeyEvent key) const
+    {
+        return KeyState::isDown(m_keyState.load(), key);
+    }
 
-        // TODO: move this part to 'main thread' (glfwGetKey must be called from main thread [for
-        // now it's okay, idk why tho])
-        const auto getMods = [win = m_windowHandle] {
-            int mods{ 0 };
-            mods |= glfwGetKey(win, GLFW_KEY_LEFT_SHIFT) & GLFW_MOD_SHIFT;
-            mods |= glfwGetKey(win, GLFW_KEY_RIGHT_SHIFT) & GLFW_MOD_SHIFT;
-            mods |= glfwGetKey(win, GLFW_KEY_LEFT_CONTROL) & GLFW_MOD_CONTROL;
-            mods |= glfwGetKey(win, GLFW_KEY_RIGHT_CONTROL) & GLFW_MOD_CONTROL;
-            mods |= glfwGetKey(win, GLFW_KEY_LEFT_ALT) & GLFW_MOD_ALT;
-            mods |= glfwGetKey(win, GLFW_KEY_RIGHT_ALT) & GLFW_MOD_ALT;
-            mods |= glfwGetKey(win, GLFW_KEY_LEFT_SUPER) & GLFW_MOD_SUPER;
-            mods |= glfwGetKey(win, GLFW_KEY_RIGHT_SUPER) & GLFW_MOD_SUPER;
-
-            return mods;
+    void Window::KeyState::set(KeyEvent key, bool down)
+    {
+        if (key < 0 || key > GLFW_KEY_LAST) {
+            return;    // GLFW_KEY_UNKNOWN
+        }
+
+        auto&      word{ m_words[std::size_t(key) / 64] };
+        const auto bit{ std::uint64_t{ 1 } << (std::size_t(key) % 64) };
+        if (down) {
+            word.fetch_or(bit, std::memory_order_release);
+        } else {
+            word.fetch_and(~bit, std::memory_order_release);
+        }
+    }
+
+    void Window::KeyState::clear()
+    {
+        for (auto& word : m_words) {
+            word.store(0, std::memory_order_release);
+        }
+    }
+
+    void Window::KeyState::store(const Bits& bits)
+    {
+        for (std::size_t i{ 0 }; i < s_numWords; ++i) {
+            m_words[i].store(bits[i], std::memory_order_release);
+        }
+    }
+
+    Window::KeyState::Bits Window::KeyState::load() const
+    {
+        Bits bits;
+        for (std::size_t i{ 0 }; i < s_numWords; ++i) {
+            bits[i] = m_words[i].load(std::memory_order_acquire);
+        }
+        return bits;
+    }
+
+    bool Window::KeyState::isDown(const Bits& keys, KeyEvent key)
+    {
+        if (key < 0 || key > GLFW_KEY_LAST) {
+            return false;
+        }
+        return (keys[std::size_t(key) / 64] >> (std::size_t(key) % 64)) & 1;
+    }
+
+    Window::KeyModifier Window::KeyState::getMods(const Bits& keys)
+    {
+        const auto mod = [&](KeyEvent left, KeyEvent right, KeyModifier mod) {
+            return isDown(keys, left) || isDown(keys, right) ? mod : 0;
         };
-        auto mods{ getMods() };
+        return mod(GLFW_KEY_LEFT_SHIFT, GLFW_KEY_RIGHT_SHIFT, GLFW_MOD_SHIFT)
+             | mod(GLFW_KEY_LEFT_CONTROL, GLFW_KEY_RIGHT_CONTROL, GLFW_MOD_CONTROL)
+             | mod(GLFW_KEY_LEFT_ALT, GLFW_KEY_RIGHT_ALT, GLFW_MOD_ALT)
+             | mod(GLFW_KEY_LEFT_SUPER, GLFW_KEY_RIGHT_SUPER, GLFW_MOD_SUPER);
+    }
+
+    void Window::compileKeyHandlers()
+    {
+        m_callbackHandlers.clear();
+        m_continuousHandlers.clear();
 
-        // continuous key input
         for (auto& [key, handler] : m_keyMap) {
-            auto& [hmod, haction, hfun]{ handler };
-            if (haction != KeyActionType::CONTINUOUS) {
-                continue;
+            auto& handlers{ handler.action == KeyActionType::CALLBACK ? m_callbackHandlers : m_continuousHandlers };
+            handlers.push_back({ .m_key = key, .m_mods = handler.mods, .m_handler = &handler.handler });
+        }
+
+        const auto byKeyThenMods = [](const CompiledKeyHandler& a, const CompiledKeyHandler& b) {
+            return std::pair{ a.m_key, a.m_mods } < std::pair{ b.m_key, b.m_mods };
+        };
+        std::ranges::stable_sort(m_callbackHandlers, byKeyThenMods);
+        std::ranges::stable_sort(m_continuousHandlers, byKeyThenMods);
+
+        m_keyHandlersDirty = false;
+    }
+
+    void Window::processInputEvents()
+    {
+        PRETTY_FUNCTION_TIME_LOG();
+
+        if (m_keyHandlersDirty) {
+            compileKeyHandlers();
+        }
+
+        {
+            std::scoped_lock lock{ m_inputMutex };
+            std::swap(m_pendingInput, m_frameInput);
+        }
+
+        auto& input{ m_frameInput };
+        if (m_replay) {
+            replayInputEvents(input);
+        }
+        if (m_recorder) {
+            m_recorder->write(m_recordFrame++, glfwGetTime() - m_recordStart, input);
+        }
+
+        if (input.m_framebufferSize) {
+            const auto size{ *input.m_framebufferSize };
+            if (m_framebufferSize) {
+                m_framebufferSize(*this, size.x, size.y);
             }
-            if (glfwGetKey(m_windowHandle, key) != GLFW_PRESS) {
-                continue;
+            setWindowSize(size.x, size.y);
+        }
+        if (input.m_cursorPos) {
+            const auto cursorPos{ *input.m_cursorPos };
+            if (m_cursorPosCallback) {
+                m_cursorPosCallback(*this, cursorPos.x, cursorPos.y);
             }
+            m_properties.m_cursorPos = cursorPos;
+        }
+        if (input.m_scroll && m_scrollCallback) {
+            m_scrollCallback(*this, input.m_scroll->x, input.m_scroll->y);
+        }
+        for (const auto& transition : input.m_keys) {
+            dispatchKey(transition);
+        }
+
+        input.clear();
+    }
+
+    void Window::replayInputEvents(InputState& input)
+    {
+        input.clear();    // the live input is dropped while replaying
+
+        if (m_replay->isDone()) {
+            std::cout << std::format("INFO: [Window] Window ({}) replay done after {} frames\n", m_id, m_replayFrame);
 
-            if (mods & hmod || hmod == 0) {    // modifier match or don't have any modifier
-                hfun(*this);
+            const bool close{ m_replayCloseWhenDone };
+            stopReplay();
+            if (close) {
+                requestClose();
+            }
+            return;
+        }
+
+        m_replay->read(m_replayFrame++, input);
+        for (const auto& [key, action, _] : input.m_keys) {
+            m_keyState.set(key, action != GLFW_RELEASE);
+        }
+    }
+
+    bool Window::startRecording(const std::filesystem::path& path)
+    {
+        m_recorder = InputLogWriter::open(path);
+        if (!m_recorder) {
+            return false;
+        }
+
+        m_recordFrame = 0;
+        m_recordStart = glfwGetTime();
+        std::cout << std::format("INFO: [Window] Window ({}) recording input to {}\n", m_id, path.string());
+        return true;
+    }
+
+    void Window::stopRecording()
+    {
+        if (m_recorder) {
+            std::cout << std::format("INFO: [Window] Window ({}) recorded {} frames\n", m_id, m_recordFrame);
+        }
+        m_recorder.reset();
+    }
+
+    bool Window::startReplay(const std::filesystem::path& path, double deltaTime, bool closeWhenDone)
+    {
+        m_replay = InputLogReader::open(path);
+        if (!m_replay) {
+            return false;
+        }
+
+        m_replayFrame         = 0;
+        m_replayDeltaTime     = deltaTime;
+        m_replayCloseWhenDone = closeWhenDone;
+        m_replaying.store(true, std::memory_order_relaxed);
+        m_keyState.clear();    // the keys held now are not part of the recording
+
+        std::cout << std::format("INFO: [Window] Window ({}) replaying input from {}\n", m_id, path.string());
+        return true;
+    }
+
+    void Window::stopReplay()
+    {
+        m_replay.reset();
+        m_replaying.store(false, std::memory_order_relaxed);
+        m_keyState.clear();    // releases the replayed keys
+    }
+
+    void Window::dispatchKey(const InputState::KeyTransition& transition)
+    {
+        const auto& [key, action, mods]{ transition };
+        if (action == GLFW_RELEASE || action == GLFW_REPEAT) {
+            return;
+        }    // ignore release and repeat event for now
+
+        for (const auto& handler : handlersOf(m_callbackHandlers, key)) {
+            if (mods & handler.m_mods || handler.m_mods == 0) {    // modifier match or don't have any modifier
+                (*handler.m_handler)(*this);
+            }
+        }
+    }
+
+    void Window::processInput()
+    {
+        PRETTY_FUNCTION_TIME_LOG();
+
+        const auto keys{ m_keyState.load() };
+        if (std::ranges::all_of(keys, [](std::uint64_t word) { return word == 0; })) {
+            return;    // nothing held
+        }
+        const auto mods{ KeyState::getMods(keys) };
+
+        // continuous key input, only for the keys held
+        for (std::size_t i{ 0 }; i < keys.size(); ++i) {
+            for (auto word{ keys[i] }; word != 0; word &= word - 1) {
+                const auto key{ static_cast<KeyEvent>(i * 64 + std::size_t(std::countr_zero(word))) };
+                for (const auto& handler : handlersOf(m_continuousHandlers, key)) {
+                    if (mods & handler.m_mods || handler.m_mods == 0) {    // modifier match or don't have any modifier
+                        (*handler.m_handler)(*this);
+                    }
+                }
             }
         }
     }
@@ -407,22 +884,82 @@ namespace window
     {
         PRETTY_FUNCTION_TIME_LOG();
 
-        decltype(m_taskQueue) taskQueue;
-        {
-            std::lock_guard lock{ m_queueMutex };
-            taskQueue.swap(m_taskQueue);
+        // only the tasks queued so far, the ones they queue wait for the next frame
+        for (auto count{ m_taskQueue->size() }; count > 0; --count) {
+            auto func{ m_taskQueue->tryPop() };
+            if (!func) {
+                break;
+            }
+            (*func)();
         }
-        while (!taskQueue.empty()) {
-            auto&& func{ taskQueue.front() };
-            func();
-            taskQueue.pop();
+    }
+
+    void Window::limitFrameRate()
+    {
+        using Clock = std::chrono::steady_clock;
+
+        // sleeping may overshoot by a scheduler tick, so the sleep stops short of the deadline and the rest is spun
+        constexpr auto spinMargin{ std::chrono::microseconds{ 1500 } };
+
+        const bool background{ !m_focused.load(std::memory_order_relaxed)
+                               || m_iconified.load(std::memory_order_relaxed) };
+        const auto budget{ background && m_backgroundFrameBudget ? m_backgroundFrameBudget : m_frameBudget };
+
+        auto now{ Clock::now() };
+        if (!budget) {
+            m_nextFrame = now;
+            recordFrame(now);
+            return;
         }
+
+        // paced from the previous deadline, not from now, so the frame times don't drift; a late frame starts over
+        // from now instead of rushing the next ones to catch up
+        m_nextFrame += *budget;
+        if (m_nextFrame <= now) {
+            m_nextFrame = now;
+        } else {
+            if (m_nextFrame - now > spinMargin) {
+                std::this_thread::sleep_until(m_nextFrame - spinMargin);
+            }
+            while ((now = Clock::now()) < m_nextFrame) {
+                std::this_thread::yield();
+            }
+        }
+        recordFrame(now);
+    }
+
+    void Window::recordFrame(std::chrono::steady_clock::time_point now)
+    {
+        if (m_lastPresent != std::chrono::steady_clock::time_point{}) {
+            const double frameTime{ std::chrono::duration<double, std::milli>{ now - m_lastPresent }.count() };
+
+            ++m_frameCount;
+            const double delta{ frameTime - m_frameTimeMean };
+            m_frameTimeMean += delta / static_cast<double>(m_frameCount);
+            m_frameTimeM2   += delta * (frameTime - m_frameTimeMean);
+            m_frameTimeMax   = std::max(m_frameTimeMax, frameTime);
+        }
+        m_lastPresent = now;
+    }
+
+    void Window::recordRetiredFrame(
+        std::chrono::steady_clock::duration cpuAhead,
+        std::chrono::steady_clock::duration wait
+    )
+    {
+        using Milliseconds = std::chrono::duration<double, std::milli>;
+
+        const double cpuAheadMs{ Milliseconds{ cpuAhead }.count() };
+        ++m_retiredFrames;
+        m_cpuAheadSum  += cpuAheadMs;
+        m_cpuAheadMax   = std::max(m_cpuAheadMax, cpuAheadMs);
+        m_fenceWaitSum += Milliseconds{ wait }.count();
     }
 
     void Window::updateDeltaTime()
     {
         double currentTime{ glfwGetTime() };
-        m_deltaTime     = currentTime - m_lastFrameTime;
+        m_deltaTime     = m_replay ? m_replayDeltaTime : currentTime - m_lastFrameTime;
         m_lastFrameTime = currentTime;
     }
 }
@@ -1,8 +1,9 @@
+#include <cstdlib>
 #include <format>
 #include <functional>
 #include <iostream>
-#include <mutex>
 #include <optional>
+#include <string_view>
 #include <thread>
 
 #define GLFW_INCLUDE_NONE
@@ -13,6 +14,34 @@
 
 namespace window
 {
+    bool WindowManager::initGlfw(std::optional<Backend> backend)
+    {
+        if (!backend) {
+            const char* env{ std::getenv("LEARNOPENGL_BACKEND") };
+            backend = env != nullptr && std::string_view{ env } == "headless" ? Backend::HEADLESS : Backend::DISPLAY;
+        }
+
+        if (*backend == Backend::HEADLESS) {
+#ifdef GLFW_PLATFORM_NULL
+            glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+            std::cerr << "ERROR: [WindowManager] Headless backend needs GLFW 3.4 or newer\n";
+            return false;
+#endif
+        }
+
+        if (!glfwInit()) {
+            std::cerr << "ERROR: [WindowManager] Failed to initialize GLFW\n";
+            return false;
+        }
+
+        s_backend = *backend;
+        if (s_backend == Backend::HEADLESS) {
+            std::cout << "INFO: [WindowManager] Running headless\n";
+        }
+        return true;
+    }
+
     bool WindowManager::createInstance()
     {
         if (!s_instance) {
@@ -38,7 +67,45 @@ namespace window
 
     std::optional<Window> WindowManager::createWindow(const std::string& title, int width, int height)
     {
-        unique_GLFWwindow glfwWindow{ glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr), &glfwDestroyWindow };
+        return createWindowImpl(title, width, height, nullptr);
+    }
+
+    std::optional<Window> WindowManager::createSharedContext(const Window& shareWith)
+    {
+        GLFWwindow* current{ glfwGetCurrentContext() };
+
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        auto window{ createWindowImpl("shared context", 1, 1, shareWith.getHandle()) };
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+        glfwMakeContextCurrent(current);    // the Window constructor leaves no context current
+        return window;
+    }
+
+    std::optional<Window> WindowManager::createWindowImpl(
+        const std::string& title,
+        int                width,
+        int                height,
+        GLFWwindow*        share
+    )
+    {
+        unique_GLFWwindow glfwWindow{ nullptr, &glfwDestroyWindow };
+        if (s_backend == Backend::HEADLESS) {
+#ifdef GLFW_PLATFORM_NULL
+            // OSMesa gives a default framebuffer to draw in but is gone from recent Mesa; EGL has no surface to draw
+            // in without a display, Window makes one up (see Window::Window). shared contexts end up with the same api
+            for (int api : { GLFW_OSMESA_CONTEXT_API, GLFW_EGL_CONTEXT_API }) {
+                glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+                glfwWindow.reset(glfwCreateWindow(width, height, title.c_str(), nullptr, share));
+                if (glfwWindow) {
+                    break;
+                }
+            }
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_NATIVE_CONTEXT_API);
+#endif
+        } else {
+            glfwWindow.reset(glfwCreateWindow(width, height, title.c_str(), nullptr, share));
+        }
         if (!glfwWindow) {
             std::cout << "WARNING: [WindowManager] Window creation failed\n";
             return {};
@@ -52,7 +119,12 @@ namespace window
             "INFO: [WindowManager] Window ({} | {:#x}) created\n", id, (std::size_t)windowHandle
         );
 
-        return Window{ id, windowHandle, { .m_title = title, .m_width = width, .m_height = height, .m_cursorPos = {} } };
+        return Window{
+            id,
+            windowHandle,
+            { .m_title = title, .m_width = width, .m_height = height, .m_cursorPos = {} },
+            share == nullptr,
+        };
     }
 
     WindowManager::WindowManager(std::thread::id threadId)
@@ -64,10 +136,8 @@ namespace window
 
     void WindowManager::requestDeleteWindow(std::size_t id)
     {
-        std::scoped_lock lock{ m_queueMutex };
-        if (m_windows.contains(id)) {    // accept request only for available windows
-            m_windowDeleteQueue.push(id);
-        }
+        m_windowDeleteQueue.push(id);    // unknown windows are skipped in checkTasks
+        wake();
     }
 
     void WindowManager::pollEvents(std::optional<std::chrono::milliseconds> msPollRate)
@@ -86,33 +156,51 @@ namespace window
         checkTasks();
     }
 
+    void WindowManager::waitEventsTimeout(std::chrono::milliseconds period)
+    {
+        const auto now{ std::chrono::steady_clock::now() };
+        if (now >= m_deadline) {
+            m_deadline = now + period;
+        }
+
+        glfwWaitEventsTimeout(std::chrono::duration<double>(m_deadline - now).count());
+        checkTasks();
+    }
+
     bool WindowManager::hasWindowOpened()
     {
         return m_windows.size() != 0;
     }
 
-    void WindowManager::enqueueWindowTask(std::size_t windowId, std::function<void()>&& task)
+    void WindowManager::enqueueWindowTask(std::size_t windowId, Task&& task)
+    {
+        m_windowTaskQueue.push({ .m_windowId = windowId, .m_task = std::move(task) });
+        wake();
+    }
+
+    void WindowManager::enqueueTask(Task&& task)
     {
-        std::scoped_lock lock{ m_queueMutex };
-        m_windowTaskQueue.emplace(windowId, std::move(task));
+        m_taskQueue.push(std::move(task));
+        wake();
     }
 
-    void WindowManager::enqueueTask(std::function<void()>&& task)
+    void WindowManager::wake()
     {
-        std::scoped_lock lock{ m_queueMutex };
-        m_taskQueue.emplace(std::move(task));
+        // one empty event is enough however many tasks are queued until the main thread gets to them
+        if (!m_wakeRequested.exchange(true, std::memory_order_acq_rel)) {
+            glfwPostEmptyEvent();
+        }
     }
 
     void WindowManager::checkTasks()
     {
-        std::lock_guard lock{ m_queueMutex };
+        // cleared before the queues are read (an acquire, so the reads can't move up): a task queued from now on posts
+        // another event
+        m_wakeRequested.exchange(false, std::memory_order_acq_rel);
 
         // window deletion
-        while (!m_windowDeleteQueue.empty()) {
-            std::size_t windowId{ m_windowDeleteQueue.front() };
-            m_windowDeleteQueue.pop();
-
-            auto found{ m_windows.find(windowId) };
+        while (auto windowId{ m_windowDeleteQueue.tryPop() }) {
+            auto found{ m_windows.find(*windowId) };
             if (found == m_windows.end()) {
                 continue;
             }
@@ -125,9 +213,8 @@ namespace window
         }
 
         // window task requests
-        while (!m_windowTaskQueue.empty()) {
-            auto [id, fun]{ std::move(m_windowTaskQueue.front()) };
-            m_windowTaskQueue.pop();
+        while (auto windowTask{ m_windowTaskQueue.tryPop() }) {
+            auto& [id, fun]{ *windowTask };
             if (m_windows.contains(id)) {
                 fun();
             } else {
@@ -137,11 +224,13 @@ namespace window
             }
         }
 
-        // general task request
-        while (!m_taskQueue.empty()) {
-            auto fun{ std::move(m_taskQueue.front()) };
-            m_taskQueue.pop();
-            fun();
+        // general task request, the ones queued by these tasks wait for the next call
+        for (auto count{ m_taskQueue.size() }; count > 0; --count) {
+            auto fun{ m_taskQueue.tryPop() };
+            if (!fun) {
+                break;
+            }
+            (*fun)();
         }
     }
 }
@@ -23,7 +23,7 @@ int main()
 
     util::ScopeTimeLogger::start();
 
-    if (!glfwInit()) {
+    if (!window::WindowManager::initGlfw()) {
         std::cerr << "Failed to initialize GLFW\n";
         return 1;
     }
@@ -61,7 +61,7 @@ int main()
     };
 
     while (windowManager.hasWindowOpened()) {
-        windowManager.pollEvents(120_fps);
+        windowManager.waitEventsTimeout(120_fps);
     }
 
     WindowManager::destroyInstance();
@@ -1,19 +1,25 @@
 #ifndef MESH_HPP_FCAKKYD8
 #define MESH_HPP_FCAKKYD8
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
 #include <glbinding/gl/gl.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include "common/old/shader.hpp"
 #include "common/old/texture.hpp"
 
-// #define ENABLE_BONE_INFLUENCE
-
 struct Vertex
 {
     static inline constexpr std::size_t s_maxBoneInfluence{ 4 };
@@ -24,86 +30,454 @@ struct Vertex
     glm::vec3 m_tangent{};
     glm::vec3 m_bitangent{};
 
-#ifdef ENABLE_BONE_INFLUENCE
-    std::array<std::size_t, s_maxBoneInfluence> m_boneIDs{};    // bone indexes which will influence this vertex
-    std::array<float, s_maxBoneInfluence>       m_weights{};    // weights from each bone
-#endif
+    std::array<std::uint16_t, s_maxBoneInfluence> m_joints{};     // joints of the skeleton influencing this vertex
+    std::array<float, s_maxBoneInfluence>         m_weights{};    // sum to 1 on a skinned mesh
+};
+
+// attributes the model file actually provides, the missing ones are left zeroed in Vertex
+struct VertexAttributes
+{
+    bool m_normals{ false };
+    bool m_texCoords{ false };
+    bool m_tangents{ false };    // tangents and bitangents always come together
+    bool m_skin{ false };        // joints and weights
+};
+
+// axis aligned bounding box and bounding sphere, in model space
+struct Bounds
+{
+    glm::vec3 m_min{};
+    glm::vec3 m_max{};
+    glm::vec3 m_center{};    // of the sphere
+    float     m_radius{};
+};
+
+// a texture used by a mesh as referenced by the model file, before it is loaded
+struct TextureRef
+{
+    std::uint32_t m_type;     // aiTextureType
+    std::uint32_t m_index;    // index among the textures of the same type
+    std::string   m_path;     // relative to the model directory
+};
+
+// a level of detail of a mesh: a range of its index buffer, all the levels share the vertices
+struct MeshLod
+{
+    std::uint32_t m_indexOffset;
+    std::uint32_t m_indexCount;
+    float         m_error;    // how far (in model space) the surface may be from the full resolution one
+};
+
+// cpu side of a mesh, before it is uploaded
+struct MeshData
+{
+    std::vector<Vertex>       m_vertices;
+    std::vector<unsigned int> m_indices;
+    std::vector<TextureRef>   m_textures;
+    Bounds                    m_bounds;
+    VertexAttributes          m_attributes;
+    std::vector<MeshLod>      m_lods;    // the first one is the full resolution mesh; empty: the whole index buffer
+};
+
+enum class PositionEncoding
+{
+    FLOAT,      // 12 bytes, exact
+    HALF,       // 8 bytes, precision relative to the distance from the origin
+    SNORM16,    // 8 bytes, relative to the mesh bounds so the precision is the same over the whole mesh
+};
+
+/*
+ * GPU layout of the vertices of a mesh, chosen per mesh from the attributes it actually has. Missing attributes
+ * take no space in the buffer (the shader gets the attribute default instead).
+ *
+ *     location 0  position     float3 | half4 | snorm16x4 relative to the bounds
+ *     location 1  normal       octahedral snorm16x2
+ *     location 2  texCoords    unorm16x2 relative to the range of the uvs
+ *     location 3  tangent      octahedral snorm16x2, bitangent sign, padding (snorm16x4)
+ *     location 4  joints       uint16x4
+ *     location 6  weights      unorm8x4 (location 5 is the draw id of GeometryBatch)
+ *
+ * That is 36 bytes at most instead of sizeof(Vertex). The positions and uvs are remapped with a per mesh scale and
+ * offset (see Dequantization) that the vertex shader applies, and the normals and tangents need an octahedral
+ * decode; the bitangent is rebuilt as cross(normal, tangent) * sign.
+ */
+class VertexFormat
+{
+public:
+    // what the vertex shader multiplies and adds back: u_positionScale/Offset and u_texCoordsScale/Offset
+    struct Dequantization
+    {
+        glm::vec3 m_positionScale{ 1.0f };
+        glm::vec3 m_positionOffset{ 0.0f };
+        glm::vec2 m_texCoordsScale{ 1.0f };
+        glm::vec2 m_texCoordsOffset{ 0.0f };
+    };
+
+private:
+    PositionEncoding m_position;
+    VertexAttributes m_attributes;
+    std::size_t      m_normalOffset{ 0 };
+    std::size_t      m_texCoordsOffset{ 0 };
+    std::size_t      m_tangentOffset{ 0 };
+    std::size_t      m_skinOffset{ 0 };           // joints
+    std::size_t      m_skinWeightsOffset{ 0 };
+    std::size_t      m_stride{ 0 };
+
+public:
+    VertexFormat(const VertexAttributes& attributes, PositionEncoding position)
+        : m_position{ position }
+        , m_attributes{ attributes }
+    {
+        m_stride = position == PositionEncoding::FLOAT ? 3 * sizeof(float) : 4 * sizeof(std::uint16_t);
+        if (attributes.m_normals) {
+            m_normalOffset  = m_stride;
+            m_stride       += 2 * sizeof(std::int16_t);
+        }
+        if (attributes.m_texCoords) {
+            m_texCoordsOffset  = m_stride;
+            m_stride          += 2 * sizeof(std::uint16_t);
+        }
+        if (attributes.m_tangents) {
+            m_tangentOffset  = m_stride;
+            m_stride        += 4 * sizeof(std::int16_t);
+        }
+        if (attributes.m_skin) {
+            m_skinOffset         = m_stride;
+            m_skinWeightsOffset  = m_stride + Vertex::s_maxBoneInfluence * sizeof(std::uint16_t);
+            m_stride            += Vertex::s_maxBoneInfluence * (sizeof(std::uint16_t) + sizeof(std::uint8_t));
+        }
+    }
+
+    std::size_t getStride() const { return m_stride; }
+
+    bool isSkinned() const { return m_attributes.m_skin; }
+
+    std::vector<std::byte> pack(
+        std::span<const Vertex> vertices,
+        const Bounds&           bounds,
+        Dequantization&         dequantization
+    ) const
+    {
+        dequantization = {};
+
+        if (m_position == PositionEncoding::SNORM16) {
+            const glm::vec3 halfExtent{ (bounds.m_max - bounds.m_min) * 0.5f };
+            dequantization.m_positionScale  = glm::max(halfExtent, glm::vec3{ std::numeric_limits<float>::min() });
+            dequantization.m_positionOffset = (bounds.m_max + bounds.m_min) * 0.5f;
+        }
+
+        if (m_attributes.m_texCoords && !vertices.empty()) {
+            glm::vec2 min{ std::numeric_limits<float>::max() };
+            glm::vec2 max{ std::numeric_limits<float>::lowest() };
+            for (const auto& vertex : vertices) {
+                min = glm::min(min, vertex.m_texCoords);
+                max = glm::max(max, vertex.m_texCoords);
+            }
+            dequantization.m_texCoordsScale  = glm::max(max - min, glm::vec2{ std::numeric_limits<float>::min() });
+            dequantization.m_texCoordsOffset = min;
+        }
+
+        std::vector<std::byte> data(vertices.size() * m_stride);
+        std::byte*             out{ data.data() };
+
+        const auto write = [&](std::size_t offset, const auto& value) {
+            std::memcpy(out + offset, &value, sizeof(value));
+        };
+
+        for (const auto& vertex : vertices) {
+            switch (m_position) {
+            case PositionEncoding::FLOAT: write(0, vertex.m_position); break;
+            case PositionEncoding::HALF: {
+                const auto& p{ vertex.m_position };
+                write(0, std::array{ half(p.x), half(p.y), half(p.z), std::uint16_t{ 0 } });
+            } break;
+            case PositionEncoding::SNORM16: {
+                const auto p{ (vertex.m_position - dequantization.m_positionOffset)
+                              / dequantization.m_positionScale };
+                write(0, std::array{ snorm16(p.x), snorm16(p.y), snorm16(p.z), std::int16_t{ 0 } });
+            } break;
+            }
+
+            if (m_attributes.m_normals) {
+                const auto n{ octEncode(vertex.m_normal) };
+                write(m_normalOffset, std::array{ snorm16(n.x), snorm16(n.y) });
+            }
+            if (m_attributes.m_texCoords) {
+                const auto uv{ (vertex.m_texCoords - dequantization.m_texCoordsOffset)
+                               / dequantization.m_texCoordsScale };
+                write(m_texCoordsOffset, std::array{ unorm16(uv.x), unorm16(uv.y) });
+            }
+            if (m_attributes.m_tangents) {
+                const auto t{ octEncode(vertex.m_tangent) };
+                const auto b{ glm::cross(vertex.m_normal, vertex.m_tangent) };
+                const auto s{ glm::dot(b, vertex.m_bitangent) < 0.0f ? -1.0f : 1.0f };
+                write(m_tangentOffset, std::array{ snorm16(t.x), snorm16(t.y), snorm16(s), std::int16_t{ 0 } });
+            }
+            if (m_attributes.m_skin) {
+                const auto& w{ vertex.m_weights };
+                write(m_skinOffset, vertex.m_joints);
+                write(m_skinWeightsOffset, std::array{ unorm8(w[0]), unorm8(w[1]), unorm8(w[2]), unorm8(w[3]) });
+            }
+
+            out += m_stride;
+        }
+
+        return data;
+    }
+
+    // the vertex array and the buffer must be bound
+    void setAttributePointers() const
+    {
+        using namespace gl;
+
+        const auto stride{ static_cast<GLsizei>(m_stride) };
+        const auto offset = [](std::size_t offset) { return reinterpret_cast<const void*>(offset); };
+
+        // clang-format off
+        switch (m_position) {
+        case PositionEncoding::FLOAT:   glVertexAttribPointer(0, 3, GL_FLOAT,      GL_FALSE, stride, offset(0)); break;
+        case PositionEncoding::HALF:    glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, offset(0)); break;
+        case PositionEncoding::SNORM16: glVertexAttribPointer(0, 3, GL_SHORT,      GL_TRUE,  stride, offset(0)); break;
+        }
+        glEnableVertexAttribArray(0);
+
+        if (m_attributes.m_normals) {
+            glVertexAttribPointer(1, 2, GL_SHORT,          GL_TRUE, stride, offset(m_normalOffset));
+            glEnableVertexAttribArray(1);
+        }
+        if (m_attributes.m_texCoords) {
+            glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, offset(m_texCoordsOffset));
+            glEnableVertexAttribArray(2);
+        }
+        if (m_attributes.m_tangents) {
+            glVertexAttribPointer(3, 3, GL_SHORT,          GL_TRUE, stride, offset(m_tangentOffset));
+            glEnableVertexAttribArray(3);
+        }
+        if (m_attributes.m_skin) {
+            glVertexAttribIPointer(4, 4, GL_UNSIGNED_SHORT,          stride, offset(m_skinOffset));
+            glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE,   GL_TRUE, stride, offset(m_skinWeightsOffset));
+            glEnableVertexAttribArray(4);
+            glEnableVertexAttribArray(6);
+        }
+        // clang-format on
+    }
+
+private:
+    static std::int16_t snorm16(float value)
+    {
+        return static_cast<std::int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    static std::uint16_t half(float value) { return glm::packHalf1x16(value); }
+
+    static std::uint16_t unorm16(float value)
+    {
+        return static_cast<std::uint16_t>(std::round(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+    }
+
+    static std::uint8_t unorm8(float value)
+    {
+        return static_cast<std::uint8_t>(std::round(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+    }
+
+    // maps the unit sphere onto the [-1, 1] square; a zero vector ends up as (0, 0, 1)
+    static glm::vec2 octEncode(const glm::vec3& vec)
+    {
+        const float l1{ std::abs(vec.x) + std::abs(vec.y) + std::abs(vec.z) };
+        if (l1 == 0.0f) {
+            return {};
+        }
+
+        const glm::vec3 n{ vec / l1 };
+        if (n.z >= 0.0f) {
+            return { n.x, n.y };
+        }
+
+        // fold the lower hemisphere over the diagonals
+        return {
+            (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+            (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f),
+        };
+    }
+};
+
+/*
+ * Index buffer in the narrowest type that can address every vertex of its mesh: 8 bits up to 256 vertices, 16 bits
+ * up to 65536 and 32 bits above. Most meshes of a model are small enough for 16 bits, which halves the memory and the
+ * bandwidth the indices take.
+ */
+class IndexData
+{
+private:
+    gl::GLenum             m_type;
+    std::size_t            m_indexSize;
+    std::vector<std::byte> m_bytes;
+
+public:
+    IndexData(std::span<const unsigned int> indices, std::size_t numVertices)
+    {
+        if (numVertices <= std::size_t{ std::numeric_limits<std::uint8_t>::max() } + 1) {
+            narrow<std::uint8_t>(indices, gl::GL_UNSIGNED_BYTE);
+        } else if (numVertices <= std::size_t{ std::numeric_limits<std::uint16_t>::max() } + 1) {
+            narrow<std::uint16_t>(indices, gl::GL_UNSIGNED_SHORT);
+        } else {
+            narrow<std::uint32_t>(indices, gl::GL_UNSIGNED_INT);
+        }
+    }
+
+    gl::GLenum                 getType() const { return m_type; }
+    std::size_t                getIndexSize() const { return m_indexSize; }
+    std::span<const std::byte> getBytes() const { return m_bytes; }
+
+private:
+    template <typename Index>
+    void narrow(std::span<const unsigned int> indices, gl::GLenum type)
+    {
+        m_type      = type;
+        m_indexSize = sizeof(Index);
+        m_bytes.resize(indices.size() * sizeof(Index));
+
+        auto* out{ m_bytes.data() };
+        for (auto index : indices) {
+            const auto narrowed{ static_cast<Index>(index) };
+            std::memcpy(out, &narrowed, sizeof(Index));
+            out += sizeof(Index);
+        }
+    }
+};
+
+// a (possibly shared) texture together with how this mesh binds it
+struct MeshTexture
+{
+    std::shared_ptr<const Texture> m_texture;
+    std::string                    m_uniformName;
+    gl::GLint                      m_unitNum;
 };
 
 class Mesh
 {
 private:
-    std::vector<Vertex>       m_vertices{};
-    std::vector<unsigned int> m_indices{};
-    std::vector<Texture*>     m_textures{};    // a mesh does not own its textures
+    std::vector<MeshTexture>     m_textures{};
+    std::vector<MeshLod>         m_lods{};
+    Bounds                       m_bounds{};
+    VertexFormat::Dequantization m_dequantization{};
+    std::size_t                  m_vertexBytes{};
+    std::size_t                  m_indexBytes{};
+    VertexFormat                 m_format;
+    gl::GLenum                   m_indexType{ gl::GL_UNSIGNED_INT };
+    std::size_t                  m_indexSize{ sizeof(unsigned int) };
 
-    gl::GLuint m_vao{};
-    gl::GLuint m_vbo{};
-    gl::GLuint m_ebo{};
+    // vertex arrays are not shared between contexts, this one is made by the context that draws the mesh first;
+    // the buffers can come from any context sharing with it
+    mutable gl::GLuint m_vao{};
+    gl::GLuint         m_vbo{};
+    gl::GLuint         m_ebo{};
 
 public:
+    // the vertex and index data are only read during construction, they may point into a mapped file
     Mesh(
-        std::vector<Vertex>&&       vertices,
-        std::vector<unsigned int>&& indices,
-        std::vector<Texture*>&&     textures
+        std::span<const Vertex>       vertices,
+        std::span<const unsigned int> indices,
+        std::span<const MeshLod>      lods,
+        const VertexAttributes&       attributes,
+        std::vector<MeshTexture>&&    textures,
+        const Bounds&                 bounds,
+        PositionEncoding              positionEncoding = PositionEncoding::SNORM16
     )
-        : m_vertices{ vertices }
-        , m_indices{ indices }
-        , m_textures{ textures }
+        : m_textures{ std::move(textures) }
+        , m_lods{ lods.begin(), lods.end() }
+        , m_bounds{ bounds }
+        , m_format{ attributes, positionEncoding }
     {
-        setupMesh();
+        if (m_lods.empty()) {
+            m_lods.push_back({ .m_indexOffset = 0, .m_indexCount = std::uint32_t(indices.size()), .m_error = 0.0f });
+        }
+        setupMesh(vertices, indices);
     }
 
-    void draw(Shader& shader) const
+    const Bounds& getBounds() const { return m_bounds; }
+
+    const std::vector<MeshLod>& getLods() const { return m_lods; }
+
+    // size of the vertex buffer on the gpu
+    std::size_t getVertexBytes() const { return m_vertexBytes; }
+
+    // size of the index buffer on the gpu
+    std::size_t getIndexBytes() const { return m_indexBytes; }
+
+    // a skinned mesh reads its palette from u_palette at u_paletteOffset, see SkinningPalette
+    void draw(Shader& shader, std::size_t lod = 0) const
     {
-        for (auto* tex : m_textures) {
-            tex->activate(shader);
+        shader.setUniform("u_skinned", m_format.isSkinned());
+        shader.setUniform("u_positionScale", m_dequantization.m_positionScale);
+        shader.setUniform("u_positionOffset", m_dequantization.m_positionOffset);
+        shader.setUniform("u_texCoordsScale", m_dequantization.m_texCoordsScale);
+        shader.setUniform("u_texCoordsOffset", m_dequantization.m_texCoordsOffset);
+
+        for (const auto& [texture, uniformName, unitNum] : m_textures) {
+            texture->activate(shader, uniformName, unitNum);
         }
 
         using namespace gl;
+        const auto& [indexOffset, indexCount, _]{ m_lods[std::min(lod, m_lods.size() - 1)] };
+
+        if (m_vao == 0) {
+            setupVertexArray();
+        }
+
         glBindVertexArray(m_vao);
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_indices.size()), GL_UNSIGNED_INT, 0);
+        glDrawElements(
+            GL_TRIANGLES,
+            static_cast<GLsizei>(indexCount),
+            m_indexType,
+            reinterpret_cast<const void*>(indexOffset * m_indexSize)
+        );
         glBindVertexArray(0);
     }
 
 private:
-    void setupMesh()
+    // no vertex array is bound here, so both buffers go through GL_ARRAY_BUFFER (the element array binding
+    // belongs to the vertex array)
+    void setupMesh(std::span<const Vertex> vertices, std::span<const unsigned int> indices)
     {
         using namespace gl;
 
-        glGenVertexArrays(1, &m_vao);
+        const auto      packed{ m_format.pack(vertices, m_bounds, m_dequantization) };
+        const IndexData indexData{ indices, vertices.size() };
+
+        m_vertexBytes = packed.size();
+        m_indexBytes  = indexData.getBytes().size();
+        m_indexType   = indexData.getType();
+        m_indexSize   = indexData.getIndexSize();
+
         glGenBuffers(1, &m_vbo);
         glGenBuffers(1, &m_ebo);
 
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(packed.size()), packed.data(), GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_ebo);
+        glBufferData(
+            GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_indexBytes), indexData.getBytes().data(), GL_STATIC_DRAW
+        );
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void setupVertexArray() const
+    {
+        using namespace gl;
+
+        glGenVertexArrays(1, &m_vao);
         glBindVertexArray(m_vao);
 
         glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_vertices.size() * sizeof(Vertex)), &m_vertices.front(), GL_STATIC_DRAW);
-
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_indices.size() * sizeof(m_indices.front())), &m_indices.front(), GL_STATIC_DRAW);
 
-        // clang-format off
-        glVertexAttribPointer(0, decltype(Vertex::m_position )::length(), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, m_position)));
-        glVertexAttribPointer(1, decltype(Vertex::m_normal   )::length(), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, m_normal)));
-        glVertexAttribPointer(2, decltype(Vertex::m_texCoords)::length(), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, m_texCoords)));
-        glVertexAttribPointer(3, decltype(Vertex::m_tangent  )::length(), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, m_tangent)));
-        glVertexAttribPointer(4, decltype(Vertex::m_bitangent)::length(), GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, m_bitangent)));
-#ifdef ENABLE_BONE_INFLUENCE
-        glVertexAttribPointer(5, Vertex::s_maxBoneInfluence, GL_INT,   GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, m_boneIDs)));
-        glVertexAttribPointer(6, Vertex::s_maxBoneInfluence, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, m_weights)));
-#endif
-        // clang-format on
-
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glEnableVertexAttribArray(2);
-        glEnableVertexAttribArray(3);
-        glEnableVertexAttribArray(4);
-        glEnableVertexAttribArray(5);
-        glEnableVertexAttribArray(6);
+        m_format.setAttributePointers();
 
         glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 };
 
@@ -1,23 +1,39 @@
 #ifndef MODEL_HPP_EAGQLJBT
 #define MODEL_HPP_EAGQLJBT
 
+#include <algorithm>
+#include <cmath>
 #include <concepts>
 #include <filesystem>
 #include <format>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <optional>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
 // #include "stringified_enum.hpp"
 
-#include "common/old/image_texture.hpp"
+#include "common/old/camera.hpp"
+#include "common/old/texture_cache.hpp"
 
+#include "animation.hpp"
+#include "bvh.hpp"
+#include "frustum.hpp"
+#include "geometry_batch.hpp"
+#include "lod_selector.hpp"
 #include "mesh.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "parallel_for.hpp"
 
 /*
 #define FIELD(M)                    \
@@ -29,9 +45,31 @@ using TextureType = STRINGIFIED_ENUM(TextureType, unsigned int, FIELD);
 #undef FIELD 
 */
 
+struct ModelLoadOptions
+{
+    PositionEncoding m_positionEncoding{ PositionEncoding::SNORM16 };
+    bool             m_optimizeMeshes{ true };    // reorder the meshes for the vertex cache and overdraw
+
+    // one level of detail per entry, the error target is relative to the size of each mesh; empty: no lods
+    std::vector<float> m_lodErrors{ 0.002f, 0.008f, 0.03f };
+
+    // also merge the meshes into this batch, so the same model can be drawn either mesh by mesh or with the batch
+    // (m_positionEncoding is ignored there, the batch has a single format); the batch must outlive the model
+    GeometryBatch* m_batch{ nullptr };
+};
+
 class Model
 {
 private:
+    static inline constexpr float s_animationFrameRate{ 30.0f };    // the clips are resampled to this rate
+
+    // flags: https://assimp.sourceforge.net/lib_html/postprocess_8h.html
+    // without JoinIdenticalVertices the obj importer gives every face corner its own vertex, leaving nothing for the
+    // vertex cache optimization to reuse and every vertex on a seam for the simplifier
+    static inline constexpr unsigned int s_importFlags{
+        aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices
+    };
+
     static inline const std::map<aiTextureType, std::string> s_textureTypeToName{
         { aiTextureType_DIFFUSE, "u_texture_diffuse" },
         { aiTextureType_SPECULAR, "u_texture_specular" },
@@ -39,67 +77,581 @@ private:
         { aiTextureType_HEIGHT, "u_texture_height" },
     };
 
+    // records every file the importer reads, so the mesh cache knows what it depends on
+    class RecordingIOSystem : public Assimp::DefaultIOSystem
+    {
+    public:
+        std::vector<std::string> m_openedFiles;
+
+        Assimp::IOStream* Open(const char* file, const char* mode = "rb") override
+        {
+            auto* stream{ Assimp::DefaultIOSystem::Open(file, mode) };
+            if (stream && std::ranges::find(m_openedFiles, file) == m_openedFiles.end()) {
+                m_openedFiles.emplace_back(file);
+            }
+            return stream;
+        }
+    };
+
 public:
     // can't wait for std::expected to come so i can return the error
-    static std::optional<Model> load(std::filesystem::path filePath)
+    static std::optional<Model> load(std::filesystem::path filePath, const ModelLoadOptions& options = {})
+    {
+        std::optional<Model> model;
+        import(filePath, options, [&](auto&& meshes, const AnimationData& animation) {
+            model.emplace(Model{ meshes, filePath, options });
+            model->setAnimation(AnimationData{ animation });
+        });
+        return model;
+    }
+
+    // the cpu part of load: reads the meshes from the mesh cache when it is up to date, from the file otherwise, and
+    // hands them to consume(meshes, animation) before returning, the meshes either as a
+    // const std::vector<MeshCache::MeshView>& or as a std::vector<MeshData>&&. makes no gl call, so it can run on
+    // any thread.
+    template <typename Consume>
+    static bool import(const std::filesystem::path& filePath, const ModelLoadOptions& options, Consume&& consume)
     {
+        const auto importKey{ importKeyOf(options) };
+
+        const auto cachePath{ MeshCache::pathFor(filePath) };
+        if (auto maybeCache{ MeshCache::open(cachePath, filePath.parent_path(), importKey) }; maybeCache) {
+            std::cout << std::format("INFO: [Model] Using mesh cache '{}'\n", cachePath.string());
+            consume(maybeCache->getMeshes(), maybeCache->getAnimation());
+            return true;
+        }
+
         Assimp::Importer importer;
+        auto*            ioSystem{ new RecordingIOSystem };    // owned by the importer
+        importer.SetIOHandler(ioSystem);
 
-        // flags: https://assimp.sourceforge.net/lib_html/postprocess_8h.html
-        const aiScene* scenePtr{ importer.ReadFile(filePath.c_str(), aiProcess_Triangulate | aiProcess_FlipUVs) };
+        const aiScene* scenePtr{ importer.ReadFile(filePath.c_str(), s_importFlags) };
         if (!scenePtr || scenePtr->mFlags & AI_SCENE_FLAGS_INCOMPLETE) {
             std::cerr << std::format("ERROR: [Assimp] {}\n", importer.GetErrorString());
-            return {};
+            return false;
         }
         const aiScene& scene{ *scenePtr };
-        return Model{ scene, filePath };
+
+        // convert the meshes in parallel, the node tree is only walked to get them in order. the gl part (upload and
+        // texture loading) is left to the consumer.
+        std::vector<const aiMesh*> meshes;
+        meshes.reserve(scene.mNumMeshes);
+        collectMeshesRecursive(*scene.mRootNode, scene, meshes);
+
+        std::map<std::string, std::uint16_t> jointIndices;
+        const auto                           animation{ importAnimation(scene, jointIndices) };
+
+        std::vector<MeshData>             meshDatas(meshes.size());
+        std::vector<MeshOptimizer::Stats> stats(meshes.size());
+        parallelFor(meshes.size(), [&](std::size_t i) {
+            meshDatas[i] = processMesh(*meshes[i], scene, jointIndices);
+            MeshSimplifier::buildLods(meshDatas[i], options.m_lodErrors);
+            if (options.m_optimizeMeshes) {
+                stats[i] = MeshOptimizer::optimize(meshDatas[i]);
+            }
+        });
+
+        if (options.m_optimizeMeshes) {
+            std::cout << std::format("INFO: [Model] Optimized the meshes of '{}'\n", filePath.string());
+            MeshOptimizer::logReport(stats);
+        }
+
+        writeCache(cachePath, importKey, filePath.parent_path(), ioSystem->m_openedFiles, meshDatas, animation);
+
+        consume(std::move(meshDatas), animation);
+        return true;
     }
 
-private:
-    std::vector<Mesh>     m_meshes;
-    std::filesystem::path m_filePath;
+    // one mesh of MeshData or MeshCache::MeshView to the gpu, textures included; needs a current context (any
+    // context sharing with the one that will draw it)
+    template <typename MeshType>
+    static Mesh upload(const MeshType& mesh, const std::filesystem::path& modelDir, PositionEncoding positionEncoding)
+    {
+        return Mesh{
+            std::span{ mesh.m_vertices },
+            std::span{ mesh.m_indices },
+            std::span{ mesh.m_lods },
+            mesh.m_attributes,
+            loadTextures(mesh.m_textures, modelDir),
+            mesh.m_bounds,
+            positionEncoding,
+        };
+    }
 
-    // NOTE: need a container that does not invalidate its reference on insertion
-    std::map<std::string, ImageTexture> s_loadedTextures;    // loaded textures are stored here to prevent loading the same texture multiple times
+private:
+    std::vector<Mesh>                 m_meshes;
+    std::filesystem::path             m_filePath;
+    std::vector<Bounds>               m_meshBounds;
+    Bvh                               m_bvh;                 // over m_meshBounds, in model space
+    GeometryBatch*                    m_batch{ nullptr };    // the meshes merged into the batch as well
+    std::vector<GeometryBatch::Range> m_batchRanges;         // one per addToBatch, in mesh order
+    std::vector<Bounds>               m_batchBounds;         // they may arrive before or after m_meshes
+    std::vector<std::size_t>          m_batchDraws;          // the draw in the batch of each of m_batchBounds
+    Bvh                               m_batchBvh;
+    AnimationData                     m_animation;
 
 public:
-    void draw(Shader& shader) const
+    // a model without meshes yet, they are added as they arrive with addMeshes and addToBatch (when batch is set)
+    explicit Model(std::filesystem::path filePath, GeometryBatch* batch = nullptr)
+        : m_filePath{ std::move(filePath) }
+        , m_batch{ batch }
+    {
+    }
+
+    // meshes uploaded by upload(), possibly on another context
+    void addMeshes(std::vector<Mesh>&& meshes)
+    {
+        for (auto& mesh : meshes) {
+            m_meshBounds.push_back(mesh.getBounds());
+            m_meshes.push_back(std::move(mesh));
+        }
+        m_bvh = Bvh{ m_meshBounds };
+    }
+
+    // MeshData or MeshCache::MeshView, the model must have been given a batch; needs the context of the batch
+    template <typename Meshes>
+    void addToBatch(const Meshes& meshes)
+    {
+        std::vector<GeometryBatch::MeshInput> inputs;
+        inputs.reserve(meshes.size());
+        for (const auto& mesh : meshes) {
+            inputs.push_back({
+                .m_vertices = std::span{ mesh.m_vertices },
+                .m_indices  = std::span{ mesh.m_indices },
+                .m_lods     = std::span{ mesh.m_lods },
+                .m_bounds   = mesh.m_bounds,
+                .m_diffuse  = findTexture(mesh.m_textures, aiTextureType_DIFFUSE, m_filePath.parent_path()),
+                .m_specular = findTexture(mesh.m_textures, aiTextureType_SPECULAR, m_filePath.parent_path()),
+            });
+            m_batchBounds.push_back(mesh.m_bounds);
+        }
+        const auto range{ m_batch->add(inputs) };
+        for (std::size_t i{ 0 }; i < range.m_count; ++i) {
+            m_batchDraws.push_back(range.m_first + i);
+        }
+        m_batchRanges.push_back(range);
+        m_batchBvh = Bvh{ m_batchBounds };
+    }
+
+    // replaces the material array of the batch, packed ahead (see GeometryBatch::packMaterials)
+    void setBatchMaterials(std::optional<TextureArray>&& materials)
+    {
+        if (m_batch) {
+            m_batch->setMaterials(std::move(materials));
+        }
+    }
+
+    // the images addToBatch gives the batch for these meshes, to pack them ahead (see GeometryBatch::packMaterials)
+    template <typename Meshes>
+    static std::vector<std::filesystem::path> batchImagesOf(const Meshes& meshes, const std::filesystem::path& modelDir)
     {
+        std::vector<std::filesystem::path> images;
+        for (const auto& mesh : meshes) {
+            for (auto type : { aiTextureType_DIFFUSE, aiTextureType_SPECULAR }) {
+                auto path{ findTexture(mesh.m_textures, type, modelDir) };
+                if (path && std::ranges::find(images, *path) == images.end()) {
+                    images.push_back(std::move(*path));
+                }
+            }
+        }
+        return images;
+    }
+
+    std::size_t getNumMeshes() const { return m_meshBounds.size(); }
+
+    void setAnimation(AnimationData&& animation) { m_animation = std::move(animation); }
+
+    // skinned meshes are drawn in the pose of the palette bound with SkinningPalette
+    const std::optional<Skeleton>&    getSkeleton() const { return m_animation.m_skeleton; }
+    const std::vector<AnimationClip>& getClips() const { return m_animation.m_clips; }
+
+    // drawing with the batch needs a shader that reads the batch draw table, see GeometryBatch
+    bool hasBatch() const { return m_batch != nullptr; }
+
+    // of the whole model, in model space
+    Bounds getBounds() const { return (m_meshBounds.empty() ? m_batchBvh : m_bvh).getBounds(); }
+
+    void draw(Shader& shader, bool batched = false) const
+    {
+        if (batched && m_batch) {
+            for (const auto& range : m_batchRanges) {
+                m_batch->draw(shader, range);
+            }
+            return;
+        }
         for (const auto& mesh : m_meshes) {
             mesh.draw(shader);
         }
     }
 
+    // draws the meshes that are in the view of the camera, each at the coarsest level of detail that looks the same
+    // from there (see LodSelector); the frustum is brought to model space so the mesh bounds are tested as they are
+    CullStats draw(
+        Shader&          shader,
+        const glm::mat4& model,
+        const Camera&    camera,
+        int              viewportWidth,
+        int              viewportHeight
+    ) const
+    {
+        const auto        projection{ camera.getProjectionMatrix(viewportWidth, viewportHeight) };
+        const LodSelector selector{ model, camera, viewportHeight };
+        const Frustum     frustum{ projection * camera.getViewMatrix() * model };
+
+        return m_bvh.cull(frustum, [&](std::size_t i) {
+            const auto& mesh{ m_meshes[i] };
+            mesh.draw(shader, selector.select(mesh.getBounds(), mesh.getLods()));
+        });
+    }
+
+    // the same culling and levels of detail for the batch: adds the meshes in view as a region of the frame of the
+    // batch (see GeometryBatch::addToFrame), to draw with the batch once every instance of the frame is added
+    std::pair<GeometryBatch::Region, CullStats> addToBatchFrame(
+        const glm::mat4& model,
+        const Camera&    camera,
+        int              viewportWidth,
+        int              viewportHeight
+    ) const
+    {
+        const auto        projection{ camera.getProjectionMatrix(viewportWidth, viewportHeight) };
+        const LodSelector selector{ model, camera, viewportHeight };
+        const Frustum     frustum{ projection * camera.getViewMatrix() * model };
+
+        const auto stats{ m_batchBvh.cull(frustum, [&](std::size_t mesh) {
+            m_batch->addToFrame(m_batchDraws[mesh], selector);
+        }) };
+        return { m_batch->endRegion(), stats };
+    }
+
 private:
     Model() = delete;
 
-    Model(const aiScene& scene, const std::filesystem::path& filePath)
-        : m_filePath{ filePath }
+    // MeshData from the importer or MeshCache::MeshView from the cache
+    template <typename Meshes>
+    Model(const Meshes& meshes, const std::filesystem::path& filePath, const ModelLoadOptions& options)
+        : Model{ filePath, options.m_batch }
     {
         std::cout << std::format("INFO: [Model] Loading model at '{}'\n", filePath.c_str());
 
-        m_meshes.reserve(scene.mNumMeshes);
-        processNodeRecursive(*scene.mRootNode, scene);
+        if (m_batch) {
+            addToBatch(meshes);
+            m_batch->setMaterials(GeometryBatch::packMaterials(m_batch->getImages()));
+        }
+
+        std::size_t unpackedBytes{ 0 };
+        std::size_t packedBytes{ 0 };
+        std::size_t indexBytes{ 0 };
+        std::size_t unpackedIndexBytes{ 0 };
+
+        std::vector<Mesh> uploaded;
+        uploaded.reserve(meshes.size());
+        for (const auto& mesh : meshes) {
+            const auto& added{
+                uploaded.emplace_back(upload(mesh, filePath.parent_path(), options.m_positionEncoding))
+            };
+
+            unpackedBytes      += mesh.m_vertices.size() * sizeof(Vertex);
+            packedBytes        += added.getVertexBytes();
+            unpackedIndexBytes += mesh.m_indices.size() * sizeof(unsigned int);
+            indexBytes         += added.getIndexBytes();
+        }
+        addMeshes(std::move(uploaded));
+
+        std::cout << std::format(
+            "INFO: [Model] Loaded model at '{}' (vertex data: {} KiB, {} KiB unpacked; index data: {} KiB, {} KiB as "
+            "32 bits)\n",
+            filePath.c_str(),
+            packedBytes / 1024,
+            unpackedBytes / 1024,
+            indexBytes / 1024,
+            unpackedIndexBytes / 1024
+        );
+    }
+
+    static void writeCache(
+        const std::filesystem::path&    cachePath,
+        std::uint32_t                   importKey,
+        const std::filesystem::path&    modelDir,
+        const std::vector<std::string>& openedFiles,
+        const std::vector<MeshData>&    meshDatas,
+        const AnimationData&            animation
+    )
+    {
+        std::vector<MeshCache::Dependency> dependencies;
+        for (const auto& file : openedFiles) {
+            auto maybeHash{ MeshCache::hashFile(file) };
+            if (!maybeHash) {
+                return;    // can't validate the cache later, don't write it
+            }
+            auto relative{ std::filesystem::path{ file }.lexically_relative(modelDir) };
+            dependencies.push_back({ .m_path = relative.empty() ? file : relative.string(), .m_hash = *maybeHash });
+        }
 
-        std::cout << std::format("INFO: [Model] Loaded model at '{}'\n", filePath.c_str());
+        if (MeshCache::write(cachePath, importKey, dependencies, meshDatas, animation)) {
+            std::cout << std::format("INFO: [Model] Mesh cache written to '{}'\n", cachePath.string());
+        }
     }
 
-    void processNodeRecursive(const aiNode& node, const aiScene& scene)
+    // FNV-1a over the options that change what ends up in the mesh cache
+    static std::uint32_t importKeyOf(const ModelLoadOptions& options)
+    {
+        std::uint32_t hash{ 0x811c9dc5 };
+        const auto    add = [&](const auto& value) {
+            for (auto byte : std::as_bytes(std::span{ &value, 1 })) {
+                hash ^= std::to_integer<std::uint32_t>(byte);
+                hash *= 0x01000193;
+            }
+        };
+
+        add(s_importFlags);
+        add(options.m_optimizeMeshes);
+        for (auto error : options.m_lodErrors) {
+            add(error);
+        }
+        return hash;
+    }
+
+    static void collectMeshesRecursive(const aiNode& node, const aiScene& scene, std::vector<const aiMesh*>& meshes)
     {
         for (std::size_t i{ 0 }; i < node.mNumMeshes; ++i) {
-            const aiMesh& mesh{ *scene.mMeshes[node.mMeshes[i]] };
-            m_meshes.emplace_back(processMesh(mesh, scene));
+            meshes.push_back(scene.mMeshes[node.mMeshes[i]]);
         }
         for (std::size_t i{ 0 }; i < node.mNumChildren; ++i) {
-            processNodeRecursive(*node.mChildren[i], scene);
+            collectMeshesRecursive(*node.mChildren[i], scene, meshes);
         }
     };
 
-    Mesh processMesh(const aiMesh& mesh, const aiScene& scene)
+    // the node tree becomes the skeleton, a joint per node in depth first order, as soon as a mesh has bones
+    static AnimationData importAnimation(const aiScene& scene, std::map<std::string, std::uint16_t>& jointIndices)
+    {
+        AnimationData animation;
+        const auto hasBones = [](const aiMesh* mesh) { return mesh->HasBones(); };
+        if (std::ranges::none_of(std::span{ scene.mMeshes, scene.mNumMeshes }, hasBones)) {
+            return animation;
+        }
+
+        std::vector<const aiNode*> nodes;
+        std::vector<std::int32_t>  parents;
+        collectNodesRecursive(*scene.mRootNode, -1, nodes, parents);
+        if (nodes.size() > std::numeric_limits<std::uint16_t>::max()) {
+            std::cerr << std::format("ERROR: [Model] Too many nodes for a skeleton ({})\n", nodes.size());
+            return animation;
+        }
+
+        const auto numJoints{ nodes.size() };
+        for (std::size_t j{ 0 }; j < numJoints; ++j) {
+            jointIndices.emplace(nodes[j]->mName.C_Str(), std::uint16_t(j));
+        }
+
+        auto& skeleton{ animation.m_skeleton.emplace() };
+        skeleton.m_parents       = std::move(parents);
+        skeleton.m_globalInverse = glm::inverse(toGlm(scene.mRootNode->mTransformation));
+        skeleton.m_inverseBind.assign(numJoints, glm::mat4{ 1.0f });
+        for (const auto* mesh : std::span{ scene.mMeshes, scene.mNumMeshes }) {
+            for (const auto* bone : std::span{ mesh->mBones, mesh->mNumBones }) {
+                if (auto found{ jointIndices.find(bone->mName.C_Str()) }; found != jointIndices.end()) {
+                    skeleton.m_inverseBind[found->second] = toGlm(bone->mOffsetMatrix);
+                }
+            }
+        }
+
+        Pose bindPose{ numJoints };
+        for (std::size_t j{ 0 }; j < numJoints; ++j) {
+            aiVector3D   scaling;
+            aiQuaternion rotation;
+            aiVector3D   position;
+            nodes[j]->mTransformation.Decompose(scaling, rotation, position);
+            setJoint(bindPose, j, position, rotation, scaling);
+        }
+        skeleton.m_bindPose.assign(bindPose.data().begin(), bindPose.data().end());
+
+        for (const auto* source : std::span{ scene.mAnimations, scene.mNumAnimations }) {
+            animation.m_clips.push_back(resampleClip(*source, skeleton, jointIndices));
+        }
+
+        std::cout << std::format(
+            "INFO: [Model] Skeleton of {} joints, {} animation clips\n", numJoints, animation.m_clips.size()
+        );
+        return animation;
+    }
+
+    // samples every channel at s_animationFrameRate; the joints without a channel keep their bind pose
+    static AnimationClip resampleClip(
+        const aiAnimation&                          source,
+        const Skeleton&                             skeleton,
+        const std::map<std::string, std::uint16_t>& jointIndices
+    )
+    {
+        const double ticksPerSecond{ source.mTicksPerSecond > 0.0 ? source.mTicksPerSecond : 25.0 };
+        const double duration{ source.mDuration / ticksPerSecond };
+
+        AnimationClip clip{
+            .m_name      = source.mName.C_Str(),
+            .m_frameRate = s_animationFrameRate,
+            .m_numFrames = std::uint32_t(std::ceil(duration * s_animationFrameRate)) + 1,
+            .m_frames    = {},
+        };
+
+        const auto numJoints{ skeleton.getNumJoints() };
+        Pose       pose{ numJoints };
+        clip.m_frames.reserve(clip.m_numFrames * pose.data().size());
+
+        for (std::uint32_t frame{ 0 }; frame < clip.m_numFrames; ++frame) {
+            std::ranges::copy(skeleton.m_bindPose, pose.data().begin());
+            const double ticks{ std::min(frame / double(s_animationFrameRate), duration) * ticksPerSecond };
+
+            for (const auto* channel : std::span{ source.mChannels, source.mNumChannels }) {
+                const auto found{ jointIndices.find(channel->mNodeName.C_Str()) };
+                if (found == jointIndices.end()) {
+                    continue;
+                }
+                const auto j{ found->second };
+
+                const auto lerp = [](const aiVector3D& a, const aiVector3D& b, float t) { return a + (b - a) * t; };
+                const auto slerp = [](const aiQuaternion& a, const aiQuaternion& b, float t) {
+                    aiQuaternion result;
+                    aiQuaternion::Interpolate(result, a, b, t);
+                    return result;
+                };
+
+                const auto& c{ *channel };
+                setJoint(
+                    pose,
+                    j,
+                    sampleKeys(c.mPositionKeys, c.mNumPositionKeys, ticks, lerp).value_or(position(pose, j)),
+                    sampleKeys(c.mRotationKeys, c.mNumRotationKeys, ticks, slerp).value_or(rotation(pose, j)),
+                    sampleKeys(c.mScalingKeys, c.mNumScalingKeys, ticks, lerp).value_or(scaling(pose, j))
+                );
+            }
+
+            // keep each rotation in the hemisphere of the previous frame, so sampling can lerp between frames
+            if (frame > 0) {
+                const auto previous{ clip.m_frames.data() + (frame - 1) * pose.data().size() };
+                for (std::size_t j{ 0 }; j < numJoints; ++j) {
+                    float dot{ 0.0f };
+                    for (auto c : { Pose::RX, Pose::RY, Pose::RZ, Pose::RW }) {
+                        dot += pose.channel(c)[j] * previous[c * numJoints + j];
+                    }
+                    if (dot < 0.0f) {
+                        for (auto c : { Pose::RX, Pose::RY, Pose::RZ, Pose::RW }) {
+                            pose.channel(c)[j] = -pose.channel(c)[j];
+                        }
+                    }
+                }
+            }
+
+            clip.m_frames.insert(clip.m_frames.end(), pose.data().begin(), pose.data().end());
+        }
+
+        return clip;
+    }
+
+    // the value of the keys at time, nothing when there is no key
+    template <typename Key, typename Interpolate>
+    static auto sampleKeys(const Key* keys, unsigned int count, double time, Interpolate&& interpolate)
+        -> std::optional<decltype(keys->mValue)>
+    {
+        if (count == 0) {
+            return {};
+        }
+
+        const auto next{ std::upper_bound(keys, keys + count, time, [](double t, const Key& key) {
+            return t < key.mTime;
+        }) };
+        if (next == keys) {
+            return keys[0].mValue;
+        }
+        if (next == keys + count) {
+            return keys[count - 1].mValue;
+        }
+
+        const auto& previous{ *(next - 1) };
+        const auto  t{ float((time - previous.mTime) / (next->mTime - previous.mTime)) };
+        return interpolate(previous.mValue, next->mValue, t);
+    }
+
+    static void setJoint(
+        Pose&               pose,
+        std::size_t         j,
+        const aiVector3D&   position,
+        const aiQuaternion& rotation,
+        const aiVector3D&   scaling
+    )
+    {
+        const auto set = [&](Pose::Channel channel, float value) { pose.channel(channel)[j] = value; };
+
+        // clang-format off
+        set(Pose::TX, position.x); set(Pose::TY, position.y); set(Pose::TZ, position.z);
+        set(Pose::RX, rotation.x); set(Pose::RY, rotation.y); set(Pose::RZ, rotation.z); set(Pose::RW, rotation.w);
+        set(Pose::SX, scaling.x);  set(Pose::SY, scaling.y);  set(Pose::SZ, scaling.z);
+        // clang-format on
+    }
+
+    static aiVector3D position(const Pose& pose, std::size_t j)
+    {
+        return { pose.channel(Pose::TX)[j], pose.channel(Pose::TY)[j], pose.channel(Pose::TZ)[j] };
+    }
+
+    static aiQuaternion rotation(const Pose& pose, std::size_t j)
+    {
+        const auto c = [&](Pose::Channel channel) { return pose.channel(channel)[j]; };
+        return { c(Pose::RW), c(Pose::RX), c(Pose::RY), c(Pose::RZ) };
+    }
+
+    static aiVector3D scaling(const Pose& pose, std::size_t j)
+    {
+        return { pose.channel(Pose::SX)[j], pose.channel(Pose::SY)[j], pose.channel(Pose::SZ)[j] };
+    }
+
+    // assimp matrices are row major
+    static glm::mat4 toGlm(const aiMatrix4x4& m)
+    {
+        return {
+            { m.a1, m.b1, m.c1, m.d1 },
+            { m.a2, m.b2, m.c2, m.d2 },
+            { m.a3, m.b3, m.c3, m.d3 },
+            { m.a4, m.b4, m.c4, m.d4 },
+        };
+    }
+
+    static void collectNodesRecursive(
+        const aiNode&               node,
+        std::int32_t                parent,
+        std::vector<const aiNode*>& nodes,
+        std::vector<std::int32_t>&  parents
+    )
+    {
+        const auto index{ std::int32_t(nodes.size()) };
+        nodes.push_back(&node);
+        parents.push_back(parent);
+        for (const auto* child : std::span{ node.mChildren, node.mNumChildren }) {
+            collectNodesRecursive(*child, index, nodes, parents);
+        }
+    }
+
+    // the strongest influences are kept when a vertex has more than Vertex::s_maxBoneInfluence
+    static void addInfluence(Vertex& vertex, std::uint16_t joint, float weight)
+    {
+        const auto weakest{ std::ranges::min_element(vertex.m_weights) - vertex.m_weights.begin() };
+        if (weight > vertex.m_weights[std::size_t(weakest)]) {
+            vertex.m_joints[std::size_t(weakest)]  = joint;
+            vertex.m_weights[std::size_t(weakest)] = weight;
+        }
+    }
+
+    static MeshData processMesh(
+        const aiMesh&                               mesh,
+        const aiScene&                              scene,
+        const std::map<std::string, std::uint16_t>& jointIndices
+    )
     {
         std::vector<Vertex>       vertices;
         std::vector<unsigned int> indices;
-        std::vector<Texture*>     textures;
+        std::vector<TextureRef>   textures;
+        Bounds                    bounds{
+            .m_min = glm::vec3{ std::numeric_limits<float>::max() },
+            .m_max = glm::vec3{ std::numeric_limits<float>::lowest() },
+        };
 
         // vertices
         vertices.reserve(mesh.mNumVertices);
@@ -119,6 +671,15 @@ private:
                 .m_bitangent = mesh.HasTangentsAndBitangents() ? v3(mesh.mBitangents[i])       : v{},
                 // clang-format on
             });
+
+            bounds.m_min = glm::min(bounds.m_min, vertices.back().m_position);
+            bounds.m_max = glm::max(bounds.m_max, vertices.back().m_position);
+        }
+
+        // bounding sphere around the center of the box, tighter than the one around the box itself
+        bounds.m_center = (bounds.m_min + bounds.m_max) * 0.5f;
+        for (const auto& vertex : vertices) {
+            bounds.m_radius = std::max(bounds.m_radius, glm::distance(vertex.m_position, bounds.m_center));
         }
 
         // indices
@@ -130,60 +691,106 @@ private:
             }
         }
 
+        // skin, the weights of each vertex renormalized over the influences it kept
+        const bool skinned{ mesh.HasBones() && !jointIndices.empty() };
+        if (skinned) {
+            for (const auto* bone : std::span{ mesh.mBones, mesh.mNumBones }) {
+                const auto found{ jointIndices.find(bone->mName.C_Str()) };
+                if (found == jointIndices.end()) {
+                    continue;
+                }
+                for (const auto& [vertexId, weight] : std::span{ bone->mWeights, bone->mNumWeights }) {
+                    addInfluence(vertices[vertexId], found->second, weight);
+                }
+            }
+            for (auto& vertex : vertices) {
+                const auto& w{ vertex.m_weights };
+                const float sum{ w[0] + w[1] + w[2] + w[3] };
+                for (auto& weight : vertex.m_weights) {
+                    weight = sum > 0.0f ? weight / sum : 0.0f;
+                }
+            }
+        }
+
+        const VertexAttributes attributes{
+            .m_normals   = mesh.HasNormals(),
+            .m_texCoords = mesh.HasTextureCoords(0),
+            .m_tangents  = mesh.HasTangentsAndBitangents(),
+            .m_skin      = skinned,
+        };
+
         // textures (materials)
         // for now, we only use on material only
         const aiMaterial& material{ *scene.mMaterials[mesh.mMaterialIndex] };    // guaranteed at least one material if AI_SCENE_FLAGS_INCOMPLETE is not set
-        gl::GLint         overallTextureCount{ 0 };                              // will be used as texture unit index
 
-        const auto loadTexture = [&material, &textures, &overallTextureCount, this](aiTextureType type) {
+        for (const auto& [type, _] : s_textureTypeToName) {
             std::size_t textureCount{ material.GetTextureCount(type) };
 
             for (std::size_t i{ 0 }; i < textureCount; ++i) {
                 aiString path;
                 material.GetTexture(type, (unsigned int)i, &path);
+                textures.push_back({ .m_type = (std::uint32_t)type, .m_index = (std::uint32_t)i, .m_path = path.C_Str() });
+            }
+        }
 
-                auto texturePath{ m_filePath.parent_path() / path.C_Str() };
-                if (auto found{ s_loadedTextures.find(texturePath) }; found != s_loadedTextures.end()) {
-                    // TODO: add a check on the texture uniform name (thus texture type), it may be different
-                    textures.push_back(&found->second);    // save pointer to loaded texture
-                    continue;
-                }
-
-                /*
-                    assimp allow up to 8 texture
-
-                    we assume that each diffuse texture is named texture_diffuseN and each specular
-                    texture should be named texture_specularN where N is any number ranging from 1
-                    to the max number of texture samplers allowed.
-
-                    naming candidate: texture_diffuseN
-                                      material.texture_diffuseN
-                                      materials[N].texture_diffuse
-
-                    > I chose 'u_texture_diffuse_N' N ranging from 0 to max texture samplers allowed
-                */
+        return { std::move(vertices), std::move(indices), std::move(textures), bounds, attributes, {} };
+    }
 
-                auto name{ std::format("{}_{}", s_textureTypeToName.at(type), i) };    // e.g. "texture_diffuse_0"; yes, it starts with 0
-                auto unitNum{ overallTextureCount };
-                auto maybeTexture{ ImageTexture::from(texturePath, name, unitNum) };
-                if (!maybeTexture.has_value()) {
-                    std::cerr << std::format("ERROR: [Texture] Failed to load texture at {}\n", path.C_Str());
-                    continue;
-                }
-                std::cout << std::format("INFO: [Model] texture '{}' loaded\n", texturePath.filename().c_str());
+    // the first texture of that type, only one diffuse and one specular texture per mesh go into a batch
+    static std::optional<std::filesystem::path> findTexture(
+        const std::vector<TextureRef>& textureRefs,
+        aiTextureType                  type,
+        const std::filesystem::path&   modelDir
+    )
+    {
+        for (const auto& [refType, index, path] : textureRefs) {
+            if (refType == std::uint32_t(type) && index == 0) {
+                return modelDir / path;
+            }
+        }
+        return {};
+    }
 
-                auto loaded{ s_loadedTextures.emplace(texturePath, std::move(maybeTexture.value())) };
-                textures.push_back(&loaded.first->second);    // save pointer to loaded texture
-                overallTextureCount++;
+    static std::vector<MeshTexture> loadTextures(
+        const std::vector<TextureRef>& textureRefs,
+        const std::filesystem::path&   modelDir
+    )
+    {
+        std::vector<MeshTexture> textures;
+        gl::GLint                overallTextureCount{ 0 };    // will be used as texture unit index
+
+        for (const auto& [type, i, path] : textureRefs) {
+            auto texturePath{ modelDir / path };
+
+            /*
+                assimp allow up to 8 texture
+
+                we assume that each diffuse texture is named texture_diffuseN and each specular
+                texture should be named texture_specularN where N is any number ranging from 1
+                to the max number of texture samplers allowed.
+
+                naming candidate: texture_diffuseN
+                                  material.texture_diffuseN
+                                  materials[N].texture_diffuse
+
+                > I chose 'u_texture_diffuse_N' N ranging from 0 to max texture samplers allowed
+            */
+
+            // the texture itself is shared (through the cache) while the name and unit are per mesh, so the
+            // same image can be used as a different texture type by different meshes
+            auto name{ std::format("{}_{}", s_textureTypeToName.at(aiTextureType(type)), i) };    // e.g. "texture_diffuse_0"; yes, it starts with 0
+            auto unitNum{ overallTextureCount };
+            auto maybeTexture{ TextureCache::instance().load(texturePath) };
+            if (!maybeTexture.has_value()) {
+                std::cerr << std::format("ERROR: [Texture] Failed to load texture at {}\n", path);
+                continue;
             }
-        };
 
-        // load all textures
-        for (const auto& [type, _] : s_textureTypeToName) {
-            loadTexture(type);
+            textures.push_back({ std::move(*maybeTexture), std::move(name), unitNum });
+            overallTextureCount++;
         }
 
-        return { std::move(vertices), std::move(indices), std::move(textures) };
+        return textures;
     }
 };
 
@@ -0,0 +1,50 @@
+#version 330 core
+
+// the vertices of every mesh in a GeometryBatch, quantized the same way as for shader.vert
+layout(location = 0) in vec3 a_pos;
+layout(location = 1) in vec2 a_normal;
+layout(location = 2) in vec2 a_texCoords;
+layout(location = 5) in uint a_drawId;    // row of the draw table, see GeometryBatch
+
+out vec3 io_fragPos;
+out vec3 io_normal;
+out vec2 io_texCoords;
+
+// where the textures of the mesh are in u_materials
+flat out vec2 io_layers;          // x: diffuse, y: specular; -1 when the mesh has none
+flat out vec4 io_diffuseRect;     // xy: offset, zw: scale
+flat out vec4 io_specularRect;
+
+uniform mat4 u_model;
+uniform mat4 u_view;
+uniform mat4 u_projection;
+
+uniform samplerBuffer u_drawTable;
+
+vec3 octDecode(vec2 e)
+{
+    vec3  n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    int  row            = int(a_drawId) * 5;
+    vec4 positionScale  = texelFetch(u_drawTable, row);        // w: diffuse layer
+    vec4 positionOffset = texelFetch(u_drawTable, row + 1);    // w: specular layer
+    vec4 texCoordsRange = texelFetch(u_drawTable, row + 2);    // xy: scale, zw: offset
+
+    vec3 pos    = a_pos * positionScale.xyz + positionOffset.xyz;
+    vec3 normal = octDecode(a_normal);
+
+    gl_Position  = u_projection * u_view * u_model * vec4(pos, 1.0);
+    io_fragPos   = vec3(u_model * vec4(pos, 1.0));
+    io_normal    = mat3(transpose(inverse(u_model))) * normal;
+    io_texCoords = a_texCoords * texCoordsRange.xy + texCoordsRange.zw;
+
+    io_layers       = vec2(positionScale.w, positionOffset.w);
+    io_diffuseRect  = texelFetch(u_drawTable, row + 3);
+    io_specularRect = texelFetch(u_drawTable, row + 4);
+}
@@ -1,8 +1,11 @@
 #version 330 core
 
-layout(location = 0) in vec3 a_pos;
-layout(location = 1) in vec3 a_normal;
-layout(location = 2) in vec2 a_texCoords;
+// the mesh vertices are quantized, see VertexFormat in mesh.hpp
+layout(location = 0) in vec3 a_pos;          // snorm16 relative to the mesh bounds, or half/float
+layout(location = 1) in vec2 a_normal;       // octahedral
+layout(location = 2) in vec2 a_texCoords;    // unorm16 relative to the uv range
+layout(location = 4) in uvec4 a_joints;
+layout(location = 6) in vec4 a_weights;
 
 out vec3 io_fragPos;
 out vec3 io_normal;
@@ -12,11 +15,52 @@ uniform mat4 u_model;
 uniform mat4 u_view;
 uniform mat4 u_projection;
 
+uniform vec3 u_positionScale;
+uniform vec3 u_positionOffset;
+uniform vec2 u_texCoordsScale;
+uniform vec2 u_texCoordsOffset;
+
+// skinning, see SkinningPalette in skinning.hpp
+uniform bool          u_skinned;
+uniform samplerBuffer u_palette;
+uniform int           u_paletteOffset;    // first matrix of the palette of this instance
+
+vec3 octDecode(vec2 e)
+{
+    vec3  n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+mat4 paletteMatrix(uint joint)
+{
+    int texel = (u_paletteOffset + int(joint)) * 4;
+    return mat4(
+        texelFetch(u_palette, texel),
+        texelFetch(u_palette, texel + 1),
+        texelFetch(u_palette, texel + 2),
+        texelFetch(u_palette, texel + 3)
+    );
+}
+
 void main()
 {
-    gl_Position = u_projection * u_view * u_model * vec4(a_pos, 1.0);
-    io_fragPos  = vec3(u_model * vec4(a_pos, 1.0));
-    // io_normal   = a_normal;
-    io_normal    = mat3(transpose(inverse(u_model))) * a_normal;
-    io_texCoords = a_texCoords;
+    vec3 pos    = a_pos * u_positionScale + u_positionOffset;
+    vec3 normal = octDecode(a_normal);
+
+    if (u_skinned) {
+        mat4 skin = paletteMatrix(a_joints.x) * a_weights.x
+                  + paletteMatrix(a_joints.y) * a_weights.y
+                  + paletteMatrix(a_joints.z) * a_weights.z
+                  + paletteMatrix(a_joints.w) * a_weights.w;
+        pos    = vec3(skin * vec4(pos, 1.0));
+        normal = normalize(mat3(skin) * normal);
+    }
+
+    gl_Position = u_projection * u_view * u_model * vec4(pos, 1.0);
+    io_fragPos  = vec3(u_model * vec4(pos, 1.0));
+    // io_normal   = normal;
+    io_normal    = mat3(transpose(inverse(u_model))) * normal;
+    io_texCoords = a_texCoords * u_texCoordsScale + u_texCoordsOffset;
 }
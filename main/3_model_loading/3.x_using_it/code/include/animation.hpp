@@ -0,0 +1,244 @@
+#ifndef ANIMATION_HPP_M5XR2KQB
+#define ANIMATION_HPP_M5XR2KQB
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "parallel_for.hpp"
+
+/*
+ * Local transforms of every joint of a skeleton, as a structure of arrays: one array of m_numJoints floats per
+ * component (translation xyz, rotation xyzw, scale xyz). Sampling and blending are then the same few operations
+ * over long runs of floats, which the compiler turns into vector code.
+ */
+class Pose
+{
+public:
+    // clang-format off
+    enum Channel : std::size_t
+    {
+        TX, TY, TZ,
+        RX, RY, RZ, RW,
+        SX, SY, SZ,
+        NUM_CHANNELS,
+    };
+    // clang-format on
+
+private:
+    std::size_t        m_numJoints{ 0 };
+    std::vector<float> m_data;
+
+public:
+    Pose() = default;
+
+    explicit Pose(std::size_t numJoints)
+        : m_numJoints{ numJoints }
+        , m_data(numJoints * NUM_CHANNELS)
+    {
+    }
+
+    std::size_t getNumJoints() const { return m_numJoints; }
+
+    std::span<float>       data() { return m_data; }
+    std::span<const float> data() const { return m_data; }
+
+    std::span<float>       channel(Channel c) { return data().subspan(c * m_numJoints, m_numJoints); }
+    std::span<const float> channel(Channel c) const { return data().subspan(c * m_numJoints, m_numJoints); }
+};
+
+struct Skeleton
+{
+    std::vector<std::int32_t> m_parents;        // -1 for a root; a parent always comes before its children
+    std::vector<glm::mat4>    m_inverseBind;    // mesh space to joint space (identity for joints no vertex uses)
+    std::vector<float>        m_bindPose;       // Pose layout, for the joints a clip doesn't animate
+    glm::mat4                 m_globalInverse{ 1.0f };    // undoes the transform of the root node
+
+    std::size_t getNumJoints() const { return m_parents.size(); }
+};
+
+// a clip resampled at import to a fixed rate: every joint has a key on every frame, so a frame is a whole Pose
+struct AnimationClip
+{
+    std::string        m_name;
+    float              m_frameRate{ 30.0f };
+    std::uint32_t      m_numFrames{ 1 };    // the last one is at the end of the clip
+    std::vector<float> m_frames;            // m_numFrames poses in Pose layout, one after the other
+
+    float getDuration() const { return float(m_numFrames - 1) / m_frameRate; }
+
+    std::span<const float> frame(std::size_t index) const
+    {
+        const auto frameSize{ m_frames.size() / m_numFrames };
+        return std::span{ m_frames }.subspan(index * frameSize, frameSize);
+    }
+};
+
+// what a model brings for skinning, no skeleton for a static model
+struct AnimationData
+{
+    std::optional<Skeleton>    m_skeleton;
+    std::vector<AnimationClip> m_clips;
+};
+
+// what one animated instance plays; m_blendWeight crossfades from m_clip to m_blendClip
+struct AnimationState
+{
+    std::size_t m_clip{ 0 };
+    float       m_time{ 0.0f };
+    std::size_t m_blendClip{ 0 };
+    float       m_blendTime{ 0.0f };
+    float       m_blendWeight{ 0.0f };
+};
+
+class Animation
+{
+public:
+    Animation() = delete;
+
+    // the pose of the clip at time (seconds), looping
+    static void sample(const AnimationClip& clip, float time, Pose& out)
+    {
+        const float duration{ clip.getDuration() };
+        const float wrapped{ duration > 0.0f ? time - std::floor(time / duration) * duration : 0.0f };
+        const float position{ wrapped * clip.m_frameRate };
+
+        const auto first{ std::min(static_cast<std::size_t>(position), std::size_t{ clip.m_numFrames } - 1) };
+        const auto second{ std::min(first + 1, std::size_t{ clip.m_numFrames } - 1) };
+        const auto t{ position - float(first) };
+
+        // consecutive frames are in the same quaternion hemisphere (see Model), the rotations lerp as they are
+        const auto a{ clip.frame(first) };
+        const auto b{ clip.frame(second) };
+        auto       result{ out.data() };
+        for (std::size_t i{ 0 }; i < result.size(); ++i) {
+            result[i] = a[i] + (b[i] - a[i]) * t;
+        }
+        normalizeRotations(out);
+    }
+
+    // out = lerp(a, b, weight) with the rotations taking the shortest path; out may be a or b
+    static void blend(const Pose& a, const Pose& b, float weight, Pose& out)
+    {
+        for (auto c : { Pose::TX, Pose::TY, Pose::TZ, Pose::SX, Pose::SY, Pose::SZ }) {
+            lerp(a.channel(c), b.channel(c), weight, out.channel(c));
+        }
+
+        const auto [ax, ay, az, aw]{ rotationChannels(a) };
+        const auto [bx, by, bz, bw]{ rotationChannels(b) };
+        auto [ox, oy, oz, ow]{ rotationChannels(out) };
+        for (std::size_t j{ 0 }; j < a.getNumJoints(); ++j) {
+            const float dot{ ax[j] * bx[j] + ay[j] * by[j] + az[j] * bz[j] + aw[j] * bw[j] };
+            const float wb{ dot < 0.0f ? -weight : weight };
+            const float wa{ 1.0f - weight };
+
+            ox[j] = ax[j] * wa + bx[j] * wb;
+            oy[j] = ay[j] * wa + by[j] * wb;
+            oz[j] = az[j] * wa + bz[j] * wb;
+            ow[j] = aw[j] * wa + bw[j] * wb;
+        }
+        normalizeRotations(out);
+    }
+
+    // skinning matrices (mesh space to posed mesh space) of every joint
+    static void computePalette(const Skeleton& skeleton, const Pose& pose, std::span<glm::mat4> out)
+    {
+        const auto numJoints{ skeleton.getNumJoints() };
+
+        // world transforms first, a parent is always done before its children
+        for (std::size_t j{ 0 }; j < numJoints; ++j) {
+            const auto local{ localMatrix(pose, j) };
+            const auto parent{ skeleton.m_parents[j] };
+            out[j] = parent < 0 ? local : out[std::size_t(parent)] * local;
+        }
+        for (std::size_t j{ 0 }; j < numJoints; ++j) {
+            out[j] = skeleton.m_globalInverse * out[j] * skeleton.m_inverseBind[j];
+        }
+    }
+
+    // the palettes of many instances of one skeleton, getNumJoints() matrices per instance one after the other;
+    // instances are spread over the cores in chunks so each chunk reuses its scratch poses
+    static void evaluate(
+        const Skeleton&                 skeleton,
+        std::span<const AnimationClip>  clips,
+        std::span<const AnimationState> states,
+        std::span<glm::mat4>            palettes
+    )
+    {
+        constexpr std::size_t chunkSize{ 16 };
+
+        const auto numJoints{ skeleton.getNumJoints() };
+        const auto numChunks{ (states.size() + chunkSize - 1) / chunkSize };
+
+        parallelFor(numChunks, [&](std::size_t chunk) {
+            Pose pose{ numJoints };
+            Pose other{ numJoints };
+
+            const auto end{ std::min(states.size(), (chunk + 1) * chunkSize) };
+            for (auto i{ chunk * chunkSize }; i < end; ++i) {
+                const auto& state{ states[i] };
+                sample(clips[state.m_clip], state.m_time, pose);
+                if (state.m_blendWeight > 0.0f) {
+                    sample(clips[state.m_blendClip], state.m_blendTime, other);
+                    blend(pose, other, state.m_blendWeight, pose);
+                }
+                computePalette(skeleton, pose, palettes.subspan(i * numJoints, numJoints));
+            }
+        });
+    }
+
+private:
+    static std::array<std::span<const float>, 4> rotationChannels(const Pose& pose)
+    {
+        return { pose.channel(Pose::RX), pose.channel(Pose::RY), pose.channel(Pose::RZ), pose.channel(Pose::RW) };
+    }
+
+    static std::array<std::span<float>, 4> rotationChannels(Pose& pose)
+    {
+        return { pose.channel(Pose::RX), pose.channel(Pose::RY), pose.channel(Pose::RZ), pose.channel(Pose::RW) };
+    }
+
+    static void lerp(std::span<const float> a, std::span<const float> b, float t, std::span<float> out)
+    {
+        for (std::size_t i{ 0 }; i < out.size(); ++i) {
+            out[i] = a[i] + (b[i] - a[i]) * t;
+        }
+    }
+
+    static void normalizeRotations(Pose& pose)
+    {
+        auto [x, y, z, w]{ rotationChannels(pose) };
+        for (std::size_t j{ 0 }; j < pose.getNumJoints(); ++j) {
+            const float length{ std::sqrt(x[j] * x[j] + y[j] * y[j] + z[j] * z[j] + w[j] * w[j]) };
+            const float inverse{ length > 0.0f ? 1.0f / length : 0.0f };
+            x[j] *= inverse;
+            y[j] *= inverse;
+            z[j] *= inverse;
+            w[j] *= inverse;
+        }
+    }
+
+    static glm::mat4 localMatrix(const Pose& pose, std::size_t j)
+    {
+        const auto c = [&](Pose::Channel channel) { return pose.channel(channel)[j]; };
+
+        const glm::quat rotation{ c(Pose::RW), c(Pose::RX), c(Pose::RY), c(Pose::RZ) };
+        glm::mat4       matrix{ glm::mat3_cast(rotation) };
+        matrix[0] *= c(Pose::SX);
+        matrix[1] *= c(Pose::SY);
+        matrix[2] *= c(Pose::SZ);
+        matrix[3]  = { c(Pose::TX), c(Pose::TY), c(Pose::TZ), 1.0f };
+        return matrix;
+    }
+};
+
+#endif /* end of include guard: ANIMATION_HPP_M5XR2KQB */
@@ -5,8 +5,10 @@
 #include <iostream>
 #include <map>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #define GLFW_INCLUDE_NONE
@@ -18,10 +20,12 @@
 
 #include "scene.hpp"
 #include "imgui_layer.hpp"
+#include "skinning.hpp"
 
 static constexpr int         DEFAULT_WINDOW_WIDTH  = 800;
 static constexpr int         DEFAULT_WINDOW_HEIGHT = 600;
 static constexpr std::string DEFAULT_WINDOW_NAME   = "LearnOpenGL";
+static constexpr std::string INPUT_RECORDING_PATH  = "input_recording.inpl";    // F5: record, F6: replay
 
 class App
 {
@@ -45,13 +49,11 @@ public:
 
         if (s_instance) { return; }
 
-        if (!glfwInit()) {
+        if (!window::WindowManager::initGlfw()) {
             std::cerr << "Failed to initialize GLFW\n";
             return;
         }
 
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
         if (!window::WindowManager::createInstance()) {
@@ -59,9 +61,27 @@ public:
             throw std::runtime_error{ "Failed to create WindowManager instance" };
         }
 
+        // nobody watches a headless run animate, so at least check the skinning math against a known pose
+        if (window::WindowManager::getBackend() == window::Backend::HEADLESS) {
+            if (!CpuSkinning::check()) {
+                throw std::runtime_error{ "Skinning doesn't match the known pose" };
+            }
+            std::cout << "INFO: [App] Skinning matches the known pose\n";
+        }
+
         auto& windowManager{ window::WindowManager::getInstance()->get() };
 
-        auto window{ windowManager.createWindow(DEFAULT_WINDOW_NAME, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT) };
+        // 4.3 for the multi-draw indirect path of GeometryBatch, 3.3 is enough for everything else; the hints stay set
+        // for the shared contexts created later
+        std::optional<window::Window> window;
+        for (auto [major, minor] : { std::pair{ 4, 3 }, std::pair{ 3, 3 } }) {
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+            window = windowManager.createWindow(DEFAULT_WINDOW_NAME, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT);
+            if (window.has_value()) {
+                break;
+            }
+        }
         if (!window.has_value()) {
             throw std::runtime_error{ "Failed to create Window instance" };
         }
@@ -110,11 +130,26 @@ private:
         , m_imgui{ m_window, m_scene }
     {
         m_scene.readDeviceInformation();
+        m_window.setBackgroundFrameLimit(15.0);    // no need to draw at full rate when nobody is looking
 
         // something like debug tools in minecraft
         m_window.addKeyEventHandler(GLFW_KEY_F3, 0, window::Window::KeyActionType::CALLBACK, [this](window::Window&) {
             m_imguiEnabled = !m_imguiEnabled;
         });
+
+        // record a session, then replay it for comparable performance runs
+        m_window.addKeyEventHandler(GLFW_KEY_F5, 0, window::Window::KeyActionType::CALLBACK, [](window::Window& win) {
+            if (win.isRecording()) {
+                win.stopRecording();
+            } else {
+                win.startRecording(INPUT_RECORDING_PATH);
+            }
+        });
+        m_window.addKeyEventHandler(GLFW_KEY_F6, 0, window::Window::KeyActionType::CALLBACK, [](window::Window& win) {
+            if (!win.isRecording() && !win.isReplaying()) {
+                win.startReplay(INPUT_RECORDING_PATH);
+            }
+        });
     }
 
 private:
@@ -137,10 +172,10 @@ private:
 
         auto& windowManager{ window::WindowManager::getInstance()->get() };
         while (windowManager.hasWindowOpened() && m_running) {
-            PRETTY_FUNCTION_TIME_LOG_WITH_ARG("pollEvents");
+            PRETTY_FUNCTION_TIME_LOG_WITH_ARG("waitEvents");
 
             using window::operator""_fps;
-            windowManager.pollEvents(120_fps);
+            windowManager.waitEventsTimeout(120_fps);
         }
     }
 };
@@ -0,0 +1,371 @@
+#ifndef ASYNC_MODEL_LOADER_HPP_Q8MV2TDC
+#define ASYNC_MODEL_LOADER_HPP_Q8MV2TDC
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+
+#include "common/old/window.hpp"
+#include "common/old/window_manager.hpp"
+
+#include "animation.hpp"
+#include "mesh_cache.hpp"
+#include "model.hpp"
+
+/*
+ * A model that fills up while AsyncModelLoader works on it. Each mesh is handed over with a fence the loader context
+ * put right after its upload; update() only moves a mesh into the model once that fence has signaled, so the render
+ * context never draws from a buffer (or samples a texture) that is still being written.
+ *
+ * Meshes also going into a GeometryBatch arrive converted as well, the batch belongs to the rendering context and
+ * update() adds them to it; its material array is packed by the loader once all of them are sent and swapped in when
+ * its own fence has signaled, until then the batch draws them untextured.
+ */
+class AsyncModel
+{
+public:
+    enum class Stage
+    {
+        IMPORTING,    // reading the mesh cache or running the importer
+        UPLOADING,    // handing the meshes over one by one
+        DONE,         // everything handed over, the last meshes show up at the next update()
+        FAILED,
+    };
+
+    struct Progress
+    {
+        Stage       m_stage{ Stage::IMPORTING };
+        std::size_t m_loaded{ 0 };
+        std::size_t m_total{ 0 };    // 0 until the import is done
+    };
+
+    // called on the loader thread
+    using ProgressCallback = std::function<void(const Progress&)>;
+
+private:
+    friend class AsyncModelLoader;
+
+    struct Uploaded
+    {
+        Mesh       m_mesh;
+        gl::GLsync m_fence;
+    };
+
+    struct Materials
+    {
+        std::optional<TextureArray> m_array;
+        gl::GLsync                  m_fence;
+    };
+
+    Model m_model;
+
+    mutable std::mutex           m_mutex;
+    std::deque<Uploaded>         m_uploaded;     // in mesh order
+    std::vector<MeshData>        m_converted;    // batched models only
+    std::optional<Materials>     m_materials;    // batched models only, after the last converted mesh
+    std::optional<AnimationData> m_animation;
+    Progress                     m_progress;
+
+public:
+    AsyncModel(std::filesystem::path filePath, GeometryBatch* batch)
+        : m_model{ std::move(filePath), batch }
+    {
+    }
+
+    // moves the meshes whose upload is complete into the model, without waiting on the ones that are not; call it
+    // on the rendering thread before drawing
+    void update()
+    {
+        using namespace gl;
+
+        std::vector<Mesh>                          ready;
+        std::vector<MeshData>                      converted;
+        std::optional<std::optional<TextureArray>> materials;
+        std::optional<AnimationData>               animation;
+        {
+            std::scoped_lock lock{ m_mutex };
+            animation.swap(m_animation);
+
+            while (!m_uploaded.empty()) {
+                auto& [mesh, fence]{ m_uploaded.front() };
+
+                const auto status{ glClientWaitSync(fence, GL_NONE_BIT, 0) };
+                if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                    break;    // meshes are added in order, the next ones wait for this one
+                }
+                glDeleteSync(fence);
+
+                ready.push_back(std::move(mesh));
+                m_uploaded.pop_front();
+            }
+            converted.swap(m_converted);
+
+            if (m_materials) {
+                const auto status{ glClientWaitSync(m_materials->m_fence, GL_NONE_BIT, 0) };
+                if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+                    glDeleteSync(m_materials->m_fence);
+                    materials.emplace(std::move(m_materials->m_array));
+                    m_materials.reset();
+                }
+            }
+        }
+
+        if (animation) {
+            m_model.setAnimation(std::move(*animation));
+        }
+        if (!ready.empty()) {
+            m_model.addMeshes(std::move(ready));
+        }
+        if (!converted.empty()) {
+            m_model.addToBatch(converted);
+        }
+        if (materials) {
+            m_model.setBatchMaterials(std::move(*materials));
+        }
+    }
+
+    // the meshes added so far
+    const Model& get() const { return m_model; }
+
+    Progress getProgress() const
+    {
+        std::scoped_lock lock{ m_mutex };
+        return m_progress;
+    }
+
+private:
+    void pushAnimation(AnimationData&& animation)
+    {
+        std::scoped_lock lock{ m_mutex };
+        m_animation = std::move(animation);
+    }
+
+    void pushUploaded(Mesh&& mesh, gl::GLsync fence)
+    {
+        std::scoped_lock lock{ m_mutex };
+        m_uploaded.push_back({ std::move(mesh), fence });
+    }
+
+    void pushConverted(MeshData&& mesh)
+    {
+        std::scoped_lock lock{ m_mutex };
+        m_converted.push_back(std::move(mesh));
+    }
+
+    void pushMaterials(std::optional<TextureArray>&& array, gl::GLsync fence)
+    {
+        std::scoped_lock lock{ m_mutex };
+        if (m_materials) {
+            glDeleteSync(m_materials->m_fence);    // never taken, superseded
+        }
+        m_materials.reset();
+        m_materials.emplace(std::move(array), fence);
+    }
+
+    void setProgress(const Progress& progress)
+    {
+        std::scoped_lock lock{ m_mutex };
+        m_progress = progress;
+    }
+};
+
+/*
+ * Loads models in the background. The import (and its parallel mesh conversion, see Model::import) runs on the
+ * loader thread, which also uploads each mesh and its textures through a hidden context sharing objects with the
+ * window, then publishes it to the AsyncModel. Requests are served one after the other.
+ *
+ * The material array of a batch is repacked with the images of every model loaded into it so far, so decoding and
+ * packing them stays off the rendering thread.
+ */
+class AsyncModelLoader
+{
+private:
+    struct Request
+    {
+        std::shared_ptr<AsyncModel>  m_model;
+        std::filesystem::path        m_filePath;
+        ModelLoadOptions             m_options;
+        AsyncModel::ProgressCallback m_callback;
+    };
+
+    using BatchImages = std::map<const GeometryBatch*, std::vector<std::filesystem::path>>;
+
+    window::Window              m_context;        // hidden, shares with the window
+    BatchImages                 m_batchImages;    // loader thread only
+    std::mutex                  m_mutex;
+    std::condition_variable_any m_condition;
+    std::deque<Request>         m_requests;
+    std::jthread                m_thread;         // last, it uses everything above
+
+public:
+    // call it on the main thread (a window is created), before the context of window is made current on another
+    // thread: a context can't be shared with while it is current elsewhere
+    explicit AsyncModelLoader(const window::Window& window) noexcept(false)
+        : m_context{ createContext(window) }
+        , m_thread{ [this](std::stop_token stopToken) { run(stopToken); } }
+    {
+    }
+
+    AsyncModelLoader(const AsyncModelLoader&)            = delete;
+    AsyncModelLoader& operator=(const AsyncModelLoader&) = delete;
+    AsyncModelLoader(AsyncModelLoader&&)                 = delete;
+    AsyncModelLoader& operator=(AsyncModelLoader&&)      = delete;
+
+    // returns right away with an empty model; call its update() every frame to see the meshes arrive
+    std::shared_ptr<AsyncModel> load(
+        std::filesystem::path        filePath,
+        const ModelLoadOptions&      options  = {},
+        AsyncModel::ProgressCallback callback = {}
+    )
+    {
+        auto model{ std::make_shared<AsyncModel>(filePath, options.m_batch) };
+        {
+            std::scoped_lock lock{ m_mutex };
+            m_requests.push_back({ model, std::move(filePath), options, std::move(callback) });
+        }
+        m_condition.notify_one();
+        return model;
+    }
+
+private:
+    static window::Window createContext(const window::Window& window)
+    {
+        auto& windowManager{ window::WindowManager::getInstance()->get() };
+        auto  maybeContext{ windowManager.createSharedContext(window) };
+        if (!maybeContext) {
+            throw std::runtime_error{ "Failed to create the model loader context" };
+        }
+        return std::move(*maybeContext);
+    }
+
+    void run(std::stop_token stopToken)
+    {
+        m_context.useHere();
+
+        while (true) {
+            Request request;
+            {
+                std::unique_lock lock{ m_mutex };
+                if (!m_condition.wait(lock, stopToken, [this] { return !m_requests.empty(); })) {
+                    break;    // stop requested
+                }
+                request = std::move(m_requests.front());
+                m_requests.pop_front();
+            }
+            process(request, stopToken);
+        }
+
+        m_context.unUse();
+    }
+
+    void process(Request& request, const std::stop_token& stopToken)
+    {
+        using namespace gl;
+
+        auto& [model, filePath, options, callback]{ request };
+
+        AsyncModel::Progress progress{};
+        const auto           report = [&] {
+            model->setProgress(progress);
+            if (callback) {
+                callback(progress);
+            }
+        };
+        report();
+
+        const bool imported{ Model::import(filePath, options, [&](auto&& meshes, const AnimationData& animation) {
+            progress = { .m_stage = AsyncModel::Stage::UPLOADING, .m_loaded = 0, .m_total = meshes.size() };
+            report();
+
+            if (animation.m_skeleton) {
+                model->pushAnimation(AnimationData{ animation });
+            }
+
+            const auto                         modelDir{ filePath.parent_path() };
+            std::vector<std::filesystem::path> images;
+            if (options.m_batch) {
+                images = Model::batchImagesOf(meshes, modelDir);    // before the meshes are taken
+            }
+
+            for (auto& mesh : meshes) {
+                if (stopToken.stop_requested()) {
+                    return;
+                }
+
+                auto uploaded{ Model::upload(mesh, modelDir, options.m_positionEncoding) };
+                auto fence{ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, GL_NONE_BIT) };
+                glFlush();    // the fence must reach the gpu before another context waits on it
+                model->pushUploaded(std::move(uploaded), fence);
+
+                if (options.m_batch) {
+                    model->pushConverted(toMeshData(mesh));    // last, it may take the mesh
+                }
+
+                ++progress.m_loaded;
+                report();
+            }
+
+            if (options.m_batch) {
+                packMaterials(*model, *options.m_batch, std::move(images));
+            }
+        }) };
+
+        if (!imported) {
+            std::cerr << std::format("ERROR: [AsyncModelLoader] Failed to load model from {}\n", filePath.string());
+        }
+        progress.m_stage = imported ? AsyncModel::Stage::DONE : AsyncModel::Stage::FAILED;
+        report();
+    }
+
+    void packMaterials(AsyncModel& model, const GeometryBatch& batch, std::vector<std::filesystem::path>&& images)
+    {
+        using namespace gl;
+
+        auto& packed{ m_batchImages[&batch] };
+        for (auto& image : images) {
+            if (std::ranges::find(packed, image) == packed.end()) {
+                packed.push_back(std::move(image));
+            }
+        }
+        if (packed.empty()) {
+            return;
+        }
+
+        auto array{ GeometryBatch::packMaterials(packed) };
+        auto fence{ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, GL_NONE_BIT) };
+        glFlush();
+        model.pushMaterials(std::move(array), fence);
+    }
+
+    // meshes from the importer are moved, the ones mapped from the mesh cache are copied
+    static MeshData toMeshData(MeshData& mesh) { return std::move(mesh); }
+
+    static MeshData toMeshData(const MeshCache::MeshView& mesh)
+    {
+        return {
+            .m_vertices   = { mesh.m_vertices.begin(), mesh.m_vertices.end() },
+            .m_indices    = { mesh.m_indices.begin(), mesh.m_indices.end() },
+            .m_textures   = mesh.m_textures,
+            .m_bounds     = mesh.m_bounds,
+            .m_attributes = mesh.m_attributes,
+            .m_lods       = { mesh.m_lods.begin(), mesh.m_lods.end() },
+        };
+    }
+};
+
+#endif /* end of include guard: ASYNC_MODEL_LOADER_HPP_Q8MV2TDC */
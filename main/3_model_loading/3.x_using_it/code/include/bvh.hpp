@@ -0,0 +1,212 @@
+#ifndef BVH_HPP_K2WN7RXE
+#define BVH_HPP_K2WN7RXE
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+#include "mesh.hpp"
+
+// how many items a frustum test kept and how many it threw away
+struct CullStats
+{
+    std::size_t m_visible{ 0 };
+    std::size_t m_culled{ 0 };
+
+    CullStats& operator+=(const CullStats& other)
+    {
+        m_visible += other.m_visible;
+        m_culled  += other.m_culled;
+        return *this;
+    }
+};
+
+/*
+ * Bounding volume hierarchy over a set of bounds (the meshes of a model, the instances of a scene), split at the
+ * median along the longest axis of the centers. It is rebuilt rather than refitted, building is cheap next to
+ * drawing what it culls.
+ *
+ * The nodes are stored depth first: the left child of a node directly follows it, the right one is at m_offset.
+ */
+class Bvh
+{
+private:
+    static inline constexpr std::size_t s_maxLeafSize{ 2 };
+    static inline constexpr std::size_t s_maxDepth{ 64 };
+
+    struct Node
+    {
+        glm::vec3     m_min;
+        glm::vec3     m_max;
+        std::uint32_t m_offset;    // leaf: first item in m_items; inner node: the right child
+        std::uint32_t m_count;     // 0 for an inner node
+    };
+
+    std::vector<Node>          m_nodes;
+    std::vector<std::uint32_t> m_items;     // indices into m_bounds, grouped by leaf
+    std::vector<Bounds>        m_bounds;
+
+public:
+    Bvh() = default;
+
+    explicit Bvh(std::span<const Bounds> bounds)
+        : m_bounds{ bounds.begin(), bounds.end() }
+    {
+        m_items.resize(bounds.size());
+        std::iota(m_items.begin(), m_items.end(), 0u);
+
+        if (!m_items.empty()) {
+            m_nodes.reserve(2 * m_items.size());
+            build(0, m_items.size(), 0);
+        }
+    }
+
+    std::size_t size() const { return m_bounds.size(); }
+
+    // the box of everything, or an empty one
+    Bounds getBounds() const
+    {
+        if (m_nodes.empty()) {
+            return {};
+        }
+        const auto& root{ m_nodes.front() };
+        return {
+            .m_min    = root.m_min,
+            .m_max    = root.m_max,
+            .m_center = (root.m_min + root.m_max) * 0.5f,
+            .m_radius = glm::length(root.m_max - root.m_min) * 0.5f,
+        };
+    }
+
+    // calls visit(index) for every item whose bounds intersect the frustum; the subtrees that are completely
+    // inside are not tested any further
+    template <std::invocable<std::size_t> Visit>
+    CullStats cull(const Frustum& frustum, Visit&& visit) const
+    {
+        CullStats stats{ .m_visible = 0, .m_culled = m_bounds.size() };
+        if (m_nodes.empty()) {
+            return stats;
+        }
+
+        struct Entry
+        {
+            std::uint32_t m_node;
+            bool          m_inside;    // the parent is already known to be inside
+        };
+        std::array<Entry, s_maxDepth * 2> stack;
+        std::size_t                       top{ 0 };
+        stack[top++] = { 0, false };
+
+        while (top > 0) {
+            const auto [index, parentInside]{ stack[--top] };
+            const auto& [min, max, offset, count]{ m_nodes[index] };
+
+            bool inside{ parentInside };
+            if (!inside) {
+                const auto containment{ frustum.classify(min, max) };
+                if (containment == Frustum::Containment::OUTSIDE) {
+                    continue;
+                }
+                inside = containment == Frustum::Containment::INSIDE;
+            }
+
+            if (count == 0) {
+                stack[top++] = { offset, inside };
+                stack[top++] = { index + 1, inside };
+                continue;
+            }
+
+            for (auto i{ offset }; i < offset + count; ++i) {
+                const auto item{ m_items[i] };
+                if (inside || frustum.isVisible(m_bounds[item])) {
+                    ++stats.m_visible;
+                    visit(std::size_t{ item });
+                }
+            }
+        }
+
+        stats.m_culled -= stats.m_visible;
+        return stats;
+    }
+
+    // box containing the bounds after the transform (Arvo 1990)
+    static Bounds transform(const Bounds& bounds, const glm::mat4& matrix)
+    {
+        const glm::vec3 center{ matrix * glm::vec4{ (bounds.m_min + bounds.m_max) * 0.5f, 1.0f } };
+        const glm::vec3 extent{ (bounds.m_max - bounds.m_min) * 0.5f };
+
+        glm::vec3 newExtent{ 0.0f };
+        for (int i{ 0 }; i < 3; ++i) {
+            newExtent += glm::abs(glm::vec3{ matrix[i] }) * extent[i];
+        }
+
+        const float scale{ std::sqrt(std::max({
+            glm::dot(glm::vec3{ matrix[0] }, glm::vec3{ matrix[0] }),
+            glm::dot(glm::vec3{ matrix[1] }, glm::vec3{ matrix[1] }),
+            glm::dot(glm::vec3{ matrix[2] }, glm::vec3{ matrix[2] }),
+        })) };
+
+        return {
+            .m_min    = center - newExtent,
+            .m_max    = center + newExtent,
+            .m_center = glm::vec3{ matrix * glm::vec4{ bounds.m_center, 1.0f } },
+            .m_radius = bounds.m_radius * scale,
+        };
+    }
+
+private:
+    void build(std::size_t begin, std::size_t end, std::size_t depth)
+    {
+        const auto index{ m_nodes.size() };
+        auto&      node{ m_nodes.emplace_back() };
+
+        glm::vec3 min{ std::numeric_limits<float>::max() };
+        glm::vec3 max{ std::numeric_limits<float>::lowest() };
+        glm::vec3 centerMin{ std::numeric_limits<float>::max() };
+        glm::vec3 centerMax{ std::numeric_limits<float>::lowest() };
+        for (auto i{ begin }; i < end; ++i) {
+            const auto& bounds{ m_bounds[m_items[i]] };
+            min       = glm::min(min, bounds.m_min);
+            max       = glm::max(max, bounds.m_max);
+            centerMin = glm::min(centerMin, center(bounds));
+            centerMax = glm::max(centerMax, center(bounds));
+        }
+        node = { .m_min = min, .m_max = max, .m_offset = std::uint32_t(begin), .m_count = std::uint32_t(end - begin) };
+
+        if (end - begin <= s_maxLeafSize || depth + 1 >= s_maxDepth) {
+            return;
+        }
+
+        const auto extent{ centerMax - centerMin };
+        const int  axis{ extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2) };
+        const auto middle{ begin + (end - begin) / 2 };
+
+        std::nth_element(
+            m_items.begin() + long(begin),
+            m_items.begin() + long(middle),
+            m_items.begin() + long(end),
+            [&](std::uint32_t a, std::uint32_t b) { return center(m_bounds[a])[axis] < center(m_bounds[b])[axis]; }
+        );
+
+        build(begin, middle, depth + 1);    // right after this node
+        const auto right{ m_nodes.size() };
+        build(middle, end, depth + 1);
+
+        m_nodes[index].m_offset = std::uint32_t(right);    // node may dangle, m_nodes grew
+        m_nodes[index].m_count  = 0;
+    }
+
+    static glm::vec3 center(const Bounds& bounds) { return (bounds.m_min + bounds.m_max) * 0.5f; }
+};
+
+#endif /* end of include guard: BVH_HPP_K2WN7RXE */
@@ -0,0 +1,90 @@
+#ifndef FRUSTUM_HPP_Z3FQ9DWA
+#define FRUSTUM_HPP_Z3FQ9DWA
+
+#include <array>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hpp"
+
+// the six planes of a view volume, the normals point inwards
+class Frustum
+{
+public:
+    enum class Containment
+    {
+        OUTSIDE,
+        INTERSECTS,
+        INSIDE,
+    };
+
+private:
+    std::array<glm::vec4, 6> m_planes;    // xyz: normal, w: distance; normalized
+
+public:
+    // planes of the clip volume of matrix (Gribb and Hartmann), in the space matrix transforms from; with
+    // projection * view * model the planes are in model space, so the model space bounds can be tested as they are
+    explicit Frustum(const glm::mat4& matrix)
+    {
+        const auto row = [&](int i) { return glm::vec4{ matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i] }; };
+
+        m_planes = {
+            row(3) + row(0),    // left
+            row(3) - row(0),    // right
+            row(3) + row(1),    // bottom
+            row(3) - row(1),    // top
+            row(3) + row(2),    // near
+            row(3) - row(2),    // far
+        };
+        for (auto& plane : m_planes) {
+            plane /= glm::length(glm::vec3{ plane });
+        }
+    }
+
+    bool intersects(const glm::vec3& center, float radius) const
+    {
+        for (const auto& plane : m_planes) {
+            if (glm::dot(glm::vec3{ plane }, center) + plane.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // the box is outside as soon as its corner furthest along a plane normal is behind that plane, and inside when
+    // even its nearest corner is in front of all of them
+    Containment classify(const glm::vec3& min, const glm::vec3& max) const
+    {
+        auto result{ Containment::INSIDE };
+        for (const auto& plane : m_planes) {
+            const glm::vec3 normal{ plane };
+            const auto      pick = [&](const glm::vec3& positive, const glm::vec3& negative) {
+                return glm::vec3{
+                    normal.x >= 0.0f ? positive.x : negative.x,
+                    normal.y >= 0.0f ? positive.y : negative.y,
+                    normal.z >= 0.0f ? positive.z : negative.z,
+                };
+            };
+            const auto furthest{ pick(max, min) };
+            const auto nearest{ pick(min, max) };
+
+            if (glm::dot(normal, furthest) + plane.w < 0.0f) {
+                return Containment::OUTSIDE;
+            }
+            if (glm::dot(normal, nearest) + plane.w < 0.0f) {
+                result = Containment::INTERSECTS;
+            }
+        }
+        return result;
+    }
+
+    // sphere first, it is cheaper and often enough to reject
+    bool isVisible(const Bounds& bounds) const
+    {
+        return intersects(bounds.m_center, bounds.m_radius)
+            && classify(bounds.m_min, bounds.m_max) != Containment::OUTSIDE;
+    }
+};
+
+#endif /* end of include guard: FRUSTUM_HPP_Z3FQ9DWA */
@@ -0,0 +1,504 @@
+#ifndef GEOMETRY_BATCH_HPP_R8MV2CXN
+#define GEOMETRY_BATCH_HPP_R8MV2CXN
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "common/old/shader.hpp"
+#include "common/old/texture_array.hpp"
+
+#include "lod_selector.hpp"
+#include "mesh.hpp"
+
+/*
+ * The meshes of one or many models merged into a single vertex buffer and a single index buffer behind one vertex
+ * array, so a whole range of meshes is submitted with one glMultiDrawElementsIndirect call.
+ *
+ * Every mesh is a draw: an indirect command pointing at one of its levels of detail, plus a row in the draw table
+ * (a texture buffer) with its dequantization and its material. The draw index reaches the vertex shader through an
+ * instanced attribute, which the baseInstance of each command offsets to the right row. The diffuse and specular
+ * textures of every mesh are packed into one texture array, so nothing is rebound between draws either. Decoding
+ * and packing them is slow, so it is left to the owner of the batch (see packMaterials and setMaterials), ideally on
+ * a loader context; until then the meshes are drawn untextured.
+ *
+ * Drawing the same meshes several times a frame (instances, each culled and at its own levels of detail) goes
+ * through the frame commands: each instance adds the commands of its visible draws as a region of its own (see
+ * addToFrame and endRegion), and the whole frame is uploaded at once, to a freshly respecified buffer, before the
+ * first region is drawn. No command is ever rewritten while a draw issued earlier may still read it.
+ *
+ * Multi-draw indirect needs GL 4.3. On an older context the commands are submitted one by one with
+ * glDrawElementsBaseVertex, with the draw index as a constant attribute value instead.
+ */
+class GeometryBatch
+{
+public:
+    // the vertex and index data are only read during add()
+    struct MeshInput
+    {
+        std::span<const Vertex>              m_vertices;
+        std::span<const unsigned int>        m_indices;
+        std::span<const MeshLod>             m_lods;
+        Bounds                               m_bounds;
+        std::optional<std::filesystem::path> m_diffuse;
+        std::optional<std::filesystem::path> m_specular;
+    };
+
+    // the draws added by one add() call, usually a model
+    struct Range
+    {
+        std::size_t m_first;
+        std::size_t m_count;
+    };
+
+    // commands of the frame added for one instance, see endRegion
+    struct Region
+    {
+        std::size_t m_first;
+        std::size_t m_count;
+    };
+
+private:
+    // the layout glMultiDrawElementsIndirect reads
+    struct DrawCommand
+    {
+        gl::GLuint m_count;
+        gl::GLuint m_instanceCount;
+        gl::GLuint m_firstIndex;
+        gl::GLint  m_baseVertex;
+        gl::GLuint m_baseInstance;    // the draw index
+    };
+
+    struct Draw
+    {
+        std::vector<MeshLod>                 m_lods;
+        Bounds                               m_bounds;
+        gl::GLuint                           m_firstIndex;    // where the mesh starts in the index buffer
+        VertexFormat::Dequantization         m_dequantization;
+        std::optional<std::filesystem::path> m_diffuse;
+        std::optional<std::filesystem::path> m_specular;
+    };
+
+    // the glsl side of the table, per draw:
+    //     0: positionScale.xyz, diffuse layer      3: diffuse uv rect
+    //     1: positionOffset.xyz, specular layer    4: specular uv rect
+    //     2: texCoordsScale.xy, texCoordsOffset.xy
+    // a layer of -1 means the mesh has no such texture
+    static inline constexpr std::size_t s_texelsPerDraw{ 5 };
+
+    static inline constexpr gl::GLuint  s_drawIdLocation{ 5 };
+    static inline constexpr gl::GLint   s_materialsUnit{ 0 };
+    static inline constexpr gl::GLint   s_drawTableUnit{ 1 };
+    static inline constexpr std::size_t s_initialBufferBytes{ 1 << 20 };
+
+    // the same format for every mesh, missing attributes are left zeroed
+    VertexFormat m_format{ { .m_normals = true, .m_texCoords = true, .m_tangents = true }, PositionEncoding::SNORM16 };
+    bool         m_multiDrawIndirect{ false };
+
+    std::vector<Draw>           m_draws;
+    std::vector<DrawCommand>    m_commands;         // every draw at its finest level of detail, uploaded by add()
+    std::vector<DrawCommand>    m_frameCommands;    // the regions of the current frame
+    std::size_t                 m_regionBegin{ 0 };
+    bool                        m_frameUploaded{ false };
+    std::optional<TextureArray> m_materials;
+
+    std::size_t m_vertexBytes{ 0 };
+    std::size_t m_vertexCapacity{ 0 };
+    std::size_t m_indexBytes{ 0 };
+    std::size_t m_indexCapacity{ 0 };
+
+    gl::GLuint m_vao{};
+    gl::GLuint m_vbo{};
+    gl::GLuint m_ebo{};
+    gl::GLuint m_drawIdBuffer{};
+    gl::GLuint m_indirectBuffer{};
+    gl::GLuint m_frameIndirectBuffer{};
+    gl::GLuint m_tableBuffer{};
+    gl::GLuint m_tableTexture{};
+
+public:
+    GeometryBatch(const GeometryBatch&)            = delete;
+    GeometryBatch& operator=(const GeometryBatch&) = delete;
+    GeometryBatch(GeometryBatch&&)                 = delete;
+    GeometryBatch& operator=(GeometryBatch&&)      = delete;
+
+    // needs a current context
+    GeometryBatch()
+    {
+        using namespace gl;
+
+        GLint major{};
+        GLint minor{};
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        m_multiDrawIndirect = major > 4 || (major == 4 && minor >= 3);
+
+        glGenVertexArrays(1, &m_vao);
+        glGenBuffers(1, &m_drawIdBuffer);
+        glGenBuffers(1, &m_indirectBuffer);
+        glGenBuffers(1, &m_frameIndirectBuffer);
+        glGenBuffers(1, &m_tableBuffer);
+        glGenTextures(1, &m_tableTexture);
+
+        std::cout << std::format(
+            "INFO: [GeometryBatch] GL {}.{}, submitting with {}\n",
+            major,
+            minor,
+            m_multiDrawIndirect ? "glMultiDrawElementsIndirect" : "glDrawElementsBaseVertex (no multi-draw indirect)"
+        );
+    }
+
+    ~GeometryBatch()
+    {
+        using namespace gl;
+
+        glDeleteVertexArrays(1, &m_vao);
+        for (auto buffer : { m_vbo, m_ebo, m_drawIdBuffer, m_indirectBuffer, m_frameIndirectBuffer, m_tableBuffer }) {
+            glDeleteBuffers(1, &buffer);
+        }
+        glDeleteTextures(1, &m_tableTexture);
+    }
+
+    bool isMultiDrawIndirect() const { return m_multiDrawIndirect; }
+
+    std::size_t getNumDraws() const { return m_draws.size(); }
+
+    Range add(std::span<const MeshInput> meshes)
+    {
+        const Range range{ .m_first = m_draws.size(), .m_count = meshes.size() };
+
+        std::vector<std::byte>    vertexData;
+        std::vector<unsigned int> indexData;
+
+        const auto stride{ m_format.getStride() };
+
+        for (const auto& [vertices, indices, lods, bounds, diffuse, specular] : meshes) {
+            Draw draw{
+                .m_lods           = { lods.begin(), lods.end() },
+                .m_bounds         = bounds,
+                .m_firstIndex     = static_cast<gl::GLuint>(m_indexBytes / sizeof(unsigned int) + indexData.size()),
+                .m_dequantization = {},
+                .m_diffuse        = diffuse,
+                .m_specular       = specular,
+            };
+            if (draw.m_lods.empty()) {
+                const auto indexCount{ static_cast<std::uint32_t>(indices.size()) };
+                draw.m_lods.push_back({ .m_indexOffset = 0, .m_indexCount = indexCount, .m_error = 0.0f });
+            }
+
+            const auto baseVertex{ static_cast<gl::GLint>((m_vertexBytes + vertexData.size()) / stride) };
+            const auto packed{ m_format.pack(vertices, bounds, draw.m_dequantization) };
+            vertexData.insert(vertexData.end(), packed.begin(), packed.end());
+            indexData.insert(indexData.end(), indices.begin(), indices.end());
+
+            const auto& [indexOffset, indexCount, _]{ draw.m_lods.front() };
+            m_commands.push_back({
+                .m_count         = indexCount,
+                .m_instanceCount = 1,
+                .m_firstIndex    = draw.m_firstIndex + indexOffset,
+                .m_baseVertex    = baseVertex,
+                .m_baseInstance  = static_cast<gl::GLuint>(m_draws.size()),
+            });
+            m_draws.push_back(std::move(draw));
+        }
+
+        append(m_vbo, m_vertexCapacity, m_vertexBytes, vertexData);
+        append(m_ebo, m_indexCapacity, m_indexBytes, std::as_bytes(std::span{ indexData }));
+
+        uploadDraws();
+        setupVertexArray();
+        uploadDrawTable();
+
+        std::cout << std::format(
+            "INFO: [GeometryBatch] Added {} meshes ({} KiB of vertices, {} KiB of indices), {} draws in total\n",
+            meshes.size(),
+            vertexData.size() / 1024,
+            indexData.size() * sizeof(unsigned int) / 1024,
+            m_draws.size()
+        );
+
+        return range;
+    }
+
+    // the images of the draws, each once, to pack into the materials
+    std::vector<std::filesystem::path> getImages() const
+    {
+        std::vector<std::filesystem::path> images;
+        for (const auto& draw : m_draws) {
+            for (const auto& path : { draw.m_diffuse, draw.m_specular }) {
+                if (path && std::ranges::find(images, *path) == images.end()) {
+                    images.push_back(*path);
+                }
+            }
+        }
+        return images;
+    }
+
+    // the array for setMaterials(); it decodes and uploads every image, so run it on a loader context when it can
+    static std::optional<TextureArray> packMaterials(std::span<const std::filesystem::path> images)
+    {
+        TextureArrayPacker packer;
+        bool               hasImages{ false };
+        for (const auto& path : images) {
+            hasImages = packer.add(path) || hasImages;
+        }
+        return hasImages ? packer.pack("u_materials", s_materialsUnit) : std::nullopt;
+    }
+
+    // replaces the materials, the draws whose images are not in them are drawn untextured
+    void setMaterials(std::optional<TextureArray>&& materials)
+    {
+        m_materials.reset();    // TextureArray is not assignable
+        if (materials) {
+            m_materials.emplace(std::move(*materials));
+        }
+        uploadDrawTable();
+    }
+
+    void draw(Shader& shader) { draw(shader, Range{ .m_first = 0, .m_count = m_draws.size() }); }
+
+    // every draw of the range at its finest level of detail
+    void draw(Shader& shader, Range range)
+    {
+        submit(shader, m_indirectBuffer, m_commands, range.m_first, range.m_count);
+    }
+
+    // the region of an instance; the first region drawn uploads the frame
+    void draw(Shader& shader, Region region)
+    {
+        using namespace gl;
+
+        if (!m_frameUploaded) {
+            // respecified, so the draws of the previous frames keep the storage they read
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_frameIndirectBuffer);
+            glBufferData(
+                GL_DRAW_INDIRECT_BUFFER,
+                static_cast<GLsizeiptr>(m_frameCommands.size() * sizeof(DrawCommand)),
+                m_frameCommands.data(),
+                GL_STREAM_DRAW
+            );
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            m_frameUploaded = true;
+        }
+        submit(shader, m_frameIndirectBuffer, m_frameCommands, region.m_first, region.m_count);
+    }
+
+    // drops the regions of the previous frame
+    void beginFrame()
+    {
+        m_frameCommands.clear();
+        m_regionBegin   = 0;
+        m_frameUploaded = false;
+    }
+
+    // adds the draw to the region being built, at the coarsest level of detail that looks the same from where the
+    // selector is; every region of a frame must be added before the first one is drawn
+    void addToFrame(std::size_t index, const LodSelector& selector)
+    {
+        const auto& draw{ m_draws[index] };
+        const auto  lod{ std::min(selector.select(draw.m_bounds, draw.m_lods), draw.m_lods.size() - 1) };
+        const auto& [indexOffset, indexCount, _]{ draw.m_lods[lod] };
+
+        auto command{ m_commands[index] };
+        command.m_count      = indexCount;
+        command.m_firstIndex = draw.m_firstIndex + indexOffset;
+        m_frameCommands.push_back(command);
+        m_frameUploaded = false;
+    }
+
+    // the draws added since the previous region
+    Region endRegion()
+    {
+        const Region region{ .m_first = m_regionBegin, .m_count = m_frameCommands.size() - m_regionBegin };
+        m_regionBegin = m_frameCommands.size();
+        return region;
+    }
+
+private:
+    void submit(
+        Shader&                      shader,
+        gl::GLuint                   indirectBuffer,
+        std::span<const DrawCommand> commands,
+        std::size_t                  first,
+        std::size_t                  count
+    )
+    {
+        using namespace gl;
+
+        if (count == 0) {
+            return;
+        }
+
+        if (m_materials) {
+            m_materials->activate(shader);
+        }
+        glActiveTexture(GL_TEXTURE0 + std::underlying_type_t<GLenum>(s_drawTableUnit));
+        glBindTexture(GL_TEXTURE_BUFFER, m_tableTexture);
+        shader.setUniform("u_drawTable", s_drawTableUnit);
+
+        glBindVertexArray(m_vao);
+
+        if (m_multiDrawIndirect) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glMultiDrawElementsIndirect(
+                GL_TRIANGLES,
+                GL_UNSIGNED_INT,
+                reinterpret_cast<const void*>(first * sizeof(DrawCommand)),
+                static_cast<GLsizei>(count),
+                0
+            );
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        } else {
+            for (const auto& [indexCount, _, firstIndex, baseVertex, drawId] : commands.subspan(first, count)) {
+                glVertexAttribI1ui(s_drawIdLocation, drawId);
+                glDrawElementsBaseVertex(
+                    GL_TRIANGLES,
+                    static_cast<GLsizei>(indexCount),
+                    GL_UNSIGNED_INT,
+                    reinterpret_cast<const void*>(firstIndex * sizeof(unsigned int)),
+                    baseVertex
+                );
+            }
+        }
+
+        glBindVertexArray(0);
+    }
+
+    // appends data to the buffer, replacing it with one at least twice as big when it is full
+    static void append(gl::GLuint& buffer, std::size_t& capacity, std::size_t& used, std::span<const std::byte> data)
+    {
+        using namespace gl;
+
+        if (used + data.size() > capacity) {
+            const auto newCapacity{ std::max({ capacity * 2, used + data.size(), s_initialBufferBytes }) };
+
+            GLuint newBuffer{};
+            glGenBuffers(1, &newBuffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(newCapacity), nullptr, GL_STATIC_DRAW);
+
+            if (used > 0) {
+                glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(used));
+                glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            }
+            glDeleteBuffers(1, &buffer);
+
+            buffer   = newBuffer;
+            capacity = newCapacity;
+        }
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferSubData(
+            GL_COPY_WRITE_BUFFER,
+            static_cast<GLintptr>(used),
+            static_cast<GLsizeiptr>(data.size()),
+            data.data()
+        );
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        used += data.size();
+    }
+
+    // the commands and draw ids of every draw; the buffers may have been replaced, so the vertex array is set again
+    void uploadDraws()
+    {
+        using namespace gl;
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+        glBufferData(
+            GL_DRAW_INDIRECT_BUFFER,
+            static_cast<GLsizeiptr>(m_commands.size() * sizeof(DrawCommand)),
+            m_commands.data(),
+            GL_DYNAMIC_DRAW
+        );
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        std::vector<GLuint> drawIds(m_draws.size());
+        std::iota(drawIds.begin(), drawIds.end(), 0u);
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_drawIdBuffer);
+        glBufferData(
+            GL_ARRAY_BUFFER,
+            static_cast<GLsizeiptr>(drawIds.size() * sizeof(GLuint)),
+            drawIds.data(),
+            GL_STATIC_DRAW
+        );
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void setupVertexArray()
+    {
+        using namespace gl;
+
+        glBindVertexArray(m_vao);
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        m_format.setAttributePointers();
+
+        // instance i of a command reads element baseInstance + i, i.e. the draw index
+        if (m_multiDrawIndirect) {
+            glBindBuffer(GL_ARRAY_BUFFER, m_drawIdBuffer);
+            glVertexAttribIPointer(s_drawIdLocation, 1, GL_UNSIGNED_INT, 0, nullptr);
+            glVertexAttribDivisor(s_drawIdLocation, 1);
+            glEnableVertexAttribArray(s_drawIdLocation);
+        }
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void uploadDrawTable()
+    {
+        using namespace gl;
+
+        const auto slotOf = [&](const std::optional<std::filesystem::path>& path) -> TextureSlot {
+            if (path && m_materials && m_materials->contains(*path)) {
+                return *m_materials->getSlot(*path);
+            }
+            return { .m_layer = -1, .m_uvRect = { 0.0f, 0.0f, 1.0f, 1.0f } };
+        };
+
+        std::vector<glm::vec4> table;
+        table.reserve(m_draws.size() * s_texelsPerDraw);
+        for (const auto& draw : m_draws) {
+            const auto& [positionScale, positionOffset, texCoordsScale, texCoordsOffset]{ draw.m_dequantization };
+            const auto diffuse{ slotOf(draw.m_diffuse) };
+            const auto specular{ slotOf(draw.m_specular) };
+
+            table.emplace_back(positionScale, static_cast<float>(diffuse.m_layer));
+            table.emplace_back(positionOffset, static_cast<float>(specular.m_layer));
+            table.emplace_back(texCoordsScale, texCoordsOffset);
+            table.push_back(diffuse.m_uvRect);
+            table.push_back(specular.m_uvRect);
+        }
+
+        glBindBuffer(GL_TEXTURE_BUFFER, m_tableBuffer);
+        glBufferData(
+            GL_TEXTURE_BUFFER,
+            static_cast<GLsizeiptr>(table.size() * sizeof(glm::vec4)),
+            table.data(),
+            GL_STATIC_DRAW
+        );
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        glBindTexture(GL_TEXTURE_BUFFER, m_tableTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_tableBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+#endif /* end of include guard: GEOMETRY_BATCH_HPP_R8MV2CXN */
@@ -91,6 +91,9 @@ private:
     MyImGuiWindowShown m_windowShown{ MyImGuiWindowShown::SHOW_OVERLAY_WINDOW };
     MyImGuiSortBy      m_sortBy{ MyImGuiSortBy::NO_SORT };
     MyImGuiOverlayPos  m_overlayPosition{ MyImGuiOverlayPos::TOP_LEFT };
+    int                m_frameLimit{ 0 };        // 0: no limit
+    int                m_framesInFlight{ 2 };    // 0: up to the driver
+    int                m_tickRate{ 60 };         // of the fixed update
 
     struct LogData
     {
@@ -170,6 +173,33 @@ private:
         if (ImGui::Checkbox("vsync", &vsync)) {
             m_window.setVsync(vsync);
         }
+        if (ImGui::SliderInt("frame limit (0: off)", &m_frameLimit, 0, 240)) {
+            m_window.setFrameLimit(m_frameLimit);
+        }
+        if (ImGui::SliderInt("frames in flight (0: driver)", &m_framesInFlight, 0, 4)) {
+            m_window.setMaxFramesInFlight(static_cast<std::size_t>(m_framesInFlight));
+        }
+        bool fixedUpdate{ m_scene.isFixedUpdate() };
+        auto updateChanged{ ImGui::Checkbox("fixed update thread", &fixedUpdate) };
+        updateChanged |= ImGui::SliderInt("tick rate", &m_tickRate, 10, 240) && fixedUpdate;
+        if (updateChanged) {
+            m_scene.setFixedUpdate(fixedUpdate ? std::optional{ double(m_tickRate) } : std::nullopt);
+        }
+        ImGui::Checkbox("merged draw (multi-draw indirect)", &m_scene.m_mergedDraw);
+        ImGui::SliderInt("instances per side", &m_scene.m_instancesPerSide, 1, 16);
+        ImGui::SliderFloat("animation blend", &m_scene.m_animationBlend, 0.0f, 1.0f);
+
+        const auto loadProgressBar = [](const char* label, const AsyncModel& model) {
+            const auto [stage, loaded, total]{ model.getProgress() };
+            const auto overlay{ stage == AsyncModel::Stage::FAILED
+                                    ? std::format("{}: failed", label)
+                                    : std::format("{}: {}/{} meshes", label, loaded, total) };
+            const auto fraction{ stage == AsyncModel::Stage::DONE ? 1.0f
+                                 : total == 0                     ? 0.0f
+                                                                  : float(loaded) / float(total) };
+            ImGui::ProgressBar(fraction, { -1.0f, 0.0f }, overlay.c_str());
+        };
+        loadProgressBar("model", *m_scene.m_model);
 
         ImGui::Separator();
 
@@ -361,6 +391,29 @@ private:
             ImGui::Separator();
 
             ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / m_imguiIo->Framerate, m_imguiIo->Framerate);
+            const auto frameStats{ m_window.getFrameStats() };
+            ImGui::Text(
+                "jitter: %.3f ms, worst frame: %.3f ms", frameStats.m_jitter.count(), frameStats.m_maxFrameTime.count()
+            );
+            ImGui::Text(
+                "cpu ahead: %.3f ms (max %.3f ms), fence wait: %.3f ms",
+                frameStats.m_meanCpuAhead.count(),
+                frameStats.m_maxCpuAhead.count(),
+                frameStats.m_meanFenceWait.count()
+            );
+            if (const auto& fixedUpdate{ m_scene.m_fixedUpdate }) {
+                ImGui::Text(
+                    "update ticks: %llu (%llu skipped)",
+                    static_cast<unsigned long long>(fixedUpdate->getTickCount()),
+                    static_cast<unsigned long long>(fixedUpdate->getSkippedTicks())
+                );
+            }
+            ImGui::Separator();
+
+            const auto& [visibleInstances, culledInstances]{ m_scene.m_instanceCullStats };
+            const auto& [visibleMeshes, culledMeshes]{ m_scene.m_meshCullStats };
+            ImGui::Text("instances : %zu visible, %zu culled", visibleInstances, culledInstances);
+            ImGui::Text("meshes    : %zu visible, %zu culled", visibleMeshes, culledMeshes);
             ImGui::Separator();
 
             const auto& camPos{ m_scene.m_camera.m_position };
@@ -0,0 +1,56 @@
+#ifndef LOD_SELECTOR_HPP_T5KZ1HQD
+#define LOD_SELECTOR_HPP_T5KZ1HQD
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <span>
+
+#include <glm/glm.hpp>
+
+#include "common/old/camera.hpp"
+
+#include "mesh.hpp"
+
+// picks the coarsest level of detail of a mesh whose error stays under s_maxScreenError pixels on screen
+class LodSelector
+{
+private:
+    static inline constexpr float s_maxScreenError{ 1.0f };
+
+    glm::mat4 m_model;
+    glm::vec3 m_cameraPosition;
+    float     m_near;
+    float     m_scale;                 // largest scale of the model matrix, so the error is never underestimated
+    float     m_pixelsPerUnitAtOne;    // at a distance of one unit from the camera
+
+public:
+    LodSelector(const glm::mat4& model, const Camera& camera, int viewportHeight)
+        : m_model{ model }
+        , m_cameraPosition{ camera.m_position }
+        , m_near{ camera.m_near }
+        , m_scale{ std::sqrt(std::max({
+              glm::dot(glm::vec3{ model[0] }, glm::vec3{ model[0] }),
+              glm::dot(glm::vec3{ model[1] }, glm::vec3{ model[1] }),
+              glm::dot(glm::vec3{ model[2] }, glm::vec3{ model[2] }),
+          })) }
+        , m_pixelsPerUnitAtOne{ float(viewportHeight) / (2.0f * std::tan(glm::radians(camera.m_fov) / 2.0f)) }
+    {
+    }
+
+    std::size_t select(const Bounds& bounds, std::span<const MeshLod> lods) const
+    {
+        const glm::vec3 center{ m_model * glm::vec4{ bounds.m_center, 1.0f } };
+        const float     radius{ bounds.m_radius * m_scale };
+        const float     distance{ std::max(glm::distance(center, m_cameraPosition) - radius, m_near) };
+
+        std::size_t lod{ 0 };
+        while (lod + 1 < lods.size()
+               && lods[lod + 1].m_error * m_scale * m_pixelsPerUnitAtOne / distance <= s_maxScreenError) {
+            ++lod;
+        }
+        return lod;
+    }
+};
+
+#endif /* end of include guard: LOD_SELECTOR_HPP_T5KZ1HQD */
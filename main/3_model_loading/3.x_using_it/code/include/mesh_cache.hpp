@@ -0,0 +1,514 @@
+#ifndef MESH_CACHE_HPP_R6DWQX3A
+#define MESH_CACHE_HPP_R6DWQX3A
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "common/old/mapped_file.hpp"
+
+#include "animation.hpp"
+#include "mesh.hpp"
+
+/*
+ * Binary snapshot of an imported model, so the model file doesn't have to go through Assimp on every launch.
+ * The vertex and index blobs are the full precision Vertex and 32-bit indices the importer produced, read in place
+ * from the mapped file: Mesh packs them (quantized attributes, narrowed indices) when it uploads them, and a
+ * GeometryBatch converts them to its own layout, so the cache doesn't depend on either format.
+ *
+ * The cache records a hash of every file the importer read (the model itself, material libraries, ...) and is
+ * rejected as soon as one of them changes. It is also rejected on a format version or Vertex layout mismatch, or
+ * when it was made with a different import key (opaque to the cache, it stands for the import options).
+ * The data is stored in native byte order: the cache is not meant to be portable between machines.
+ *
+ * layout (every record is aligned to s_alignment):
+ *
+ *     FileHeader
+ *     DependencyHeader, path                   x m_numDependencies
+ *     MeshHeader
+ *         TextureHeader, path                  x m_numTextures
+ *         vertices                             x m_numVertices
+ *         indices                              x m_numIndices
+ *         MeshLod                              x m_numLods
+ *                                              x m_numMeshes
+ *     AnimationHeader
+ *         parents                              x m_numJoints
+ *         inverse bind matrices                x m_numJoints
+ *         bind pose                            x m_numJoints * Pose::NUM_CHANNELS
+ *         ClipHeader, name                     x m_numClips
+ *             frames                           x m_numFrames * m_numJoints * Pose::NUM_CHANNELS
+ */
+class MeshCache
+{
+public:
+    static inline constexpr std::uint32_t s_version{ 6 };
+
+    struct Dependency
+    {
+        std::string   m_path;    // relative to the model directory
+        std::uint64_t m_hash;
+    };
+
+    // a mesh inside the cache; the spans point into the mapped file
+    struct MeshView
+    {
+        std::span<const Vertex>       m_vertices;
+        std::span<const unsigned int> m_indices;
+        std::span<const MeshLod>      m_lods;
+        std::vector<TextureRef>       m_textures;
+        Bounds                        m_bounds;
+        VertexAttributes              m_attributes;
+    };
+
+private:
+    static inline constexpr std::size_t         s_alignment{ 16 };
+    static inline constexpr std::array<char, 4> s_magic{ 'L', 'O', 'M', 'C' };
+
+    // bits of MeshHeader::m_attributes
+    static inline constexpr std::uint32_t s_hasNormals{ 1 << 0 };
+    static inline constexpr std::uint32_t s_hasTexCoords{ 1 << 1 };
+    static inline constexpr std::uint32_t s_hasTangents{ 1 << 2 };
+    static inline constexpr std::uint32_t s_hasSkin{ 1 << 3 };
+
+    struct FileHeader
+    {
+        std::array<char, 4> m_magic;
+        std::uint32_t       m_version;
+        std::uint32_t       m_vertexSize;
+        std::uint32_t       m_indexSize;
+        std::uint32_t       m_importKey;
+        std::uint32_t       m_numDependencies;
+        std::uint32_t       m_numMeshes;
+    };
+
+    struct DependencyHeader
+    {
+        std::uint64_t m_hash;
+        std::uint32_t m_pathLength;
+    };
+
+    struct MeshHeader
+    {
+        std::uint32_t m_numVertices;
+        std::uint32_t m_numIndices;
+        std::uint32_t m_numTextures;
+        std::uint32_t m_numLods;
+        std::uint32_t m_attributes;
+        float         m_min[3];
+        float         m_max[3];
+        float         m_sphere[4];    // center, radius
+    };
+
+    struct TextureHeader
+    {
+        std::uint32_t m_type;
+        std::uint32_t m_index;
+        std::uint32_t m_pathLength;
+    };
+
+    struct AnimationHeader
+    {
+        std::uint32_t m_numJoints;    // 0: no skeleton
+        std::uint32_t m_numClips;
+        float         m_globalInverse[16];
+    };
+
+    struct ClipHeader
+    {
+        float         m_frameRate;
+        std::uint32_t m_numFrames;
+        std::uint32_t m_nameLength;
+    };
+
+    MappedFile            m_file;
+    std::vector<MeshView> m_meshes;
+    AnimationData         m_animation;    // copied out of the file, it is small next to the meshes
+
+public:
+    static std::filesystem::path pathFor(const std::filesystem::path& modelPath)
+    {
+        auto path{ modelPath };
+        path += ".meshcache";
+        return path;
+    }
+
+    // FNV-1a over the whole file content
+    static std::optional<std::uint64_t> hashFile(const std::filesystem::path& filePath)
+    {
+        auto maybeFile{ MappedFile::open(filePath, MappedFile::Advice::SEQUENTIAL) };
+        if (!maybeFile) {
+            return {};
+        }
+
+        std::uint64_t hash{ 0xcbf29ce484222325 };
+        for (auto byte : std::span{ maybeFile->data(), maybeFile->size() }) {
+            hash ^= byte;
+            hash *= 0x100000001b3;
+        }
+        return hash;
+    }
+
+    // returns the cache only if it is valid and up to date with the files it was created from
+    static std::optional<MeshCache> open(
+        const std::filesystem::path& cachePath,
+        const std::filesystem::path& modelDir,
+        std::uint32_t                importKey
+    )
+    {
+        if (!std::filesystem::exists(cachePath)) {
+            return {};
+        }
+
+        auto maybeFile{ MappedFile::open(cachePath, MappedFile::Advice::SEQUENTIAL) };
+        if (!maybeFile) {
+            return {};
+        }
+
+        MeshCache cache{ std::move(*maybeFile) };
+        if (!cache.parse(modelDir, importKey)) {
+            std::cout << std::format("INFO: [MeshCache] '{}' is stale or invalid, ignored\n", cachePath.string());
+            return {};
+        }
+        return cache;
+    }
+
+    static bool write(
+        const std::filesystem::path&   cachePath,
+        std::uint32_t                  importKey,
+        const std::vector<Dependency>& dependencies,
+        const std::vector<MeshData>&   meshes,
+        const AnimationData&           animation
+    )
+    {
+        // write to a temporary file first so a crash never leaves a truncated cache behind
+        auto tempPath{ cachePath };
+        tempPath += ".tmp";
+
+        std::ofstream out{ tempPath, std::ios::binary | std::ios::trunc };
+        if (!out) {
+            std::cerr << std::format("ERROR: [MeshCache] Failed to create '{}'\n", tempPath.string());
+            return false;
+        }
+
+        const auto writeBytes = [&](const void* data, std::size_t size) {
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        };
+        const auto writeRecord = [&](const auto& record) { writeBytes(&record, sizeof(record)); };
+        const auto pad         = [&] {
+            constexpr std::array<char, s_alignment> zeros{};
+            const auto offset{ static_cast<std::size_t>(out.tellp()) };
+            writeBytes(zeros.data(), (s_alignment - offset % s_alignment) % s_alignment);
+        };
+
+        writeRecord(FileHeader{
+            .m_magic           = s_magic,
+            .m_version         = s_version,
+            .m_vertexSize      = sizeof(Vertex),
+            .m_indexSize       = sizeof(unsigned int),
+            .m_importKey       = importKey,
+            .m_numDependencies = static_cast<std::uint32_t>(dependencies.size()),
+            .m_numMeshes       = static_cast<std::uint32_t>(meshes.size()),
+        });
+        pad();
+
+        for (const auto& [path, hash] : dependencies) {
+            writeRecord(DependencyHeader{ .m_hash = hash, .m_pathLength = static_cast<std::uint32_t>(path.size()) });
+            writeBytes(path.data(), path.size());
+            pad();
+        }
+
+        for (const auto& mesh : meshes) {
+            const auto& [min, max, center, radius]{ mesh.m_bounds };
+            const auto& [normals, texCoords, tangents, skin]{ mesh.m_attributes };
+            writeRecord(MeshHeader{
+                .m_numVertices = static_cast<std::uint32_t>(mesh.m_vertices.size()),
+                .m_numIndices  = static_cast<std::uint32_t>(mesh.m_indices.size()),
+                .m_numTextures = static_cast<std::uint32_t>(mesh.m_textures.size()),
+                .m_numLods     = static_cast<std::uint32_t>(mesh.m_lods.size()),
+                .m_attributes  = (normals ? s_hasNormals : 0) | (texCoords ? s_hasTexCoords : 0)
+                              | (tangents ? s_hasTangents : 0) | (skin ? s_hasSkin : 0),
+                .m_min         = { min.x, min.y, min.z },
+                .m_max         = { max.x, max.y, max.z },
+                .m_sphere      = { center.x, center.y, center.z, radius },
+            });
+            pad();
+
+            for (const auto& [type, index, path] : mesh.m_textures) {
+                writeRecord(TextureHeader{
+                    .m_type       = type,
+                    .m_index      = index,
+                    .m_pathLength = static_cast<std::uint32_t>(path.size()),
+                });
+                writeBytes(path.data(), path.size());
+                pad();
+            }
+
+            writeBytes(mesh.m_vertices.data(), mesh.m_vertices.size() * sizeof(Vertex));
+            pad();
+            writeBytes(mesh.m_indices.data(), mesh.m_indices.size() * sizeof(unsigned int));
+            pad();
+            writeBytes(mesh.m_lods.data(), mesh.m_lods.size() * sizeof(MeshLod));
+            pad();
+        }
+
+        const auto& [skeleton, clips]{ animation };
+        const auto  numJoints{ skeleton ? skeleton->getNumJoints() : 0 };
+
+        AnimationHeader animationHeader{
+            .m_numJoints     = static_cast<std::uint32_t>(numJoints),
+            .m_numClips      = static_cast<std::uint32_t>(skeleton ? clips.size() : 0),
+            .m_globalInverse = {},
+        };
+        if (skeleton) {
+            std::memcpy(animationHeader.m_globalInverse, &skeleton->m_globalInverse, sizeof(glm::mat4));
+        }
+        writeRecord(animationHeader);
+        pad();
+
+        if (skeleton) {
+            writeBytes(skeleton->m_parents.data(), numJoints * sizeof(std::int32_t));
+            pad();
+            writeBytes(skeleton->m_inverseBind.data(), numJoints * sizeof(glm::mat4));
+            pad();
+            writeBytes(skeleton->m_bindPose.data(), skeleton->m_bindPose.size() * sizeof(float));
+            pad();
+
+            for (const auto& [name, frameRate, numFrames, frames] : clips) {
+                writeRecord(ClipHeader{
+                    .m_frameRate  = frameRate,
+                    .m_numFrames  = numFrames,
+                    .m_nameLength = static_cast<std::uint32_t>(name.size()),
+                });
+                writeBytes(name.data(), name.size());
+                pad();
+                writeBytes(frames.data(), frames.size() * sizeof(float));
+                pad();
+            }
+        }
+
+        out.close();
+        if (!out) {
+            std::cerr << std::format("ERROR: [MeshCache] Failed to write '{}'\n", tempPath.string());
+            return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tempPath, cachePath, ec);
+        if (ec) {
+            std::cerr << std::format("ERROR: [MeshCache] Failed to write '{}': {}\n", cachePath.string(), ec.message());
+            return false;
+        }
+        return true;
+    }
+
+public:
+    MeshCache(MeshCache&&) = default;
+
+    const std::vector<MeshView>& getMeshes() const { return m_meshes; }
+
+    const AnimationData& getAnimation() const { return m_animation; }
+
+private:
+    MeshCache(MappedFile&& file)
+        : m_file{ std::move(file) }
+    {
+    }
+
+    bool parse(const std::filesystem::path& modelDir, std::uint32_t importKey)
+    {
+        static_assert(std::is_trivially_copyable_v<Vertex> && std::is_trivially_copyable_v<MeshLod>);
+
+        const unsigned char* data{ m_file.data() };
+        const std::size_t    size{ m_file.size() };
+        std::size_t          offset{ 0 };
+
+        const auto align = [&] { offset = (offset + s_alignment - 1) / s_alignment * s_alignment; };
+
+        // bounds checked reads
+        const auto readRecord = [&]<typename T>(T& record) {
+            if (offset + sizeof(T) > size) {
+                return false;
+            }
+            std::memcpy(&record, data + offset, sizeof(T));
+            offset += sizeof(T);
+            return true;
+        };
+        const auto readString = [&](std::size_t length, std::string& str) {
+            if (offset + length > size) {
+                return false;
+            }
+            str.assign(reinterpret_cast<const char*>(data + offset), length);
+            offset += length;
+            return true;
+        };
+        const auto readBlob = [&]<typename T>(std::size_t count, std::span<const T>& span) {
+            if (offset + count * sizeof(T) > size) {
+                return false;
+            }
+            span    = { reinterpret_cast<const T*>(data + offset), count };    // 16 byte aligned in the file
+            offset += count * sizeof(T);
+            return true;
+        };
+
+        FileHeader header;
+        if (!readRecord(header) || header.m_magic != s_magic || header.m_version != s_version
+            || header.m_vertexSize != sizeof(Vertex) || header.m_indexSize != sizeof(unsigned int)
+            || header.m_importKey != importKey) {
+            return false;
+        }
+        align();
+
+        for (std::uint32_t i{ 0 }; i < header.m_numDependencies; ++i) {
+            DependencyHeader dependency;
+            std::string      path;
+            if (!readRecord(dependency) || !readString(dependency.m_pathLength, path)) {
+                return false;
+            }
+            align();
+
+            if (hashFile(modelDir / path) != dependency.m_hash) {
+                return false;
+            }
+        }
+
+        m_meshes.reserve(header.m_numMeshes);
+        for (std::uint32_t i{ 0 }; i < header.m_numMeshes; ++i) {
+            MeshHeader meshHeader;
+            if (!readRecord(meshHeader)) {
+                return false;
+            }
+            align();
+
+            MeshView mesh{
+                .m_vertices = {},
+                .m_indices  = {},
+                .m_lods     = {},
+                .m_textures = {},
+                .m_bounds   = {
+                    .m_min    = { meshHeader.m_min[0], meshHeader.m_min[1], meshHeader.m_min[2] },
+                    .m_max    = { meshHeader.m_max[0], meshHeader.m_max[1], meshHeader.m_max[2] },
+                    .m_center = { meshHeader.m_sphere[0], meshHeader.m_sphere[1], meshHeader.m_sphere[2] },
+                    .m_radius = meshHeader.m_sphere[3],
+                },
+                .m_attributes = {
+                    .m_normals   = (meshHeader.m_attributes & s_hasNormals) != 0,
+                    .m_texCoords = (meshHeader.m_attributes & s_hasTexCoords) != 0,
+                    .m_tangents  = (meshHeader.m_attributes & s_hasTangents) != 0,
+                    .m_skin      = (meshHeader.m_attributes & s_hasSkin) != 0,
+                },
+            };
+
+            for (std::uint32_t j{ 0 }; j < meshHeader.m_numTextures; ++j) {
+                TextureHeader texture;
+                std::string   path;
+                if (!readRecord(texture) || !readString(texture.m_pathLength, path)) {
+                    return false;
+                }
+                align();
+                mesh.m_textures.push_back({ .m_type = texture.m_type, .m_index = texture.m_index, .m_path = std::move(path) });
+            }
+
+            if (!readBlob(meshHeader.m_numVertices, mesh.m_vertices)) {
+                return false;
+            }
+            align();
+            if (!readBlob(meshHeader.m_numIndices, mesh.m_indices)) {
+                return false;
+            }
+            align();
+            if (!readBlob(meshHeader.m_numLods, mesh.m_lods)) {
+                return false;
+            }
+            align();
+
+            for (const auto& [indexOffset, indexCount, _] : mesh.m_lods) {
+                if (std::size_t(indexOffset) + indexCount > mesh.m_indices.size()) {
+                    return false;
+                }
+            }
+
+            m_meshes.push_back(std::move(mesh));
+        }
+
+        return parseAnimation(readRecord, readString, readBlob, align);
+    }
+
+    bool parseAnimation(auto& readRecord, auto& readString, auto& readBlob, auto& align)
+    {
+        AnimationHeader header;
+        if (!readRecord(header)) {
+            return false;
+        }
+        align();
+        if (header.m_numJoints == 0) {
+            return true;
+        }
+
+        const std::size_t numJoints{ header.m_numJoints };
+        const std::size_t poseSize{ numJoints * Pose::NUM_CHANNELS };
+
+        std::span<const std::int32_t> parents;
+        std::span<const glm::mat4>    inverseBind;
+        std::span<const float>        bindPose;
+        if (!readBlob(numJoints, parents)) {
+            return false;
+        }
+        align();
+        if (!readBlob(numJoints, inverseBind)) {
+            return false;
+        }
+        align();
+        if (!readBlob(poseSize, bindPose)) {
+            return false;
+        }
+        align();
+
+        for (std::size_t j{ 0 }; j < numJoints; ++j) {
+            if (parents[j] >= std::int32_t(j)) {
+                return false;    // a parent must come before its children
+            }
+        }
+
+        auto& skeleton{ m_animation.m_skeleton.emplace() };
+        skeleton.m_parents.assign(parents.begin(), parents.end());
+        skeleton.m_inverseBind.assign(inverseBind.begin(), inverseBind.end());
+        skeleton.m_bindPose.assign(bindPose.begin(), bindPose.end());
+        std::memcpy(&skeleton.m_globalInverse, header.m_globalInverse, sizeof(glm::mat4));
+
+        for (std::uint32_t i{ 0 }; i < header.m_numClips; ++i) {
+            ClipHeader             clipHeader;
+            std::string            name;
+            std::span<const float> frames;
+            if (!readRecord(clipHeader) || !readString(clipHeader.m_nameLength, name)) {
+                return false;
+            }
+            align();
+            if (clipHeader.m_numFrames == 0 || !readBlob(clipHeader.m_numFrames * poseSize, frames)) {
+                return false;
+            }
+            align();
+
+            m_animation.m_clips.push_back({
+                .m_name      = std::move(name),
+                .m_frameRate = clipHeader.m_frameRate,
+                .m_numFrames = clipHeader.m_numFrames,
+                .m_frames    = { frames.begin(), frames.end() },
+            });
+        }
+
+        return true;
+    }
+};
+
+#endif /* end of include guard: MESH_CACHE_HPP_R6DWQX3A */
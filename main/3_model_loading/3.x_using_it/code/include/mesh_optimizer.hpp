@@ -0,0 +1,358 @@
+#ifndef MESH_OPTIMIZER_HPP_W4NJ8PZE
+#define MESH_OPTIMIZER_HPP_W4NJ8PZE
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hpp"
+
+/*
+ * Import time reordering of the index and vertex buffers of a mesh:
+ *
+ *  1. triangles are reordered for the post-transform vertex cache (Tipsify, Sander et al. 2007), which also splits
+ *     the mesh into clusters wherever the walk has to jump
+ *  2. the clusters are sorted so the outward facing ones come first, which lets early-z reject more of the rest
+ *  3. the vertices are reordered in the order the index buffer first uses them, for fetch locality
+ *
+ * None of this changes what is drawn, only the order. Every level of detail is reordered on its own, the vertex
+ * order follows the full resolution one. The result ends up in the mesh cache, so it is done once.
+ */
+class MeshOptimizer
+{
+public:
+    // vertices transformed by a simulated fifo cache, per triangle (ACMR, 0.5 at best on a regular grid) and per
+    // vertex used (ATVR, 1 at best)
+    struct Stats
+    {
+        std::size_t m_numTriangles{ 0 };
+        std::size_t m_numVertices{ 0 };    // used by the triangles
+        std::size_t m_transformedBefore{ 0 };
+        std::size_t m_transformedAfter{ 0 };
+
+        Stats& operator+=(const Stats& other)
+        {
+            m_numTriangles      += other.m_numTriangles;
+            m_numVertices       += other.m_numVertices;
+            m_transformedBefore += other.m_transformedBefore;
+            m_transformedAfter  += other.m_transformedAfter;
+            return *this;
+        }
+
+        float acmrBefore() const { return ratio(m_transformedBefore, m_numTriangles); }
+        float acmrAfter() const { return ratio(m_transformedAfter, m_numTriangles); }
+        float atvrBefore() const { return ratio(m_transformedBefore, m_numVertices); }
+        float atvrAfter() const { return ratio(m_transformedAfter, m_numVertices); }
+
+    private:
+        static float ratio(std::size_t a, std::size_t b) { return b > 0 ? float(a) / float(b) : 0.0f; }
+    };
+
+private:
+    static inline constexpr std::size_t s_cacheSize{ 16 };    // a common size for a simulated fifo cache
+
+public:
+    // the stats are those of the full resolution level
+    static Stats optimize(MeshData& mesh)
+    {
+        auto& [vertices, indices, textures, bounds, attributes, lods]{ mesh };
+        if (indices.size() < 3 || vertices.empty()) {
+            return {};
+        }
+        if (lods.empty()) {
+            lods.push_back({ .m_indexOffset = 0, .m_indexCount = std::uint32_t(indices.size()), .m_error = 0.0f });
+        }
+
+        const auto lodIndices = [&](const MeshLod& lod) {
+            return std::span{ indices }.subspan(lod.m_indexOffset, lod.m_indexCount);
+        };
+
+        Stats stats{
+            .m_numTriangles      = lods.front().m_indexCount / 3,
+            .m_numVertices       = countUsed(lodIndices(lods.front()), vertices.size()),
+            .m_transformedBefore = countTransformed(lodIndices(lods.front()), vertices.size()),
+        };
+
+        for (const auto& lod : lods) {
+            const auto                range{ lodIndices(lod) };
+            std::vector<unsigned int> reordered{ range.begin(), range.end() };
+
+            const auto clusters{ reorderForVertexCache(reordered, vertices.size()) };
+            sortClustersForOverdraw(reordered, vertices, clusters);
+            std::ranges::copy(reordered, range.begin());
+        }
+        reorderForVertexFetch(vertices, indices);
+
+        stats.m_transformedAfter = countTransformed(lodIndices(lods.front()), vertices.size());
+        return stats;
+    }
+
+    static std::size_t countUsed(std::span<const unsigned int> indices, std::size_t numVertices)
+    {
+        std::vector<bool> used(numVertices, false);
+        for (auto index : indices) {
+            used[index] = true;
+        }
+        return static_cast<std::size_t>(std::ranges::count(used, true));
+    }
+
+    // one line per mesh, then the whole model
+    static void logReport(std::span<const Stats> meshes)
+    {
+        const auto line = [](std::string_view name, const Stats& stats) {
+            return std::format(
+                "INFO: [MeshOptimizer] {:>8} {:>9} {:>9}   ACMR {:.3f} -> {:.3f}   ATVR {:.3f} -> {:.3f}\n",
+                name,
+                stats.m_numTriangles,
+                stats.m_numVertices,
+                stats.acmrBefore(),
+                stats.acmrAfter(),
+                stats.atvrBefore(),
+                stats.atvrAfter()
+            );
+        };
+
+        std::string report{ std::format(
+            "INFO: [MeshOptimizer] {:>8} {:>9} {:>9}   (fifo cache of {} vertices)\n",
+            "mesh",
+            "triangles",
+            "vertices",
+            s_cacheSize
+        ) };
+
+        Stats total;
+        for (std::size_t i{ 0 }; i < meshes.size(); ++i) {
+            report += line(std::format("{}", i), meshes[i]);
+            total  += meshes[i];
+        }
+        report += line("total", total);
+
+        std::cout << report;
+    }
+
+    static std::size_t countTransformed(std::span<const unsigned int> indices, std::size_t numVertices)
+    {
+        std::vector<std::size_t> insertedAt(numVertices, 0);    // 0: not in the cache
+        std::size_t              time{ 0 };
+
+        for (auto index : indices) {
+            if (insertedAt[index] == 0 || time - insertedAt[index] >= s_cacheSize) {
+                insertedAt[index] = ++time;    // a miss pushes the vertex in the fifo
+            }
+        }
+        return time;
+    }
+
+private:
+    // returns the index of the first triangle of each cluster
+    static std::vector<std::size_t> reorderForVertexCache(std::vector<unsigned int>& indices, std::size_t numVertices)
+    {
+        const std::size_t numTriangles{ indices.size() / 3 };
+
+        // vertex -> triangles adjacency, in compressed rows
+        std::vector<std::size_t> adjacencyOffsets(numVertices + 1, 0);
+        for (auto index : indices) {
+            ++adjacencyOffsets[index + 1];
+        }
+        std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+
+        std::vector<std::size_t> adjacency(indices.size());
+        {
+            auto fill{ adjacencyOffsets };
+            for (std::size_t i{ 0 }; i < indices.size(); ++i) {
+                adjacency[fill[indices[i]]++] = i / 3;
+            }
+        }
+
+        std::vector<std::size_t> liveTriangles(numVertices);
+        for (std::size_t v{ 0 }; v < numVertices; ++v) {
+            liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+        }
+
+        std::vector<std::size_t>  cacheTime(numVertices, 0);
+        std::vector<bool>         emitted(numTriangles, false);
+        std::vector<unsigned int> deadEnd;
+        std::vector<unsigned int> candidates;
+        std::vector<unsigned int> output;
+        std::vector<std::size_t>  clusters{ 0 };
+        output.reserve(indices.size());
+
+        std::size_t time{ s_cacheSize + 1 };
+        std::size_t cursor{ 0 };
+        long long   fanning{ indices[0] };
+
+        while (fanning >= 0) {
+            const auto f{ static_cast<std::size_t>(fanning) };
+
+            candidates.clear();
+            for (auto i{ adjacencyOffsets[f] }; i < adjacencyOffsets[f + 1]; ++i) {
+                const auto triangle{ adjacency[i] };
+                if (emitted[triangle]) {
+                    continue;
+                }
+
+                for (std::size_t j{ 0 }; j < 3; ++j) {
+                    const auto v{ indices[triangle * 3 + j] };
+                    output.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    --liveTriangles[v];
+                    if (time - cacheTime[v] > s_cacheSize) {
+                        cacheTime[v] = time++;
+                    }
+                }
+                emitted[triangle] = true;
+            }
+
+            // next fanning vertex: the one that will still be in the cache after its remaining triangles are
+            // emitted, preferring the oldest one
+            fanning = -1;
+            long long bestPriority{ -1 };
+            for (auto v : candidates) {
+                if (liveTriangles[v] == 0) {
+                    continue;
+                }
+                long long priority{ 0 };
+                if (time - cacheTime[v] + 2 * liveTriangles[v] <= s_cacheSize) {
+                    priority = static_cast<long long>(time - cacheTime[v]);
+                }
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    fanning      = v;
+                }
+            }
+            if (fanning >= 0) {
+                continue;
+            }
+
+            // dead end: go back to a recently used vertex, or jump to any vertex with triangles left
+            while (!deadEnd.empty() && fanning < 0) {
+                const auto v{ deadEnd.back() };
+                deadEnd.pop_back();
+                if (liveTriangles[v] > 0) {
+                    fanning = v;
+                }
+            }
+            while (fanning < 0 && cursor < numVertices) {
+                if (liveTriangles[cursor] > 0) {
+                    fanning = static_cast<long long>(cursor);
+                }
+                ++cursor;
+            }
+
+            if (fanning >= 0) {
+                clusters.push_back(output.size() / 3);
+            }
+        }
+
+        indices = std::move(output);
+        return clusters;
+    }
+
+    static void sortClustersForOverdraw(
+        std::vector<unsigned int>&      indices,
+        const std::vector<Vertex>&      vertices,
+        const std::vector<std::size_t>& clusters
+    )
+    {
+        if (clusters.size() < 2) {
+            return;
+        }
+
+        struct Cluster
+        {
+            std::size_t m_begin;
+            std::size_t m_end;    // in triangles
+            float       m_sortKey;
+        };
+
+        const auto position = [&](std::size_t i) { return vertices[indices[i]].m_position; };
+
+        // area weighted centroid of the whole mesh and of every cluster
+        std::vector<Cluster>   sorted;
+        std::vector<glm::vec3> centroids;
+        std::vector<glm::vec3> normals;
+        glm::vec3              meshCentroid{ 0.0f };
+        float                  meshArea{ 0.0f };
+
+        for (std::size_t c{ 0 }; c < clusters.size(); ++c) {
+            const auto begin{ clusters[c] };
+            const auto end{ c + 1 < clusters.size() ? clusters[c + 1] : indices.size() / 3 };
+
+            glm::vec3 centroid{ 0.0f };
+            glm::vec3 normal{ 0.0f };
+            float     area{ 0.0f };
+            for (auto t{ begin }; t < end; ++t) {
+                const auto p0{ position(t * 3) };
+                const auto p1{ position(t * 3 + 1) };
+                const auto p2{ position(t * 3 + 2) };
+
+                const auto n{ glm::cross(p1 - p0, p2 - p0) };    // length is twice the area
+                const auto a{ glm::length(n) };
+
+                centroid += (p0 + p1 + p2) * (a / 3.0f);
+                normal   += n;
+                area     += a;
+            }
+
+            meshCentroid += centroid;
+            meshArea     += area;
+
+            sorted.push_back({ .m_begin = begin, .m_end = end, .m_sortKey = 0.0f });
+            centroids.push_back(area > 0.0f ? centroid / area : centroid);
+            normals.push_back(normal);
+        }
+        if (meshArea > 0.0f) {
+            meshCentroid /= meshArea;
+        }
+
+        // how much a cluster faces away from the center of the mesh
+        for (std::size_t c{ 0 }; c < sorted.size(); ++c) {
+            const float normalLength{ glm::length(normals[c]) };
+            sorted[c].m_sortKey = normalLength > 0.0f
+                                    ? glm::dot(centroids[c] - meshCentroid, normals[c] / normalLength)
+                                    : std::numeric_limits<float>::lowest();
+        }
+
+        std::ranges::stable_sort(sorted, std::greater{}, &Cluster::m_sortKey);
+
+        std::vector<unsigned int> output;
+        output.reserve(indices.size());
+        for (const auto& [begin, end, _] : sorted) {
+            output.insert(output.end(), indices.begin() + long(begin * 3), indices.begin() + long(end * 3));
+        }
+        indices = std::move(output);
+    }
+
+    static void reorderForVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+    {
+        constexpr auto unused{ std::numeric_limits<unsigned int>::max() };
+
+        std::vector<unsigned int> remap(vertices.size(), unused);
+        std::vector<Vertex>       output;
+        output.reserve(vertices.size());
+
+        for (auto& index : indices) {
+            if (remap[index] == unused) {
+                remap[index] = static_cast<unsigned int>(output.size());
+                output.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+
+        // vertices no triangle refers to are dropped
+        vertices = std::move(output);
+    }
+};
+
+#endif /* end of include guard: MESH_OPTIMIZER_HPP_W4NJ8PZE */
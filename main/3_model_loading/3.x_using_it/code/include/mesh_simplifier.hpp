@@ -0,0 +1,349 @@
+#ifndef MESH_SIMPLIFIER_HPP_QX7B2MRK
+#define MESH_SIMPLIFIER_HPP_QX7B2MRK
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hpp"
+
+/*
+ * Quadric error metric simplification (Garland and Heckbert 1997) restricted to collapsing a vertex onto one of its
+ * neighbours, so every LOD indexes into the same vertex buffer as the full resolution mesh.
+ *
+ * Vertices on an open border or on an attribute seam (vertices sharing a position but not their normal, uv, ...) are
+ * never moved, which keeps the silhouette and the uv layout intact at the cost of some reduction on heavily seamed
+ * meshes. The input is expected to be indexed (aiProcess_JoinIdenticalVertices): exact duplicates are merged here as
+ * well, but only for the time of the simplification.
+ */
+class MeshSimplifier
+{
+private:
+    // symmetric 4x4 matrix: a2 ab ac ad b2 bc bd c2 cd d2
+    struct Quadric
+    {
+        std::array<double, 10> m_q{};
+
+        static Quadric fromPlane(const glm::dvec3& n, double d)
+        {
+            return { {
+                n.x * n.x, n.x * n.y, n.x * n.z, n.x * d,    //
+                n.y * n.y, n.y * n.z, n.y * d,               //
+                n.z * n.z, n.z * d,                          //
+                d * d,
+            } };
+        }
+
+        Quadric& operator+=(const Quadric& other)
+        {
+            for (std::size_t i{ 0 }; i < m_q.size(); ++i) {
+                m_q[i] += other.m_q[i];
+            }
+            return *this;
+        }
+
+        friend Quadric operator+(Quadric lhs, const Quadric& rhs) { return lhs += rhs; }
+
+        // sum of the squared distances of p to the planes
+        double evaluate(const glm::vec3& p) const
+        {
+            const double x{ p.x }, y{ p.y }, z{ p.z };
+            const auto&  q{ m_q };
+            const double error{ q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x    //
+                                + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y                     //
+                                + q[7] * z * z + 2 * q[8] * z                                        //
+                                + q[9] };
+            return std::max(error, 0.0);
+        }
+    };
+
+    struct Collapse
+    {
+        double        m_cost;
+        unsigned int  m_from;
+        unsigned int  m_to;
+        std::uint32_t m_fromStamp;
+        std::uint32_t m_toStamp;
+
+        bool operator>(const Collapse& other) const { return m_cost > other.m_cost; }
+    };
+
+public:
+    // appends a level of detail to the mesh for each error target (relative to the size of the mesh), each one
+    // aiming at half the triangles of the previous; stops early once a level barely reduces anything
+    static void buildLods(MeshData& mesh, std::span<const float> relativeErrors)
+    {
+        auto& [vertices, indices, textures, bounds, attributes, lods]{ mesh };
+        if (lods.empty()) {
+            lods.push_back({ .m_indexOffset = 0, .m_indexCount = std::uint32_t(indices.size()), .m_error = 0.0f });
+        }
+
+        const float size{ glm::length(bounds.m_max - bounds.m_min) };
+
+        for (auto relativeError : relativeErrors) {
+            const auto& previous{ lods.back() };
+            const auto  previousIndices{ std::span{ indices }.subspan(previous.m_indexOffset, previous.m_indexCount) };
+
+            const std::size_t targetIndexCount{ previous.m_indexCount / 6 * 3 };
+
+            float error;
+            auto  simplified{ simplify(vertices, previousIndices, targetIndexCount, relativeError * size, error) };
+            if (simplified.empty() || simplified.size() > previous.m_indexCount * 9 / 10) {
+                break;
+            }
+
+            lods.push_back({
+                .m_indexOffset = std::uint32_t(indices.size()),
+                .m_indexCount  = std::uint32_t(simplified.size()),
+                .m_error       = std::max(error, previous.m_error),
+            });
+            indices.insert(indices.end(), simplified.begin(), simplified.end());
+        }
+    }
+
+    // simplified version of the triangles in indices, stops at targetIndexCount or when the next collapse would move
+    // the surface by more than targetError (in model space); error receives the largest error actually introduced
+    static std::vector<unsigned int> simplify(
+        std::span<const Vertex>       vertices,
+        std::span<const unsigned int> indices,
+        std::size_t                   targetIndexCount,
+        float                         targetError,
+        float&                        error
+    )
+    {
+        error = 0.0f;
+
+        const std::size_t numVertices{ vertices.size() };
+        const std::size_t numTriangles{ indices.size() / 3 };
+
+        std::vector<std::array<unsigned int, 3>> triangles(numTriangles);
+        for (std::size_t t{ 0 }; t < numTriangles; ++t) {
+            triangles[t] = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+        }
+
+        const auto locked{ findLockedVertices(vertices, triangles) };    // also merges the duplicates in triangles
+
+        std::vector<std::vector<std::size_t>> vertexTriangles(numVertices);
+        std::vector<Quadric>                  quadrics(numVertices);
+        for (std::size_t t{ 0 }; t < numTriangles; ++t) {
+            const auto& [i0, i1, i2]{ triangles[t] };
+            const glm::dvec3 p0{ vertices[i0].m_position };
+            const glm::dvec3 p1{ vertices[i1].m_position };
+            const glm::dvec3 p2{ vertices[i2].m_position };
+
+            auto         n{ glm::cross(p1 - p0, p2 - p0) };
+            const double length{ glm::length(n) };
+            if (length > 0.0) {
+                n /= length;
+                const auto quadric{ Quadric::fromPlane(n, -glm::dot(n, p0)) };
+                quadrics[i0] += quadric;
+                quadrics[i1] += quadric;
+                quadrics[i2] += quadric;
+            }
+
+            for (auto v : triangles[t]) {
+                vertexTriangles[v].push_back(t);
+            }
+        }
+
+        std::vector<bool>          removedTriangle(numTriangles, false);
+        std::vector<bool>          removedVertex(numVertices, false);
+        std::vector<std::uint32_t> stamps(numVertices, 0);
+        std::size_t                liveTriangles{ numTriangles };
+
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> queue;
+
+        const auto pushCollapse = [&](unsigned int from, unsigned int to) {
+            if (locked[from] || from == to) {
+                return;
+            }
+            const double cost{ (quadrics[from] + quadrics[to]).evaluate(vertices[to].m_position) };
+            queue.push({ cost, from, to, stamps[from], stamps[to] });
+        };
+
+        for (const auto& [i0, i1, i2] : triangles) {
+            pushCollapse(i0, i1), pushCollapse(i1, i0);
+            pushCollapse(i1, i2), pushCollapse(i2, i1);
+            pushCollapse(i2, i0), pushCollapse(i0, i2);
+        }
+
+        const double maxCost{ double(targetError) * double(targetError) };
+
+        while (liveTriangles * 3 > targetIndexCount && !queue.empty()) {
+            const auto [cost, from, to, fromStamp, toStamp]{ queue.top() };
+            queue.pop();
+
+            if (removedVertex[from] || removedVertex[to] || stamps[from] != fromStamp || stamps[to] != toStamp) {
+                continue;    // stale
+            }
+            if (cost > maxCost) {
+                break;
+            }
+            if (flipsTriangle(vertices, triangles, removedTriangle, vertexTriangles[from], from, to)) {
+                continue;
+            }
+
+            for (auto t : vertexTriangles[from]) {
+                if (removedTriangle[t]) {
+                    continue;
+                }
+                auto& triangle{ triangles[t] };
+                if (std::ranges::find(triangle, to) != triangle.end()) {
+                    removedTriangle[t] = true;    // the collapsed edge
+                    --liveTriangles;
+                } else {
+                    std::ranges::replace(triangle, from, to);
+                    vertexTriangles[to].push_back(t);
+                }
+            }
+
+            removedVertex[from]  = true;
+            quadrics[to]        += quadrics[from];
+            ++stamps[to];
+            error = std::max(error, static_cast<float>(std::sqrt(cost)));
+
+            // the quadric of 'to' changed: re-evaluate every collapse it takes part in
+            for (auto t : vertexTriangles[to]) {
+                if (removedTriangle[t]) {
+                    continue;
+                }
+                for (auto v : triangles[t]) {
+                    pushCollapse(v, to);
+                    pushCollapse(to, v);
+                }
+            }
+        }
+
+        std::vector<unsigned int> output;
+        output.reserve(liveTriangles * 3);
+        for (std::size_t t{ 0 }; t < numTriangles; ++t) {
+            if (!removedTriangle[t]) {
+                output.insert(output.end(), triangles[t].begin(), triangles[t].end());
+            }
+        }
+        return output;
+    }
+
+private:
+    // vertices alike in every attribute are merged into the first of them (in triangles), so they collapse as one
+    // surface; the ones left sharing a position then differ in some attribute, they are on a seam and get locked
+    // along with the ones on an open border
+    static std::vector<bool> findLockedVertices(
+        std::span<const Vertex>                   vertices,
+        std::vector<std::array<unsigned int, 3>>& triangles
+    )
+    {
+        const auto key = [](const glm::vec3& p) {
+            std::array<std::uint32_t, 3> bits;
+            std::memcpy(bits.data(), &p, sizeof(bits));
+            return (std::uint64_t(bits[0]) * 73856093) ^ (std::uint64_t(bits[1]) * 19349663)
+                 ^ (std::uint64_t(bits[2]) * 83492791);
+        };
+        const auto sameAttributes = [](const Vertex& a, const Vertex& b) {
+            return a.m_normal == b.m_normal && a.m_texCoords == b.m_texCoords && a.m_tangent == b.m_tangent
+                && a.m_bitangent == b.m_bitangent && a.m_joints == b.m_joints && a.m_weights == b.m_weights;
+        };
+
+        std::unordered_multimap<std::uint64_t, unsigned int> byPosition;    // the distinct vertices only
+        std::vector<unsigned int>                            welded(vertices.size());       // first at the position
+        std::vector<unsigned int>                            identical(vertices.size());    // first alike
+        std::vector<unsigned int>                            numDistinct(vertices.size(), 0);
+        for (unsigned int v{ 0 }; v < vertices.size(); ++v) {
+            welded[v]    = v;
+            identical[v] = v;
+
+            const auto hash{ key(vertices[v].m_position) };
+            const auto [begin, end]{ byPosition.equal_range(hash) };
+            for (auto it{ begin }; it != end; ++it) {
+                const auto other{ it->second };
+                if (vertices[other].m_position != vertices[v].m_position) {
+                    continue;
+                }
+                welded[v] = welded[other];
+                if (sameAttributes(vertices[other], vertices[v])) {
+                    identical[v] = other;
+                    break;
+                }
+            }
+            if (identical[v] == v) {
+                byPosition.emplace(hash, v);
+                ++numDistinct[welded[v]];
+            }
+        }
+
+        for (auto& triangle : triangles) {
+            for (auto& v : triangle) {
+                v = identical[v];
+            }
+        }
+
+        // an edge used by a single triangle is on a border
+        std::unordered_map<std::uint64_t, int> edgeUse;
+        const auto edgeKey = [&](unsigned int a, unsigned int b) {
+            a = welded[a], b = welded[b];
+            return a < b ? (std::uint64_t(a) << 32 | b) : (std::uint64_t(b) << 32 | a);
+        };
+        for (const auto& [i0, i1, i2] : triangles) {
+            ++edgeUse[edgeKey(i0, i1)];
+            ++edgeUse[edgeKey(i1, i2)];
+            ++edgeUse[edgeKey(i2, i0)];
+        }
+
+        std::vector<bool> locked(vertices.size(), false);
+        for (unsigned int v{ 0 }; v < vertices.size(); ++v) {
+            locked[v] = numDistinct[welded[v]] > 1;
+        }
+        for (const auto& [i0, i1, i2] : triangles) {
+            for (auto [a, b] : { std::array{ i0, i1 }, std::array{ i1, i2 }, std::array{ i2, i0 } }) {
+                if (edgeUse[edgeKey(a, b)] == 1) {
+                    locked[a] = locked[b] = true;
+                }
+            }
+        }
+
+        return locked;
+    }
+
+    // whether moving 'from' onto 'to' turns any of the remaining triangles around
+    static bool flipsTriangle(
+        std::span<const Vertex>                         vertices,
+        const std::vector<std::array<unsigned int, 3>>& triangles,
+        const std::vector<bool>&                        removedTriangle,
+        const std::vector<std::size_t>&                 fromTriangles,
+        unsigned int                                    from,
+        unsigned int                                    to
+    )
+    {
+        for (auto t : fromTriangles) {
+            const auto& triangle{ triangles[t] };
+            if (removedTriangle[t] || std::ranges::find(triangle, to) != triangle.end()) {
+                continue;
+            }
+
+            std::array<glm::vec3, 3> before;
+            std::array<glm::vec3, 3> after;
+            for (std::size_t i{ 0 }; i < 3; ++i) {
+                before[i] = vertices[triangle[i]].m_position;
+                after[i]  = vertices[triangle[i] == from ? to : triangle[i]].m_position;
+            }
+
+            const auto n0{ glm::cross(before[1] - before[0], before[2] - before[0]) };
+            const auto n1{ glm::cross(after[1] - after[0], after[2] - after[0]) };
+            if (glm::dot(n0, n1) <= 0.0f) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif /* end of include guard: MESH_SIMPLIFIER_HPP_QX7B2MRK */
@@ -0,0 +1,25 @@
+#ifndef PARALLEL_FOR_HPP_T4HB8NZC
+#define PARALLEL_FOR_HPP_T4HB8NZC
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+
+#include "common/old/job_system.hpp"
+
+// run func(0) .. func(count - 1) on the job system, the calling thread helping until they are all done; a few chunks
+// per thread so the ones that finish early can steal from the others
+template <std::invocable<std::size_t> Func>
+void parallelFor(std::size_t count, Func&& func)
+{
+    auto&      jobs{ JobSystem::instance() };
+    const auto grain{ std::max<std::size_t>(1, count / (4 * (jobs.getNumWorkers() + 1))) };
+
+    jobs.parallelFor(count, grain, [&func](std::size_t begin, std::size_t end) {
+        for (auto i{ begin }; i < end; ++i) {
+            func(i);
+        }
+    });
+}
+
+#endif /* end of include guard: PARALLEL_FOR_HPP_T4HB8NZC */
@@ -1,14 +1,20 @@
 #ifndef SCENE_HPP_XFKJA3VZ
 #define SCENE_HPP_XFKJA3VZ
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cmath>
 #include <cstdint>
 #include <format>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
@@ -20,13 +26,20 @@
 #include "common/old/window_manager.hpp"
 #include "common/old/cube.hpp"
 #include "common/old/camera.hpp"
+#include "common/old/fixed_update_loop.hpp"
 #include "common/old/shader.hpp"
 #include "common/old/texture.hpp"
 #include "common/old/stringified_enum.hpp"
 #include "common/old/scope_time_logger.hpp"
 #include "common/util/assets_path.hpp"
 
+#include "animation.hpp"
+#include "async_model_loader.hpp"
+#include "bvh.hpp"
+#include "frustum.hpp"
 #include "model.hpp"
+#include "parallel_for.hpp"
+#include "skinning.hpp"
 
 #define _UNIFORM_FIELD_EXPANDER(type, name) type name;
 #define _UNIFORM_APPLY_EXPANDER(type, name) shader.setUniform(m_name + "." #name, name);
@@ -101,6 +114,39 @@ struct SpotLight
 using LightsUsed = STRINGIFIED_ENUM_FLAG(LightsUsed, unsigned int, ENUM_FIELDS);
 #undef ENUM_FIELDS
 
+// what the update step advances; with the fixed update it lives on the update thread and render() draws between
+// its two latest ticks
+struct SceneState
+{
+    Camera m_camera;
+    double m_rotationTime{ 0.0 };    // of the instances, runs while rotating
+    float  m_animationTime{ 0.0f };
+
+    static SceneState interpolate(const SceneState& from, const SceneState& to, float alpha)
+    {
+        const auto& a{ from.m_camera };
+        const auto& b{ to.m_camera };
+
+        Camera camera{ {
+            .position    = glm::mix(a.m_position, b.m_position, alpha),
+            .worldUp     = b.m_worldUp,
+            .pitch       = glm::mix(a.m_pitch, b.m_pitch, alpha),
+            .yaw         = a.m_yaw + std::remainder(b.m_yaw - a.m_yaw, 360.0f) * alpha,    // the short way round
+            .fov         = glm::mix(a.m_fov, b.m_fov, alpha),
+            .speed       = b.m_speed,
+            .sensitivity = b.m_sensitivity,
+        } };
+        camera.setNear(b.m_near);
+        camera.setFar(b.m_far);
+
+        return {
+            .m_camera        = camera,
+            .m_rotationTime  = glm::mix(from.m_rotationTime, to.m_rotationTime, double(alpha)),
+            .m_animationTime = glm::mix(from.m_animationTime, to.m_animationTime, alpha),
+        };
+    }
+};
+
 class ImGuiLayer;
 
 class Scene
@@ -110,6 +156,11 @@ private:
 
     static inline auto s_assets_path = util::assets_path("3_model_loading");
 
+    static inline constexpr float s_instanceSpacing{ 5.0f };
+    static inline constexpr float s_instancePhase{ 0.37f };    // seconds between the animations of two instances
+
+    static inline constexpr double s_defaultTickRate{ 60.0 };
+
     // clang-format off
     static inline constexpr std::size_t s_numPointLights{ 4 };
     static inline constexpr std::array<glm::vec3, s_numPointLights> s_pointLightsPositions{ {
@@ -123,25 +174,51 @@ private:
     window::Window& m_window;
     glm::vec3       m_backgroundColor;
 
-    Camera                                   m_camera;
+    Camera                                   m_camera;    // as drawn this frame
+    SceneState                               m_state;     // without the fixed update
     Shader                                   m_modelShader;
     Shader                                   m_lightShader;
+    Shader                                   m_batchShader;
     Cube                                     m_lightCube;
     DirectionalLight                         m_directionalLight;
     std::array<PointLight, s_numPointLights> m_pointLights;
     SpotLight                                m_spotLight;
 
     // this chapter focus
-    Model     m_model;
-    glm::vec3 m_modelPos;
+    GeometryBatch               m_geometryBatch;
+    AsyncModelLoader            m_modelLoader;
+    std::shared_ptr<AsyncModel> m_model;    // shows up mesh by mesh while it loads, also merged into m_geometryBatch
+    glm::vec3                   m_modelPos;
+    int                         m_instancesPerSide{ 1 };    // a grid of instances of the model around m_modelPos
+    CullStats                   m_instanceCullStats;
+    CullStats                   m_meshCullStats;
+
+    // animated models only
+    SkinningPalette        m_skinningPalette;
+    std::vector<glm::mat4> m_palettes;
+    float                  m_animationBlend{ 0.0f };    // crossfade of each instance into the next clip
 
     UniformData<LightsUsed> u_activatedLights{ "u_enabledLightsFlag", LightsUsed::ALL };
 
     // options
-    bool m_drawWireFrame{ false };
-    bool m_invertRender{ false };
-    bool m_rotate{ false };
-    bool m_enableEmissionMap{ false };
+    bool              m_drawWireFrame{ false };
+    bool              m_invertRender{ false };
+    std::atomic<bool> m_rotate{ false };    // read by the update thread
+    bool              m_enableEmissionMap{ false };
+    bool              m_mergedDraw{ false };    // draw m_model from m_geometryBatch instead of mesh by mesh
+
+    // mouse input gathered on the window thread until the next update step takes it
+    struct LookInput
+    {
+        glm::vec2 m_offset{ 0.0f };
+        float     m_zoom{ 0.0f };
+    };
+
+    std::mutex m_lookMutex;
+    LookInput  m_lookInput;
+
+    // last, its thread uses the members above
+    std::optional<FixedUpdateLoop<SceneState>> m_fixedUpdate;
 
 public:
     Scene()                        = delete;
@@ -155,14 +232,19 @@ public:
         : m_window{ window }
         , m_backgroundColor{ 0.1f, 0.1f, 0.2f }
         , m_camera{ {} }
+        , m_state{ .m_camera = m_camera }
         , m_modelShader{
             s_assets_path / "shader/shader.vert",
             s_assets_path / "shader/shader.frag",
         }
         , m_lightShader{
-            s_assets_path / "shader/shader.vert",
+            s_assets_path / "shader/light_shader.vert",
             s_assets_path / "shader/light_shader.frag",
         }
+        , m_batchShader{
+            s_assets_path / "shader/batch_shader.vert",
+            s_assets_path / "shader/batch_shader.frag",
+        }
         , m_directionalLight{
             .m_name      = "u_directionalLight",
             .m_direction = { -0.2f, -1.0f, -0.3f },
@@ -184,14 +266,12 @@ public:
             .m_linear      = 0.09f,
             .m_quadratic   = 0.032f,
         }
-        , m_model{ [] {
-            const std::string modelPath{ s_assets_path / "model/backpack/backpack.obj" };
-            auto              maybeModel{ Model::load(modelPath) };
-            if (!maybeModel) {
-                throw std::runtime_error{ std::format("Failed to load model from {}", modelPath) };
-            }
-            return std::move(maybeModel.value());
-        }() }
+        , m_modelLoader{ window }
+        , m_model{ m_modelLoader.load(
+              s_assets_path / "model/backpack/backpack.obj",
+              { .m_batch = &m_geometryBatch },
+              logLoadProgress
+          ) }
     {
 
         for (std::size_t i{ 0 }; i < s_numPointLights; ++i) {
@@ -235,11 +315,17 @@ public:
     {
         gl::glEnable(gl::GL_DEPTH_TEST);
 
+        for (auto* shader : { &m_modelShader, &m_batchShader }) {
+            shader->use();
+            m_directionalLight.applyUniforms(*shader);
+            m_spotLight.applyUniforms(*shader);
+            for (auto& light : m_pointLights) { light.applyUniforms(*shader); }
+            shader->setUniform(u_activatedLights.m_name, u_activatedLights.m_value.base());
+        }
+
+        // the buffer sampler must not be left on unit 0, next to the 2d samplers of the meshes
         m_modelShader.use();
-        m_directionalLight.applyUniforms(m_modelShader);
-        m_spotLight.applyUniforms(m_modelShader);
-        for (auto& light : m_pointLights) { light.applyUniforms(m_modelShader); }
-        m_modelShader.setUniform(u_activatedLights.m_name, u_activatedLights.m_value.base());
+        m_modelShader.setUniform("u_palette", SkinningPalette::s_textureUnit);
     }
 
     void render()
@@ -252,15 +338,22 @@ public:
         const auto& winProp{ m_window.getProperties() };
         gl::glViewport(0, 0, winProp.m_width, winProp.m_height);
 
+        // pick up the meshes the loader finished since last frame
+        m_model->update();
+
+        const auto state{ advance() };
+        m_camera = state.m_camera;
+
         auto      view{ m_camera.getViewMatrix() };
         auto      projection{ m_camera.getProjectionMatrix(m_window.getProperties().m_width, m_window.getProperties().m_height) };
         glm::mat4 model{ 1.0f };
 
-        m_modelShader.use();
-        m_directionalLight.applyUniforms(m_modelShader);
-        m_spotLight.applyUniforms(m_modelShader);
-        for (auto& light : m_pointLights) { light.applyUniforms(m_modelShader); }
-        m_modelShader.setUniform(u_activatedLights.m_name, u_activatedLights.m_value.base());
+        auto& modelShader{ m_mergedDraw ? m_batchShader : m_modelShader };
+        modelShader.use();
+        m_directionalLight.applyUniforms(modelShader);
+        m_spotLight.applyUniforms(modelShader);
+        for (auto& light : m_pointLights) { light.applyUniforms(modelShader); }
+        modelShader.setUniform(u_activatedLights.m_name, u_activatedLights.m_value.base());
 
         //----------------[ light cube object ]-----------------
         m_lightShader.use();
@@ -279,29 +372,205 @@ public:
         //------------------------------------------------------
 
         //----------------[ cube container object ]-----------------
-        m_modelShader.use();
-        m_modelShader.setUniform("u_viewPos", m_camera.m_position);
-        m_modelShader.setUniform("u_view", view);
-        m_modelShader.setUniform("u_projection", projection);
-
-        static double lastTime{ 0.0 };    // yeah, this local static variable is not good, but eh, once is ok
-        if (m_rotate) { lastTime += m_window.getDeltaTime(); }
+        modelShader.use();
+        modelShader.setUniform("u_viewPos", m_camera.m_position);
+        modelShader.setUniform("u_view", view);
+        modelShader.setUniform("u_projection", projection);
 
-        glm::vec3 rotationAxis{
+        const auto lastTime{ state.m_rotationTime };
+        glm::vec3  rotationAxis{
             std::sin(lastTime * 2 + 60),
             std::cos(lastTime / 100),
             std::atan(lastTime)
         };
-        model = glm::mat4{ 1.0f };
-        model = glm::translate(glm::mat4{ 1.0f }, m_modelPos);
-        model = glm::rotate(model, (float)lastTime, glm::normalize(rotationAxis));
-        m_modelShader.setUniform("u_model", model);
+        const auto& drawnModel{ m_model->get() };
+        const auto  modelBounds{ drawnModel.getBounds() };
+
+        // the matrices and bounds are built on the job system, this thread helping
+        const auto             perSide{ static_cast<std::size_t>(m_instancesPerSide) };
+        std::vector<glm::mat4> instances(perSide * perSide);
+        std::vector<Bounds>    instanceBounds(instances.size());
+        parallelFor(instances.size(), [&](std::size_t i) {
+            const auto      x{ float(i % perSide) };
+            const auto      z{ float(i / perSide) };
+            const glm::vec3 offset{ (x - float(perSide - 1) / 2.0f), 0.0f, -z };
+
+            auto instance{ glm::translate(glm::mat4{ 1.0f }, m_modelPos + offset * s_instanceSpacing) };
+            instance          = glm::rotate(instance, (float)lastTime, glm::normalize(rotationAxis));
+            instances[i]      = instance;
+            instanceBounds[i] = Bvh::transform(modelBounds, instance);
+        });
+
+        // the instances move, so the bvh over them is rebuilt every frame; the one over the meshes of the model is not
+        const Bvh instanceBvh{ instanceBounds };
+
+        std::vector<std::size_t> visible;
+        m_instanceCullStats = instanceBvh.cull(Frustum{ projection * view }, [&](std::size_t i) {
+            visible.push_back(i);
+        });
+
+        // only the visible instances are animated, and all their palettes go to the gpu at once; the merged geometry
+        // has no joints
+        const auto& skeleton{ drawnModel.getSkeleton() };
+        const bool  skinned{ !m_mergedDraw && skeleton };
+        const bool  animated{ skinned && !drawnModel.getClips().empty() };
+        if (animated) {
+            animateInstances(*skeleton, drawnModel.getClips(), visible, state.m_animationTime);
+        } else if (skinned) {
+            uploadBindPose(*skeleton);
+            modelShader.setUniform("u_paletteOffset", 0);
+        }
+        if (skinned) {
+            m_skinningPalette.bind(modelShader);
+        }
 
-        m_model.draw(m_modelShader);
+        m_meshCullStats = {};
+        if (m_mergedDraw) {
+            // every instance gets its own commands, all uploaded at once before the first one is drawn
+            m_geometryBatch.beginFrame();
+            std::vector<GeometryBatch::Region> regions;
+            regions.reserve(visible.size());
+            for (auto i : visible) {
+                const auto [region, stats]{
+                    drawnModel.addToBatchFrame(instances[i], m_camera, winProp.m_width, winProp.m_height)
+                };
+                regions.push_back(region);
+                m_meshCullStats += stats;
+            }
+            for (std::size_t k{ 0 }; k < visible.size(); ++k) {
+                modelShader.setUniform("u_model", instances[visible[k]]);
+                m_geometryBatch.draw(modelShader, regions[k]);
+            }
+        } else {
+            for (std::size_t k{ 0 }; k < visible.size(); ++k) {
+                const auto i{ visible[k] };
+                modelShader.setUniform("u_model", instances[i]);
+                if (animated) {
+                    modelShader.setUniform("u_paletteOffset", static_cast<int>(k * skeleton->getNumJoints()));
+                }
+                m_meshCullStats += drawnModel.draw(
+                    modelShader,
+                    instances[i],
+                    m_camera,
+                    winProp.m_width,
+                    winProp.m_height
+                );
+            }
+        }
         //----------------------------------------------------------
     }
 
+    // nullopt: render() updates the scene by the frame time; otherwise an update thread does, `tickRate` times a
+    // second. the state carries over from one mode to the other
+    // @thread_safety: call this function from the window thread
+    void setFixedUpdate(std::optional<double> tickRate)
+    {
+        if (m_fixedUpdate) {
+            m_state = m_fixedUpdate->stop();
+            m_fixedUpdate.reset();
+        }
+        if (tickRate) {
+            m_fixedUpdate.emplace(m_state, *tickRate, [this](SceneState& state, double deltaTime) {
+                update(state, deltaTime);
+            });
+        }
+    }
+
+    bool isFixedUpdate() const { return m_fixedUpdate.has_value(); }
+
 private:
+    // the state to draw this frame
+    SceneState advance()
+    {
+        if (!m_fixedUpdate) {
+            update(m_state, m_window.getDeltaTime());
+            return m_state;
+        }
+
+        const auto [previous, current, alpha]{ m_fixedUpdate->read() };
+        return SceneState::interpolate(previous, current, alpha);
+    }
+
+    // one step of everything that moves; the keys held and the gathered mouse input can be read from any thread
+    void update(SceneState& state, double deltaTime)
+    {
+        // clang-format off
+        static constexpr std::array<std::pair<int, Camera::Movement>, 6> movements{ {
+            { GLFW_KEY_W,          Camera::Movement::FORWARD  },
+            { GLFW_KEY_S,          Camera::Movement::BACKWARD },
+            { GLFW_KEY_A,          Camera::Movement::LEFT     },
+            { GLFW_KEY_D,          Camera::Movement::RIGHT    },
+            { GLFW_KEY_LEFT_SHIFT, Camera::Movement::DOWNWARD },
+            { GLFW_KEY_SPACE,      Camera::Movement::UPWARD   },
+        } };
+        // clang-format on
+
+        for (const auto& [key, movement] : movements) {
+            if (m_window.isKeyDown(key)) {
+                state.m_camera.moveCamera(movement, static_cast<float>(deltaTime));
+            }
+        }
+
+        LookInput look;
+        {
+            std::scoped_lock lock{ m_lookMutex };
+            look = std::exchange(m_lookInput, {});
+        }
+        if (look.m_offset != glm::vec2{ 0.0f }) {
+            state.m_camera.lookAround(look.m_offset.x, look.m_offset.y);
+        }
+        if (look.m_zoom != 0.0f) {
+            state.m_camera.updatePerspective(look.m_zoom);
+        }
+
+        if (m_rotate) { state.m_rotationTime += deltaTime; }
+        state.m_animationTime += static_cast<float>(deltaTime);
+    }
+
+    // every instance plays the clips with its own phase, crossfading into the next one by m_animationBlend
+    void animateInstances(
+        const Skeleton&                   skeleton,
+        const std::vector<AnimationClip>& clips,
+        std::span<const std::size_t>      instances,
+        float                             animationTime
+    )
+    {
+        std::vector<AnimationState> states;
+        states.reserve(instances.size());
+        for (auto i : instances) {
+            const float time{ animationTime + float(i) * s_instancePhase };
+            states.push_back({
+                .m_clip        = i % clips.size(),
+                .m_time        = time,
+                .m_blendClip   = (i + 1) % clips.size(),
+                .m_blendTime   = time,
+                .m_blendWeight = m_animationBlend,
+            });
+        }
+
+        m_palettes.resize(states.size() * skeleton.getNumJoints());
+        Animation::evaluate(skeleton, clips, states, m_palettes);
+        m_skinningPalette.upload(m_palettes);
+    }
+
+    // a rigged model without clips stands in its bind pose, one palette shared by every instance
+    void uploadBindPose(const Skeleton& skeleton)
+    {
+        Pose pose{ skeleton.getNumJoints() };
+        std::ranges::copy(skeleton.m_bindPose, pose.data().begin());
+
+        m_palettes.resize(skeleton.getNumJoints());
+        Animation::computePalette(skeleton, pose, m_palettes);
+        m_skinningPalette.upload(m_palettes);
+    }
+
+    static void logLoadProgress(const AsyncModel::Progress& progress)
+    {
+        if (progress.m_stage == AsyncModel::Stage::DONE) {
+            std::cout << std::format("INFO: [Scene] Model loaded ({} meshes)\n", progress.m_total);
+        }
+    }
+
     void setWindowEventsHandler()
     {
         using enum window::Window::KeyActionType;
@@ -339,6 +608,14 @@ private:
             .addKeyEventHandler(GLFW_KEY_E, GLFW_MOD_ALT, CALLBACK, [this](window::Window& /* win */) {
                 m_modelShader.setUniform("u_enableEmissionMap", (m_enableEmissionMap = !m_enableEmissionMap));
             })
+            // merged draw
+            .addKeyEventHandler(GLFW_KEY_M, GLFW_MOD_ALT, CALLBACK, [this](window::Window& /* win */) {
+                m_mergedDraw = !m_mergedDraw;
+            })
+            // fixed update thread
+            .addKeyEventHandler(GLFW_KEY_U, GLFW_MOD_ALT, CALLBACK, [this](window::Window& /* win */) {
+                setFixedUpdate(isFixedUpdate() ? std::nullopt : std::optional{ s_defaultTickRate });
+            })
             // capture mouse
             .addKeyEventHandler(GLFW_KEY_C, GLFW_MOD_ALT, CALLBACK, [](window::Window& win) {
                 win.setCaptureMouse(!win.isMouseCaptured());
@@ -348,31 +625,13 @@ private:
                 win.requestClose();
             });
 
-        // camera movements (translation)
-        m_window
-            .addKeyEventHandler(GLFW_KEY_W, 0, CONTINUOUS, [this](window::Window& win) {
-                m_camera.moveCamera(Camera::Movement::FORWARD, static_cast<float>(win.getDeltaTime()));
-            })
-            .addKeyEventHandler(GLFW_KEY_S, 0, CONTINUOUS, [this](window::Window& win) {
-                m_camera.moveCamera(Camera::Movement::BACKWARD, static_cast<float>(win.getDeltaTime()));
-            })
-            .addKeyEventHandler(GLFW_KEY_A, 0, CONTINUOUS, [this](window::Window& win) {
-                m_camera.moveCamera(Camera::Movement::LEFT, static_cast<float>(win.getDeltaTime()));
-            })
-            .addKeyEventHandler(GLFW_KEY_D, 0, CONTINUOUS, [this](window::Window& win) {
-                m_camera.moveCamera(Camera::Movement::RIGHT, static_cast<float>(win.getDeltaTime()));
-            })
-            .addKeyEventHandler(GLFW_KEY_LEFT_SHIFT, 0, CONTINUOUS, [this](window::Window& win) {
-                m_camera.moveCamera(Camera::Movement::DOWNWARD, static_cast<float>(win.getDeltaTime()));
-            })
-            .addKeyEventHandler(GLFW_KEY_SPACE, 0, CONTINUOUS, [this](window::Window& win) {
-                m_camera.moveCamera(Camera::Movement::UPWARD, static_cast<float>(win.getDeltaTime()));
-            });
-
-        // camera control (rotation and zoom)
+        // camera control (rotation and zoom), applied by the next update step like the movements (see update())
         m_window
             .setScrollCallback([this](window::Window& window, double /* xOffset */, double yOffset) {
-                if (window.isMouseCaptured()) { m_camera.updatePerspective(static_cast<float>(yOffset)); }
+                if (window.isMouseCaptured()) {
+                    std::scoped_lock lock{ m_lookMutex };
+                    m_lookInput.m_zoom += static_cast<float>(yOffset);
+                }
             })
             .setCursorPosCallback([this](window::Window& window, double xPos, double yPos) {
                 auto& winProp{ window.getProperties() };
@@ -385,7 +644,8 @@ private:
                 lastY         = yPos;
 
                 if (window.isMouseCaptured()) {
-                    m_camera.lookAround(xoffset, yoffset);
+                    std::scoped_lock lock{ m_lookMutex };
+                    m_lookInput.m_offset += glm::vec2{ xoffset, yoffset };
                 }
             });
     }
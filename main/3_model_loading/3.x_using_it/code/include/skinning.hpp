@@ -0,0 +1,188 @@
+#ifndef SKINNING_HPP_W7CE3LUN
+#define SKINNING_HPP_W7CE3LUN
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "common/old/shader.hpp"
+
+#include "animation.hpp"
+#include "mesh.hpp"
+
+/*
+ * The skinning matrices of every animated instance of a frame, in one buffer texture (a matrix is four RGBA32F
+ * texels) the vertex shader reads as u_palette. The whole buffer is respecified every frame, so the driver hands
+ * out fresh storage instead of waiting for the frames still reading the old one; each instance only sets its
+ * u_paletteOffset.
+ */
+class SkinningPalette
+{
+public:
+    // away from the units the meshes use for their textures
+    static inline constexpr gl::GLint s_textureUnit{ 15 };
+
+private:
+    gl::GLuint m_buffer{};
+    gl::GLuint m_texture{};
+
+public:
+    SkinningPalette(const SkinningPalette&)            = delete;
+    SkinningPalette& operator=(const SkinningPalette&) = delete;
+    SkinningPalette(SkinningPalette&&)                 = delete;
+    SkinningPalette& operator=(SkinningPalette&&)      = delete;
+
+    // needs a current context
+    SkinningPalette()
+    {
+        using namespace gl;
+
+        glGenBuffers(1, &m_buffer);
+        glGenTextures(1, &m_texture);
+
+        // a name only becomes a buffer object once bound, and glTexBuffer wants a buffer object
+        glBindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    ~SkinningPalette()
+    {
+        using namespace gl;
+
+        glDeleteBuffers(1, &m_buffer);
+        glDeleteTextures(1, &m_texture);
+    }
+
+    void upload(std::span<const glm::mat4> matrices)
+    {
+        using namespace gl;
+
+        glBindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+        glBufferData(
+            GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(matrices.size_bytes()), matrices.data(), GL_STREAM_DRAW
+        );
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // the shader must be in use
+    void bind(Shader& shader) const
+    {
+        using namespace gl;
+
+        glActiveTexture(GL_TEXTURE0 + std::underlying_type_t<GLenum>(s_textureUnit));
+        glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+        shader.setUniform("u_palette", s_textureUnit);
+    }
+};
+
+// the same skinning as the vertex shader, for when nothing runs it (headless runs, checking a pose on the cpu)
+class CpuSkinning
+{
+public:
+    CpuSkinning() = delete;
+
+    // positions and normals of the vertices posed by palette; the outputs have one element per vertex
+    static void skin(
+        std::span<const Vertex>    vertices,
+        std::span<const glm::mat4> palette,
+        std::span<glm::vec3>       positions,
+        std::span<glm::vec3>       normals
+    )
+    {
+        for (std::size_t i{ 0 }; i < vertices.size(); ++i) {
+            const auto& vertex{ vertices[i] };
+            glm::mat4 matrix{ 0.0f };
+            for (std::size_t k{ 0 }; k < Vertex::s_maxBoneInfluence; ++k) {
+                matrix += palette[vertex.m_joints[k]] * vertex.m_weights[k];
+            }
+            positions[i] = glm::vec3{ matrix * glm::vec4{ vertex.m_position, 1.0f } };
+            normals[i]   = glm::normalize(glm::mat3{ matrix } * vertex.m_normal);
+        }
+    }
+
+    // samples a two joint rig halfway through a clip turning its second joint about z from 0 to 180 degrees, skins a
+    // few vertices with the palette and compares them with the pose worked out by hand
+    static bool check()
+    {
+        const Skeleton skeleton{
+            .m_parents     = { -1, 0 },
+            .m_inverseBind = { glm::mat4{ 1.0f }, glm::translate(glm::mat4{ 1.0f }, { 0.0f, -1.0f, 0.0f }) },
+            .m_bindPose    = {},
+        };
+
+        // the second joint sits one unit above the first
+        const auto frame = [](float rz, float rw) {
+            Pose pose{ 2 };
+            pose.channel(Pose::TY)[1] = 1.0f;
+            pose.channel(Pose::RW)[0] = 1.0f;
+            pose.channel(Pose::RZ)[1] = rz;
+            pose.channel(Pose::RW)[1] = rw;
+            for (auto c : { Pose::SX, Pose::SY, Pose::SZ }) {
+                std::ranges::fill(pose.channel(c), 1.0f);
+            }
+            return pose;
+        };
+
+        AnimationClip clip{ .m_name = "check", .m_frameRate = 1.0f, .m_numFrames = 2, .m_frames = {} };
+        for (const auto& pose : { frame(0.0f, 1.0f), frame(1.0f, 0.0f) }) {
+            clip.m_frames.insert(clip.m_frames.end(), pose.data().begin(), pose.data().end());
+        }
+
+        Pose pose{ 2 };
+        Animation::sample(clip, 0.5f, pose);
+
+        std::array<glm::mat4, 2> palette;
+        Animation::computePalette(skeleton, pose, palette);
+
+        // on the first joint, shared half and half, on the second joint
+        std::array<Vertex, 3> vertices{};
+        vertices[0].m_position = { 0.5f, 0.0f, 0.0f };
+        vertices[0].m_normal   = { 0.0f, 0.0f, 1.0f };
+        vertices[0].m_weights  = { 1.0f, 0.0f, 0.0f, 0.0f };
+        vertices[1].m_position = { 1.0f, 1.0f, 0.0f };
+        vertices[1].m_normal   = { 1.0f, 0.0f, 0.0f };
+        vertices[1].m_joints   = { 0, 1, 0, 0 };
+        vertices[1].m_weights  = { 0.5f, 0.5f, 0.0f, 0.0f };
+        vertices[2].m_position = { 0.0f, 2.0f, 0.0f };
+        vertices[2].m_normal   = { 0.0f, 1.0f, 0.0f };
+        vertices[2].m_joints   = { 1, 0, 0, 0 };
+        vertices[2].m_weights  = { 1.0f, 0.0f, 0.0f, 0.0f };
+
+        const std::array<glm::vec3, 3> expectedPositions{ {
+            { 0.5f, 0.0f, 0.0f },
+            { 0.5f, 1.5f, 0.0f },
+            { -1.0f, 1.0f, 0.0f },
+        } };
+        const std::array<glm::vec3, 3> expectedNormals{ {
+            { 0.0f, 0.0f, 1.0f },
+            glm::normalize(glm::vec3{ 1.0f, 1.0f, 0.0f }),
+            { -1.0f, 0.0f, 0.0f },
+        } };
+
+        std::array<glm::vec3, 3> positions;
+        std::array<glm::vec3, 3> normals;
+        skin(vertices, palette, positions, normals);
+
+        constexpr float tolerance{ 1e-4f };
+        for (std::size_t i{ 0 }; i < vertices.size(); ++i) {
+            if (glm::length(positions[i] - expectedPositions[i]) > tolerance
+                || glm::length(normals[i] - expectedNormals[i]) > tolerance) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif /* end of include guard: SKINNING_HPP_W7CE3LUN */
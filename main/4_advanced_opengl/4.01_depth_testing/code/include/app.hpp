@@ -40,7 +40,7 @@ public:
     {
         if (s_instance) { return; }
 
-        if (!glfwInit()) {
+        if (!window::WindowManager::initGlfw()) {
             std::cerr << "Failed to initialize GLFW\n";
             return;
         }
@@ -136,7 +136,7 @@ private:
             PRETTY_FUNCTION_TIME_LOG_WITH_ARG("pollEvents");
 
             using window::operator""_fps;
-            windowManager.pollEvents(120_fps);
+            windowManager.waitEventsTimeout(120_fps);
         }
     }
 };
@@ -25,7 +25,7 @@
 #include "common/old/plane.hpp"
 #include "common/old/camera.hpp"
 #include "common/old/shader.hpp"
-#include "common/old/image_texture.hpp"
+#include "common/old/texture_cache.hpp"
 #include "common/old/stringified_enum.hpp"
 #include "common/old/scope_time_logger.hpp"
 #include "common/util/assets_path.hpp"
@@ -51,10 +51,10 @@ struct UniformData
 
 struct Material
 {
-    std::string  m_name;
-    ImageTexture m_diffuse;
-    ImageTexture m_specular;
-    float        m_shininess;
+    std::string          m_name;
+    TextureCache::Handle m_diffuse;
+    TextureCache::Handle m_specular;
+    float                m_shininess;
 
     Material(
         const std::string&    name,
@@ -63,16 +63,16 @@ struct Material
         float                 shininess
     )
         : m_name{ name }
-        , m_diffuse{ ImageTexture::from(diffuseMap, m_name + ".m_diffuse", 0).value() }       // unwrap
-        , m_specular{ ImageTexture::from(specularMap, m_name + ".m_specular", 1).value() }    // unwrap
+        , m_diffuse{ TextureCache::instance().load(diffuseMap).value() }      // unwrap
+        , m_specular{ TextureCache::instance().load(specularMap).value() }    // unwrap
         , m_shininess{ shininess }
     {
     }
 
     void applyUniform(Shader& shader) const
     {
-        m_diffuse.activate(shader);
-        m_specular.activate(shader);
+        m_diffuse->activate(shader, m_name + ".m_diffuse", 0);
+        m_specular->activate(shader, m_name + ".m_specular", 1);
         shader.setUniform(m_name + ".m_shininess", m_shininess);
     }
 };
@@ -1,12 +1,19 @@
 #version 330 core
 
+struct TextureSlot
+{
+    float m_layer;
+    vec4  m_uvRect;    // xy: offset, zw: scale
+};
+
 out vec4 o_fragColor;
 
 in vec2 io_texCoords;
 
-uniform sampler2D u_texture;
+uniform sampler2DArray u_textures;
+uniform TextureSlot    u_texture;
 
 void main()
 {
-    o_fragColor = texture(u_texture, io_texCoords);
+    o_fragColor = texture(u_textures, vec3(u_texture.m_uvRect.xy + io_texCoords * u_texture.m_uvRect.zw, u_texture.m_layer));
 }
@@ -26,7 +26,7 @@
 #include "common/old/plane.hpp"
 #include "common/old/camera.hpp"
 #include "common/old/shader.hpp"
-#include "common/old/image_texture.hpp"
+#include "common/old/texture_array.hpp"
 #include "common/old/stringified_enum.hpp"
 #include "common/old/scope_time_logger.hpp"
 #include "common/util/assets_path.hpp"
@@ -52,28 +52,30 @@ struct UniformData
 
 struct Material
 {
-    std::string  m_name;
-    ImageTexture m_diffuse;
-    ImageTexture m_specular;
-    float        m_shininess;
+    std::string m_name;
+    TextureSlot m_diffuse;
+    TextureSlot m_specular;
+    float       m_shininess;
 
     Material(
-        const std::string&    name,
-        std::filesystem::path diffuseMap,
-        std::filesystem::path specularMap,
-        float                 shininess
+        const std::string&           name,
+        const TextureArray&          textures,
+        const std::filesystem::path& diffuseMap,
+        const std::filesystem::path& specularMap,
+        float                        shininess
     )
         : m_name{ name }
-        , m_diffuse{ ImageTexture::from(diffuseMap, m_name + ".m_diffuse", 0).value() }       // unwrap
-        , m_specular{ ImageTexture::from(specularMap, m_name + ".m_specular", 1).value() }    // unwrap
+        , m_diffuse{ textures.getSlot(diffuseMap).value() }      // unwrap
+        , m_specular{ textures.getSlot(specularMap).value() }    // unwrap
         , m_shininess{ shininess }
     {
     }
 
+    // the texture array is bound by the scene, a material only selects its slots in it
     void applyUniform(Shader& shader) const
     {
-        m_diffuse.activate(shader);
-        m_specular.activate(shader);
+        m_diffuse.applyUniforms(shader, m_name + ".m_diffuse");
+        m_specular.applyUniforms(shader, m_name + ".m_specular");
         shader.setUniform(m_name + ".m_shininess", m_shininess);
     }
 };
@@ -189,10 +191,11 @@ private:
     Shader                                   m_windowShader;
     Cube                                     m_cube;
     Plane                                    m_plane;
+    TextureArray                             m_textures;
     Material                                 m_cubeMaterial;
     Material                                 m_floorMaterial;
-    ImageTexture                             m_grassTexture;
-    ImageTexture                             m_windowTexture;
+    TextureSlot                              m_grassTexture;
+    TextureSlot                              m_windowTexture;
     DirectionalLight                         m_directionalLight;
     std::array<PointLight, s_numPointLights> m_pointLights;
     SpotLight                                m_spotLight;
@@ -245,20 +248,23 @@ public:
         }
         , m_cube{ 1.0f }
         , m_plane{ 1.0f }
+        , m_textures{ packTextures() }
         , m_cubeMaterial{
             /* .m_name      = */ "u_material",
+            /* .m_textures  = */ m_textures,
             /* .m_diffuse   = */ s_assets_path / "texture/metal.png",
             /* .m_specular  = */ s_assets_path / "texture/metal.png",
             /* .m_shininess = */ 128.0f,
         }
         , m_floorMaterial{
             /* .m_name      = */ "u_material",
+            /* .m_textures  = */ m_textures,
             /* .m_diffuse   = */ s_assets_path / "texture/marble.jpg",
             /* .m_specular  = */ s_assets_path / "texture/marble.jpg",
             /* .m_shininess = */ 32.0f,
         }
-        , m_grassTexture{ ImageTexture::from(s_assets_path / "texture/grass.png", "u_texture", 0).value() }      // skip optional check
-        , m_windowTexture{ ImageTexture::from(s_assets_path / "texture/window.png", "u_texture", 0).value() }    // skip optional check
+        , m_grassTexture{ m_textures.getSlot(s_assets_path / "texture/grass.png").value() }      // skip optional check
+        , m_windowTexture{ m_textures.getSlot(s_assets_path / "texture/window.png").value() }    // skip optional check
         , m_directionalLight{
             .m_name      = "u_directionalLight",
             .m_direction = { -0.2f, -1.0f, -0.3f },
@@ -342,6 +348,12 @@ public:
         m_shader.setUniform(u_enableDepthOutput.m_name, u_enableDepthOutput.m_value);
         m_shader.setUniform(u_invertDepthOutput.m_name, u_invertDepthOutput.m_value);
 
+        // every textured object samples from the same array on the same unit
+        for (auto* shader : { &m_shader, &m_grassShader, &m_windowShader }) {
+            shader->use();
+            shader->setUniform(m_textures.getUniformName(), m_textures.getUnitNum());
+        }
+
         // stencil
         gl::glEnable(gl::GL_STENCIL_TEST);
         gl::glClearStencil(0x01);
@@ -380,6 +392,8 @@ public:
 
         updateUniforms();
 
+        m_textures.bind();    // bound once for all the draw groups below
+
         drawFloor(view, projection);
         drawCube(view, projection);
         drawGrass(view, projection);
@@ -514,7 +528,7 @@ private:
         m_grassShader.use();
         m_grassShader.setUniform("u_view", view);
         m_grassShader.setUniform("u_projection", projection);
-        m_grassTexture.activate(m_grassShader);
+        m_grassTexture.applyUniforms(m_grassShader, "u_texture");
 
         for (const auto& pos : s_grassPositions) {
             auto transform{ glm::translate(glm::mat4{ 1.0f }, pos) };
@@ -536,7 +550,7 @@ private:
         m_windowShader.use();
         m_windowShader.setUniform("u_view", view);
         m_windowShader.setUniform("u_projection", projection);
-        m_windowTexture.activate(m_windowShader);
+        m_windowTexture.applyUniforms(m_windowShader, "u_texture");
 
         // sort from furthest to nearest
         std::vector<glm::vec3> windowPositions_sorted(s_windowPositions.begin(), s_windowPositions.end());
@@ -553,6 +567,15 @@ private:
         }
     }
 
+    static TextureArray packTextures()
+    {
+        TextureArrayPacker packer;
+        for (auto name : { "metal.png", "marble.jpg", "grass.png", "window.png" }) {
+            packer.add(s_assets_path / "texture" / name);
+        }
+        return packer.pack("u_textures", 0).value();    // skip optional check
+    }
+
     void setWindowEventsHandler()
     {
         using enum window::Window::KeyActionType;
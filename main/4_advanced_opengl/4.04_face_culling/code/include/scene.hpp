@@ -26,7 +26,7 @@
 #include "common/old/plane.hpp"
 #include "common/old/camera.hpp"
 #include "common/old/shader.hpp"
-#include "common/old/image_texture.hpp"
+#include "common/old/texture_cache.hpp"
 #include "common/old/stringified_enum.hpp"
 #include "common/old/scope_time_logger.hpp"
 #include "common/util/assets_path.hpp"
@@ -52,10 +52,10 @@ struct UniformData
 
 struct Material
 {
-    std::string  m_name;
-    ImageTexture m_diffuse;
-    ImageTexture m_specular;
-    float        m_shininess;
+    std::string          m_name;
+    TextureCache::Handle m_diffuse;
+    TextureCache::Handle m_specular;
+    float                m_shininess;
 
     Material(
         const std::string&    name,
@@ -64,16 +64,16 @@ struct Material
         float                 shininess
     )
         : m_name{ name }
-        , m_diffuse{ ImageTexture::from(diffuseMap, m_name + ".m_diffuse", 0).value() }       // unwrap
-        , m_specular{ ImageTexture::from(specularMap, m_name + ".m_specular", 1).value() }    // unwrap
+        , m_diffuse{ TextureCache::instance().load(diffuseMap).value() }      // unwrap
+        , m_specular{ TextureCache::instance().load(specularMap).value() }    // unwrap
         , m_shininess{ shininess }
     {
     }
 
     void applyUniform(Shader& shader) const
     {
-        m_diffuse.activate(shader);
-        m_specular.activate(shader);
+        m_diffuse->activate(shader, m_name + ".m_diffuse", 0);
+        m_specular->activate(shader, m_name + ".m_specular", 1);
         shader.setUniform(m_name + ".m_shininess", m_shininess);
     }
 };
@@ -191,8 +191,8 @@ private:
     Plane                                    m_plane;
     Material                                 m_cubeMaterial;
     Material                                 m_floorMaterial;
-    ImageTexture                             m_grassTexture;
-    ImageTexture                             m_windowTexture;
+    TextureCache::Handle                     m_grassTexture;
+    TextureCache::Handle                     m_windowTexture;
     DirectionalLight                         m_directionalLight;
     std::array<PointLight, s_numPointLights> m_pointLights;
     SpotLight                                m_spotLight;
@@ -257,8 +257,8 @@ public:
             /* .m_specular  = */ s_assets_path / "texture/marble.jpg",
             /* .m_shininess = */ 32.0f,
         }
-        , m_grassTexture{ ImageTexture::from(s_assets_path / "texture/grass.png", "u_texture", 0).value() }      // skip optional check
-        , m_windowTexture{ ImageTexture::from(s_assets_path / "texture/window.png", "u_texture", 0).value() }    // skip optional check
+        , m_grassTexture{ TextureCache::instance().load(s_assets_path / "texture/grass.png").value() }      // skip optional check
+        , m_windowTexture{ TextureCache::instance().load(s_assets_path / "texture/window.png").value() }    // skip optional check
         , m_directionalLight{
             .m_name      = "u_directionalLight",
             .m_direction = { -0.2f, -1.0f, -0.3f },
@@ -526,7 +526,7 @@ private:
         m_grassShader.use();
         m_grassShader.setUniform("u_view", view);
         m_grassShader.setUniform("u_projection", projection);
-        m_grassTexture.activate(m_grassShader);
+        m_grassTexture->activate(m_grassShader, "u_texture", 0);
 
         bool cullEnabled{ gl::glIsEnabled(gl::GL_CULL_FACE) };
         if (cullEnabled) {
@@ -559,7 +559,7 @@ private:
         m_windowShader.use();
         m_windowShader.setUniform("u_view", view);
         m_windowShader.setUniform("u_projection", projection);
-        m_windowTexture.activate(m_windowShader);
+        m_windowTexture->activate(m_windowShader, "u_texture", 0);
 
         bool cullEnabled{ gl::glIsEnabled(gl::GL_CULL_FACE) };
         if (cullEnabled) {
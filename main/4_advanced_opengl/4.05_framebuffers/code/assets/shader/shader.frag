@@ -2,12 +2,18 @@
 
 #define NUMBER_OF_POINT_LIGHTS 4
 
+// a texture packed in u_textures: its layer and its sub-rectangle in that layer
+struct TextureSlot
+{
+    float m_layer;
+    vec4  m_uvRect;    // xy: offset, zw: scale
+};
+
 struct Material
 {
-    sampler2D m_diffuse;
-    sampler2D m_specular;
-    sampler2D m_emission;
-    float     m_shininess;
+    TextureSlot m_diffuse;
+    TextureSlot m_specular;
+    float       m_shininess;
 };
 
 struct DirectionalLight
@@ -49,6 +55,7 @@ in vec3 io_fragPos;
 in vec3 io_normal;
 in vec2 io_texCoords;
 
+uniform sampler2DArray   u_textures;
 uniform vec3             u_viewPos;
 uniform Material         u_material;
 uniform DirectionalLight u_directionalLight;
@@ -57,7 +64,6 @@ uniform SpotLight        u_spotLight;
 uniform float            u_nearPlane;
 uniform float            u_farPlane;
 
-uniform bool u_enableEmissionMap;
 uniform bool u_enableColorOutput;
 uniform bool u_enableDepthOutput;
 uniform bool u_invertDepthOutput;
@@ -67,22 +73,25 @@ uint         LIGHT_DIRECTIONAL = 1u;
 uint         LIGHT_POINT       = 2u;
 uint         LIGHT_SPOT        = 4u;
 
+vec4 sampleSlot(TextureSlot slot, vec2 texCoords)
+{
+    return texture(u_textures, vec3(slot.m_uvRect.xy + texCoords * slot.m_uvRect.zw, slot.m_layer));
+}
+
 vec3 calculateDirectionalLight(vec3 normal, vec3 viewDir)
 {
     vec3 lightDir   = normalize(-u_directionalLight.m_direction);    // direction vector from fragment to u_spotLight source
     vec3 reflectDir = reflect(-lightDir, normal);                    // 1st param expects a vector that points from u_spotLight source towards the fragment
 
-    vec3 ambient = u_directionalLight.m_ambient * texture(u_material.m_diffuse, io_texCoords).rgb;
+    vec3 ambient = u_directionalLight.m_ambient * sampleSlot(u_material.m_diffuse, io_texCoords).rgb;
 
     float diffuseValue = max(dot(normal, lightDir), 0.0);    // clamp to non-negative
-    vec3  diffuse      = diffuseValue * u_directionalLight.m_diffuse * texture(u_material.m_diffuse, io_texCoords).rgb;
+    vec3  diffuse      = diffuseValue * u_directionalLight.m_diffuse * sampleSlot(u_material.m_diffuse, io_texCoords).rgb;
 
     float specularValue = pow(max(dot(viewDir, reflectDir), 0.0), u_material.m_shininess);    // 32 is the shininess value
-    vec3  specular      = specularValue * u_directionalLight.m_specular * texture(u_material.m_specular, io_texCoords).rgb;
-
-    vec3 emission = texture(u_material.m_emission, io_texCoords).rgb * vec3(u_enableEmissionMap);
+    vec3  specular      = specularValue * u_directionalLight.m_specular * sampleSlot(u_material.m_specular, io_texCoords).rgb;
 
-    vec3 result = ambient + diffuse + specular + emission;
+    vec3 result = ambient + diffuse + specular;
     return result;
 }
 
@@ -96,20 +105,18 @@ vec3 calculatePointLight(vec3 normal, vec3 viewDir)
         vec3 lightDir   = normalize(light.m_position - io_fragPos);    // direction vector from fragment to u_spotLight source
         vec3 reflectDir = reflect(-lightDir, normal);                  // 1st param expects a vector that points from u_spotLight source towards the fragment
 
-        vec3 ambient = light.m_ambient * texture(u_material.m_diffuse, io_texCoords).rgb;
+        vec3 ambient = light.m_ambient * sampleSlot(u_material.m_diffuse, io_texCoords).rgb;
 
         float diffuseValue = max(dot(normal, lightDir), 0.0);    // clamp to non-negative
-        vec3  diffuse      = diffuseValue * light.m_diffuse * texture(u_material.m_diffuse, io_texCoords).rgb;
+        vec3  diffuse      = diffuseValue * light.m_diffuse * sampleSlot(u_material.m_diffuse, io_texCoords).rgb;
 
         float specularValue = pow(max(dot(viewDir, reflectDir), 0.0), u_material.m_shininess);
-        vec3  specular      = specularValue * light.m_specular * texture(u_material.m_specular, io_texCoords).rgb;
-
-        vec3 emission = texture(u_material.m_emission, io_texCoords).rgb * vec3(u_enableEmissionMap);
+        vec3  specular      = specularValue * light.m_specular * sampleSlot(u_material.m_specular, io_texCoords).rgb;
 
         float distance    = length(light.m_position - io_fragPos);
         float attenuation = 1.0 / (light.m_constant + light.m_linear * distance + light.m_quadratic * (distance * distance));
 
-        result += (ambient + diffuse + specular) * attenuation + emission;
+        result += (ambient + diffuse + specular) * attenuation;
     }
     return result;
 }
@@ -119,15 +126,13 @@ vec3 calculateSpotLight(vec3 normal, vec3 viewDir)
     vec3 lightDir   = normalize(u_spotLight.m_position - io_fragPos);
     vec3 reflectDir = reflect(-lightDir, normal);
 
-    vec3 ambient = u_spotLight.m_ambient * texture(u_material.m_diffuse, io_texCoords).rgb;
+    vec3 ambient = u_spotLight.m_ambient * sampleSlot(u_material.m_diffuse, io_texCoords).rgb;
 
     float diffuseValue = max(dot(normal, lightDir), 0.0);    // clamp to non-negative
-    vec3  diffuse      = diffuseValue * u_spotLight.m_diffuse * texture(u_material.m_diffuse, io_texCoords).rgb;
+    vec3  diffuse      = diffuseValue * u_spotLight.m_diffuse * sampleSlot(u_material.m_diffuse, io_texCoords).rgb;
 
     float specularValue = pow(max(dot(viewDir, reflectDir), 0.0), u_material.m_shininess);
-    vec3  specular      = specularValue * u_spotLight.m_specular * texture(u_material.m_specular, io_texCoords).rgb;
-
-    vec3 emission = texture(u_material.m_emission, io_texCoords).rgb * vec3(u_enableEmissionMap);
+    vec3  specular      = specularValue * u_spotLight.m_specular * sampleSlot(u_material.m_specular, io_texCoords).rgb;
 
     float distance    = length(u_spotLight.m_position - io_fragPos);
     float attenuation = 1.0 / (u_spotLight.m_constant + u_spotLight.m_linear * distance + u_spotLight.m_quadratic * distance * distance);
@@ -137,7 +142,7 @@ vec3 calculateSpotLight(vec3 normal, vec3 viewDir)
     float epsilon   = u_spotLight.m_cutOff - u_spotLight.m_outerCutOff;
     float intensity = clamp((theta - u_spotLight.m_outerCutOff) / epsilon, 0.0, 1.0);
 
-    vec3 result = (ambient + diffuse + specular) * attenuation * intensity + emission;
+    vec3 result = (ambient + diffuse + specular) * attenuation * intensity;
     return result;
 }
 float linearize_depth(float depth)
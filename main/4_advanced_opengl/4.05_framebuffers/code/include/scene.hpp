@@ -23,10 +23,11 @@
 #include "common/old/window.hpp"
 #include "common/old/window_manager.hpp"
 #include "common/old/cube.hpp"
+#include "common/old/default_framebuffer.hpp"
 #include "common/old/plane.hpp"
 #include "common/old/camera.hpp"
 #include "common/old/shader.hpp"
-#include "common/old/image_texture.hpp"
+#include "common/old/texture_array.hpp"
 #include "common/old/stringified_enum.hpp"
 #include "common/old/scope_time_logger.hpp"
 #include "common/old/opengl_option_stack.hpp"
@@ -53,28 +54,30 @@ struct UniformData
 
 struct Material
 {
-    std::string  m_name;
-    ImageTexture m_diffuse;
-    ImageTexture m_specular;
-    float        m_shininess;
+    std::string m_name;
+    TextureSlot m_diffuse;
+    TextureSlot m_specular;
+    float       m_shininess;
 
     Material(
-        const std::string&    name,
-        std::filesystem::path diffuseMap,
-        std::filesystem::path specularMap,
-        float                 shininess
+        const std::string&           name,
+        const TextureArray&          textures,
+        const std::filesystem::path& diffuseMap,
+        const std::filesystem::path& specularMap,
+        float                        shininess
     )
         : m_name{ name }
-        , m_diffuse{ ImageTexture::from(diffuseMap, m_name + ".m_diffuse", 0).value() }       // unwrap
-        , m_specular{ ImageTexture::from(specularMap, m_name + ".m_specular", 1).value() }    // unwrap
+        , m_diffuse{ textures.getSlot(diffuseMap).value() }      // unwrap
+        , m_specular{ textures.getSlot(specularMap).value() }    // unwrap
         , m_shininess{ shininess }
     {
     }
 
+    // the texture array is bound by the scene, a material only selects its slots in it
     void applyUniform(Shader& shader) const
     {
-        m_diffuse.activate(shader);
-        m_specular.activate(shader);
+        m_diffuse.applyUniforms(shader, m_name + ".m_diffuse");
+        m_specular.applyUniforms(shader, m_name + ".m_specular");
         shader.setUniform(m_name + ".m_shininess", m_shininess);
     }
 };
@@ -157,11 +160,11 @@ public:
         if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
             std::cerr << "ERROR: Framebuffer is not complete!" << '\n';
 
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            DefaultFramebuffer::bind();
             return std::nullopt;
         }
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        DefaultFramebuffer::bind();
         return Framebuffer{ framebuffer, textureColorbuffer, rbo };
     }
 
@@ -238,7 +241,7 @@ public:
     {
         gl::glBindFramebuffer(gl::GL_FRAMEBUFFER, m_framebuffer);
         func();
-        gl::glBindFramebuffer(gl::GL_FRAMEBUFFER, 0);
+        DefaultFramebuffer::bind();
     }
 
     void updateDimension(gl::GLint width, gl::GLint height)
@@ -260,7 +263,7 @@ public:
         m_textureColorbuffer = newTexture;
         m_rbo                = newRbo;
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        DefaultFramebuffer::bind();
     }
 };
 
@@ -323,10 +326,11 @@ private:
     Cube                                     m_cube;
     Plane                                    m_plane;
     Plane                                    m_screenPlane;
+    TextureArray                             m_textures;
     Material                                 m_cubeMaterial;
     Material                                 m_floorMaterial;
-    ImageTexture                             m_grassTexture;
-    ImageTexture                             m_windowTexture;
+    TextureSlot                              m_grassTexture;
+    TextureSlot                              m_windowTexture;
     DirectionalLight                         m_directionalLight;
     std::array<PointLight, s_numPointLights> m_pointLights;
     SpotLight                                m_spotLight;
@@ -385,20 +389,23 @@ public:
         , m_cube{ 1.0f }
         , m_plane{ 1.0f }
         , m_screenPlane{ 2.0f }
+        , m_textures{ packTextures() }
         , m_cubeMaterial{
             /* .m_name      = */ "u_material",
+            /* .m_textures  = */ m_textures,
             /* .m_diffuse   = */ s_assets_path / "texture/metal.png",
             /* .m_specular  = */ s_assets_path / "texture/metal.png",
             /* .m_shininess = */ 128.0f,
         }
         , m_floorMaterial{
             /* .m_name      = */ "u_material",
+            /* .m_textures  = */ m_textures,
             /* .m_diffuse   = */ s_assets_path / "texture/marble.jpg",
             /* .m_specular  = */ s_assets_path / "texture/marble.jpg",
             /* .m_shininess = */ 32.0f,
         }
-        , m_grassTexture{ ImageTexture::from(s_assets_path / "texture/grass.png", "u_texture", 0).value() }      // skip optional check
-        , m_windowTexture{ ImageTexture::from(s_assets_path / "texture/window.png", "u_texture", 0).value() }    // skip optional check
+        , m_grassTexture{ m_textures.getSlot(s_assets_path / "texture/grass.png").value() }      // skip optional check
+        , m_windowTexture{ m_textures.getSlot(s_assets_path / "texture/window.png").value() }    // skip optional check
         , m_directionalLight{
             .m_name      = "u_directionalLight",
             .m_direction = { -0.2f, -1.0f, -0.3f },
@@ -484,6 +491,12 @@ public:
             // depth
             gl::glEnable(gl::GL_DEPTH_TEST);
 
+            // every textured object samples from the same array on the same unit
+            for (auto* shader : { &m_shader, &m_grassShader, &m_windowShader }) {
+                shader->use();
+                shader->setUniform(m_textures.getUniformName(), m_textures.getUnitNum());
+            }
+
             // stencil
             gl::glEnable(gl::GL_STENCIL_TEST);
             gl::glClearStencil(0x01);
@@ -545,7 +558,9 @@ private:
         m_optionStack.loadDefaults();
 
         m_ndcShader.use();
+        gl::glActiveTexture(gl::GL_TEXTURE0);
         gl::glBindTexture(gl::GL_TEXTURE_2D, m_framebuffer.m_textureColorbuffer);
+        SamplerCache::current().unbind(0);    // the color buffer has no mipmaps, use its own parameters
         m_screenPlane.draw();
 
         m_optionStack.pop();
@@ -659,7 +674,7 @@ private:
         m_grassShader.use();
         m_grassShader.setUniform("u_view", view);
         m_grassShader.setUniform("u_projection", projection);
-        m_grassTexture.activate(m_grassShader);
+        m_grassTexture.applyUniforms(m_grassShader, "u_texture");
 
         m_optionStack.push(OpenGLOptionStack::CULL_FACE);
         gl::glDisable(gl::GL_CULL_FACE);
@@ -686,7 +701,7 @@ private:
         m_windowShader.use();
         m_windowShader.setUniform("u_view", view);
         m_windowShader.setUniform("u_projection", projection);
-        m_windowTexture.activate(m_windowShader);
+        m_windowTexture.applyUniforms(m_windowShader, "u_texture");
 
         m_optionStack.push(OpenGLOptionStack::CULL_FACE);
         gl::glDisable(gl::GL_CULL_FACE);
@@ -726,6 +741,8 @@ private:
 
         updateUniforms();
 
+        m_textures.bind();    // bound once for all the draw groups below
+
         drawFloor(view, projection);
         drawCube(view, projection);
         drawGrass(view, projection);
@@ -737,6 +754,15 @@ private:
         drawWindow(view, projection);
     }
 
+    static TextureArray packTextures()
+    {
+        TextureArrayPacker packer;
+        for (auto name : { "metal.png", "marble.jpg", "grass.png", "window.png" }) {
+            packer.add(s_assets_path / "texture" / name);
+        }
+        return packer.pack("u_textures", 0).value();    // skip optional check
+    }
+
     void setWindowEventsHandler()
     {
         using enum window::Window::KeyActionType;
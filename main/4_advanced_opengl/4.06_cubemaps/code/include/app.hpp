@@ -112,7 +112,7 @@ public:
             return;
         }
 
-        if (!glfwInit()) {
+        if (!window::WindowManager::initGlfw()) {
             throw std::runtime_error{ "Failed to initialize GLFW" };
         }
 
@@ -190,7 +190,7 @@ private:
             PRETTY_FUNCTION_TIME_LOG_WITH_ARG("pollEvents");
 
             using window::operator""_fps;
-            windowManager.pollEvents(120_fps);
+            windowManager.waitEventsTimeout(120_fps);
         }
     }
 };
@@ -7,7 +7,9 @@
 
 #include "common/old/window.hpp"
 #include "common/old/stringified_enum.hpp"
+#include "common/old/sampler_cache.hpp"
 #include "common/old/scope_time_logger.hpp"
+#include "common/old/texture_residency.hpp"
 
 #include "scene.hpp"
 
@@ -91,6 +93,7 @@ private:
     MyImGuiWindowShown m_windowShown{ MyImGuiWindowShown::SHOW_OVERLAY_WINDOW };
     MyImGuiSortBy      m_sortBy{ MyImGuiSortBy::NO_SORT };
     MyImGuiOverlayPos  m_overlayPosition{ MyImGuiOverlayPos::TOP_LEFT };
+    int                m_textureBudgetMiB{ 0 };    // 0: unlimited
 
     struct LogData
     {
@@ -193,6 +196,15 @@ private:
         bool& skybox{ m_scene.m_skyboxEnabled };
         ImGui::Checkbox("skybox", &skybox);
 
+        if (auto quality{ SamplerCache::getQuality() }; ImGui::SliderFloat("anisotropy", &quality.m_anisotropy, 1.0f, 16.0f)) {
+            SamplerCache::setQuality(quality);
+        }
+
+        if (ImGui::SliderInt("texture budget (MiB)", &m_textureBudgetMiB, 0, 512)) {
+            std::size_t budget{ std::size_t(m_textureBudgetMiB) << 20 };
+            TextureResidency::instance().setBudget(budget == 0 ? TextureResidency::s_unlimited : budget);
+        }
+
         ImGui::Separator();
 
         ImGui::Checkbox("outline", &m_scene.m_enableOutline);
@@ -415,7 +427,30 @@ private:
                 auto cursorPos{ m_window.getProperties().m_cursorPos };
                 ImGui::Text("cursor pos: (%.2f, %.2f)", cursorPos.x, cursorPos.y);
             }
+            ImGui::Separator();
+
+            showTextureResidency();
+        }
+    }
+
+    void showTextureResidency()
+    {
+        using Kind = TextureResidency::Kind;
+
+        constexpr auto toMiB = [](std::size_t bytes) { return (float)bytes / (float)(1 << 20); };
+
+        const auto stats{ TextureResidency::instance().getStats() };
+        const auto perKind = [&](Kind kind) { return toMiB(stats.m_residentPerKind[(std::size_t)kind]); };
+
+        if (stats.m_budget == TextureResidency::s_unlimited) {
+            ImGui::Text("tex memory: %.2f MiB (peak %.2f)", toMiB(stats.m_resident), toMiB(stats.m_peak));
+        } else {
+            ImGui::Text("tex memory: %.2f / %.2f MiB (peak %.2f)", toMiB(stats.m_resident), toMiB(stats.m_budget), toMiB(stats.m_peak));
         }
+        ImGui::Text("  image: %.2f | array: %.2f", perKind(Kind::IMAGE), perKind(Kind::ARRAY));
+        ImGui::Text("  cube : %.2f | fbo  : %.2f", perKind(Kind::CUBEMAP), perKind(Kind::ATTACHMENT));
+        ImGui::Text("textures  : %zu (%zu evicted)", stats.m_numTracked, stats.m_numEvicted);
+        ImGui::Text("evict/load: %zu / %zu", stats.m_evictions, stats.m_restores);
     }
 };
 
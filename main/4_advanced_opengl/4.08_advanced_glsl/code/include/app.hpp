@@ -27,7 +27,7 @@ public:
             std::cerr << "GLFW error " << error << ": " << description << '\n';
         });
 
-        if (!glfwInit()) {
+        if (!window::WindowManager::initGlfw()) {
             throw std::runtime_error("Failed to initialize GLFW");
         }
 